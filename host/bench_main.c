@@ -0,0 +1,181 @@
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HOST_BENCH_HAVE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+#include "esp_log.h"
+
+#include "bench.h"
+#include "host.h"
+
+static const char* const TAG = "host_bench";
+
+#define MAX_FRAMES 64
+
+static struct bench_frame s_frames[MAX_FRAMES];
+static size_t s_frame_count;
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [--corpus DIR] [--verbose]\n"
+            "  -c, --corpus DIR   benchmark the *.jpg frames in DIR (default: synthetic QVGA, SVGA, UXGA)\n"
+            "results are printed to stdout as one JSON object per line\n",
+            argv0);
+}
+
+static esp_err_t load_frame(const char* dir, const char* file) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    fseek(f, 0, SEEK_END);
+    const long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t* buf = len > 0 ? malloc(len) : NULL;
+    if (buf == NULL || fread(buf, 1, len, f) != (size_t)len) {
+        free(buf);
+        fclose(f);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    fclose(f);
+
+    char* name = strdup(file);
+    char* dot = strrchr(name, '.');
+    if (dot) {
+        *dot = '\0';
+    }
+
+    s_frames[s_frame_count++] = (struct bench_frame){.name = name, .buf = buf, .len = len};
+    return ESP_OK;
+}
+
+static int compare_frames(const void* a, const void* b) {
+    return strcmp(((const struct bench_frame*)a)->name, ((const struct bench_frame*)b)->name);
+}
+
+static esp_err_t load_corpus(const char* dir) {
+    DIR* d = opendir(dir);
+    if (d == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL && s_frame_count < MAX_FRAMES) {
+        const size_t len = strlen(entry->d_name);
+        if (len > 4 && strcasecmp(entry->d_name + len - 4, ".jpg") == 0) {
+            esp_err_t err = load_frame(dir, entry->d_name);
+            if (err != ESP_OK) {
+                ESP_LOGW(TAG, "%s: %s", entry->d_name, esp_err_to_name(err));
+            }
+        }
+    }
+    closedir(d);
+
+    qsort(s_frames, s_frame_count, sizeof(s_frames[0]), compare_frames);
+    return s_frame_count ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+#ifdef HOST_BENCH_HAVE_LIBJPEG
+/**
+ * Encode a 4:2:2 baseline JPEG like the OV2640/OV3660 produce: smooth
+ * gradients with sensor-like noise, so entropy and size are in the range of
+ * real captures.
+ */
+static void synthesize(const char* name, unsigned width, unsigned height) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char* out = NULL;
+    unsigned long out_len = 0;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &out, &out_len);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 85, TRUE);
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 1;
+    jpeg_start_compress(&cinfo, TRUE);
+
+    uint8_t* row = malloc(width * 3);
+    uint32_t lcg = width * height;
+    while (cinfo.next_scanline < height) {
+        const unsigned y = cinfo.next_scanline;
+        for (unsigned x = 0; x < width; x++) {
+            lcg = lcg * 1664525U + 1013904223U;
+            const int noise = (int)(lcg >> 28) - 8;
+            const int base = ((x * 7 / width) & 1) ? 200 : 60; // a few vertical bands
+            int v[3] = {base + (int)(x * 55 / width), 40 + (int)(y * 160 / height), 128 + (int)((x ^ y) & 31)};
+            for (int c = 0; c < 3; c++) {
+                const int s = v[c] + noise;
+                row[x * 3 + c] = s < 0 ? 0 : (s > 255 ? 255 : s);
+            }
+        }
+        JSAMPROW rows[1] = {row};
+        jpeg_write_scanlines(&cinfo, rows, 1);
+    }
+    free(row);
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    s_frames[s_frame_count++] = (struct bench_frame){.name = name, .buf = out, .len = out_len};
+}
+#endif
+
+int main(int argc, char** argv) {
+    static const struct option options[] = {
+        {"corpus", required_argument, NULL, 'c'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    const char* corpus = NULL;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:vh", options, NULL)) != -1) {
+        switch (opt) {
+        case 'c':
+            corpus = optarg;
+            break;
+        case 'v':
+            host_log_set_level(ESP_LOG_DEBUG);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (corpus) {
+        if (load_corpus(corpus) != ESP_OK) {
+            ESP_LOGE(TAG, "no JPEG frames in %s", corpus);
+            return EXIT_FAILURE;
+        }
+    } else {
+#ifdef HOST_BENCH_HAVE_LIBJPEG
+        synthesize("synthetic_qvga", 320, 240);
+        synthesize("synthetic_svga", 800, 600);
+        synthesize("synthetic_uxga", 1600, 1200);
+#else
+        ESP_LOGW(TAG, "built without libjpeg, only the audio cases run; pass --corpus DIR for the frame cases");
+#endif
+    }
+
+    bench_run(s_frames, s_frame_count);
+
+    return EXIT_SUCCESS;
+}
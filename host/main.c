@@ -0,0 +1,255 @@
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "host.h"
+#include "pdm_mic.h"
+#include "rtp.h"
+#include "rtsp.h"
+
+static const char* const TAG = "host";
+
+#define DEFAULT_CAMERA_FPS 15
+#define DEFAULT_FB_COUNT (CONFIG_ESPRTP_VIDEO_QUEUE_LEN + 2)
+#define SDP_SIZE 512
+#define DEFAULT_RTO_MS 200 // Linux TCP_RTO_MIN
+
+static volatile sig_atomic_t s_toggle_transport;
+
+static void on_sigusr1(int sig) {
+    s_toggle_transport = 1;
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -f, --frames DIR     replay the *.jpg captures in DIR as the camera\n"
+            "  -r, --fps N          camera frame rate (default %d)\n"
+            "  -w, --wav FILE       16-bit mono PCM WAV for the microphone (default: 440 Hz tone)\n"
+            "  -c, --mic-ppm PPM    run the microphone clock PPM parts per million fast (negative: slow)\n"
+            "  -d, --duration SEC   stop after SEC seconds (default: run until killed)\n"
+            "  -p, --pcap FILE      record every sent datagram to a pcap file\n"
+            "  -t, --to ADDR:PORT   also send the video to ADDR:PORT (repeatable)\n"
+            "  -o, --own-ssrc       give the --to receivers their own SSRC and sequence numbers\n"
+            "  -m, --multicast      send to the group %s instead (SIGUSR1 switches back and forth)\n"
+            "  -s, --sdp FILE       write the session description, rewritten on every switch\n"
+            "  -l, --loss PCT       lose PCT %% of sent packets; a TCP loss stalls the connection for one RTO\n"
+            "  -R, --rto MS         retransmission timeout for --loss (default %d)\n"
+            "  -v, --verbose        debug logging\n"
+            "streams to %s, video port %d, audio port %d\n",
+            argv0, DEFAULT_CAMERA_FPS, CONFIG_ESPRTP_MULTICAST_ADDR, DEFAULT_RTO_MS, CONFIG_ESPRTP_IPV4_ADDR, CONFIG_ESPRTP_UDP_VIDEO_PORT,
+            CONFIG_ESPRTP_UDP_AUDIO_PORT);
+}
+
+/** ADDR:PORT, ADDR being a dotted IPv4 address */
+static bool parse_addr(const char* arg, struct sockaddr_in* out) {
+    char host[INET_ADDRSTRLEN];
+    unsigned port;
+    if (sscanf(arg, "%15[0-9.]:%u", host, &port) != 2 || port == 0 || port > 65535) {
+        return false;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->sin_family = AF_INET;
+    out->sin_port = htons(port);
+    return inet_aton(host, &out->sin_addr) != 0;
+}
+
+static void write_sdp(const char* path) {
+    char sdp[SDP_SIZE];
+    rtp_get_sdp(sdp, sizeof(sdp));
+
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "%s: %s", path, strerror(errno));
+        return;
+    }
+    fputs(sdp, f);
+    fclose(f);
+}
+
+int main(int argc, char** argv) {
+    static const struct option options[] = {
+        {"frames", required_argument, NULL, 'f'}, {"fps", required_argument, NULL, 'r'},
+        {"wav", required_argument, NULL, 'w'},    {"duration", required_argument, NULL, 'd'},
+        {"pcap", required_argument, NULL, 'p'},   {"to", required_argument, NULL, 't'},
+        {"own-ssrc", no_argument, NULL, 'o'},     {"multicast", no_argument, NULL, 'm'},
+        {"sdp", required_argument, NULL, 's'},    {"loss", required_argument, NULL, 'l'},
+        {"rto", required_argument, NULL, 'R'},    {"verbose", no_argument, NULL, 'v'},
+        {"mic-ppm", required_argument, NULL, 'c'}, {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    const char* frames = NULL;
+    const char* wav = NULL;
+    double mic_ppm = 0.0;
+    const char* pcap = NULL;
+    uint32_t fps = DEFAULT_CAMERA_FPS;
+    unsigned duration = 0;
+    struct sockaddr_in extra[RTP_DEST_MAX];
+    size_t extra_count = 0;
+    bool own_ssrc = false;
+    bool multicast = false;
+    const char* sdp = NULL;
+    double loss = 0.0;
+    uint32_t rto_ms = DEFAULT_RTO_MS;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:r:w:c:d:p:t:oms:l:R:vh", options, NULL)) != -1) {
+        switch (opt) {
+        case 'f':
+            frames = optarg;
+            break;
+        case 'r':
+            fps = strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            wav = optarg;
+            break;
+        case 'c':
+            mic_ppm = strtod(optarg, NULL);
+            break;
+        case 'd':
+            duration = strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            pcap = optarg;
+            break;
+        case 't':
+            if (extra_count == RTP_DEST_MAX || !parse_addr(optarg, &extra[extra_count])) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            extra_count++;
+            break;
+        case 'o':
+            own_ssrc = true;
+            break;
+        case 'm':
+            multicast = true;
+            break;
+        case 's':
+            sdp = optarg;
+            break;
+        case 'l':
+            loss = strtod(optarg, NULL);
+            break;
+        case 'R':
+            rto_ms = strtoul(optarg, NULL, 10);
+            break;
+        case 'v':
+            host_log_set_level(ESP_LOG_DEBUG);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
+    if (frames == NULL) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    ESP_ERROR_CHECK(host_camera_init(frames, fps, DEFAULT_FB_COUNT));
+#else
+    (void)frames;
+    (void)fps;
+#endif
+
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+    ESP_ERROR_CHECK(host_mic_init(wav, mic_ppm));
+    ESP_ERROR_CHECK(pdm_mic_init());
+#else
+    (void)wav;
+    (void)mic_ppm;
+#endif
+
+    if (pcap) {
+        ESP_ERROR_CHECK(host_pcap_open(pcap));
+        atexit(host_pcap_close);
+    }
+    if (loss > 0.0) {
+        host_netsim_init(loss, rto_ms);
+    }
+
+    rtp_init();
+    if (multicast) {
+        ESP_ERROR_CHECK(rtp_set_transport(RTP_TRANSPORT_MULTICAST));
+    }
+    if (sdp) {
+        write_sdp(sdp);
+    }
+    signal(SIGUSR1, on_sigusr1);
+
+    for (size_t i = 0; i < extra_count; i++) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(rtp_video_add_destination(&extra[i], own_ssrc));
+    }
+
+    // SIGUSR1 only sets a flag, any thread may take it; sleep may end early
+    const int64_t stop_us = esp_timer_get_time() + duration * 1000000LL;
+    while (duration == 0 || esp_timer_get_time() < stop_us) {
+        sleep(1);
+        if (s_toggle_transport) {
+            s_toggle_transport = 0;
+            rtp_set_transport(rtp_get_transport() == RTP_TRANSPORT_UNICAST ? RTP_TRANSPORT_MULTICAST
+                                                                           : RTP_TRANSPORT_UNICAST);
+            if (sdp) {
+                write_sdp(sdp);
+            }
+        }
+    }
+
+    ESP_LOGI(TAG, "stopping after %u s", duration);
+
+    for (size_t i = 0; i < extra_count; i++) {
+        struct rtp_dest_stats dest;
+        if (rtp_get_video_destination_stats(&extra[i], &dest) == ESP_OK) {
+            ESP_LOGI(TAG, "%s:%d: %" PRIu32 " packets, %" PRIu64 " bytes, %" PRIu32 " errors, %" PRIu32 " skipped",
+                     inet_ntoa(extra[i].sin_addr), ntohs(extra[i].sin_port), dest.packets, dest.bytes, dest.errors,
+                     dest.skipped);
+        }
+    }
+
+    struct rtp_history_stats nack;
+    if (rtp_get_video_history_stats(&nack) == ESP_OK) {
+        ESP_LOGI(TAG,
+                 "NACK: %" PRIu32 " entries, %" PRIu32 " requested, %" PRIu32 " resent, %" PRIu32
+                 " too late, %" PRIu32 " deduplicated, %" PRIu32 " dropped",
+                 nack.nacks, nack.requested, nack.resent, nack.too_late, nack.deduplicated, nack.dropped);
+    }
+
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+    struct audio_ring_stats mic;
+    pdm_mic_get_stats(&mic);
+    ESP_LOGI(TAG,
+             "mic: %" PRIu32 " DMA buffers, %" PRIu32 " read, %" PRIu32 " overruns, %" PRIu32 " late, %" PRIu32
+             " underruns",
+             mic.produced, mic.consumed, mic.overruns, mic.late, mic.underruns);
+
+    struct audio_clock_stats clock;
+    pdm_mic_get_clock_stats(&clock);
+    ESP_LOGI(TAG, "mic clock: %+" PRId32 " ppm, offset %" PRId32 " samples, %" PRIu32 " inserted, %" PRIu32 " dropped",
+             clock.drift_ppm, clock.offset, clock.inserted, clock.dropped);
+#endif
+
+#if defined(CONFIG_ESPRTP_RTSP) && defined(CONFIG_ESPRTP_RTSP_TCP)
+    struct rtp_tcp_stats tcp;
+    rtsp_get_tcp_stats(&tcp);
+    if (tcp.packets) {
+        ESP_LOGI(TAG,
+                 "TCP: %" PRIu32 " packets, %" PRIu64 " bytes, %" PRIu32 " frames, %" PRIu32 " dropped, %" PRIu32
+                 " cut, %" PRIu32 " other packets dropped, queue %zu bytes (max %zu)",
+                 tcp.packets, tcp.bytes, tcp.frames, tcp.frames_dropped, tcp.frames_cut, tcp.packets_dropped,
+                 tcp.depth, tcp.max_depth);
+    }
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+#include <dirent.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "host.h"
+#include "jpeg_frame.h"
+
+static const char* const TAG = "host_camera";
+
+struct capture {
+    uint8_t* data;
+    size_t len;
+    uint16_t width;
+    uint16_t height;
+};
+
+static struct capture* s_captures;
+static size_t s_capture_count;
+
+static camera_fb_t* s_fbs;
+static bool* s_fb_busy;
+static size_t s_fb_count;
+
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_fb_free = PTHREAD_COND_INITIALIZER;
+
+static uint32_t s_fps;
+static uint64_t s_frame;
+static int64_t s_start_us;
+
+static int set_framesize(sensor_t* sensor, framesize_t framesize) {
+    ESP_LOGI(TAG, "set_framesize %d (replayed captures keep their size)", framesize);
+    sensor->status.framesize = framesize;
+    return 0;
+}
+
+static int set_quality(sensor_t* sensor, int quality) {
+    ESP_LOGI(TAG, "set_quality %d (replayed captures keep their quality)", quality);
+    sensor->status.quality = quality;
+    return 0;
+}
+
+static sensor_t s_sensor = {
+    .status = {.framesize = FRAMESIZE_QVGA, .quality = 12},
+    .set_framesize = set_framesize,
+    .set_quality = set_quality,
+};
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static bool has_jpeg_suffix(const char* name) {
+    const size_t len = strlen(name);
+    return (len > 4 && strcasecmp(name + len - 4, ".jpg") == 0) ||
+           (len > 5 && strcasecmp(name + len - 5, ".jpeg") == 0);
+}
+
+static esp_err_t load_capture(const char* path, struct capture* capture) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || st.st_size <= 0) {
+        fclose(f);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    capture->len = st.st_size;
+    capture->data = malloc(capture->len);
+    if (capture->data == NULL) {
+        fclose(f);
+        return ESP_ERR_NO_MEM;
+    }
+
+    const size_t n = fread(capture->data, 1, capture->len, f);
+    fclose(f);
+    if (n != capture->len) {
+        free(capture->data);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    struct jpeg_frame frame;
+    esp_err_t err = jpeg_frame_index(capture->data, capture->len, &frame);
+    if (err != ESP_OK) {
+        free(capture->data);
+        return err;
+    }
+    capture->width = frame.width;
+    capture->height = frame.height;
+
+    return ESP_OK;
+}
+
+esp_err_t host_camera_init(const char* dir, uint32_t fps, size_t fb_count) {
+    if (dir == NULL || fps == 0 || fb_count == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    DIR* d = opendir(dir);
+    if (d == NULL) {
+        ESP_LOGE(TAG, "opendir %s failed", dir);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    char** names = NULL;
+    size_t count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (!has_jpeg_suffix(entry->d_name)) {
+            continue;
+        }
+        char** grown = realloc(names, (count + 1) * sizeof(*names));
+        if (grown == NULL) {
+            break;
+        }
+        names = grown;
+        names[count++] = strdup(entry->d_name);
+    }
+    closedir(d);
+
+    qsort(names, count, sizeof(*names), compare_names);
+
+    s_captures = calloc(count ? count : 1, sizeof(*s_captures));
+    for (size_t i = 0; i < count; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+
+        esp_err_t err = load_capture(path, &s_captures[s_capture_count]);
+        if (err == ESP_OK) {
+            s_capture_count++;
+        } else {
+            ESP_LOGW(TAG, "skipping %s: %s", path, esp_err_to_name(err));
+        }
+        free(names[i]);
+    }
+    free(names);
+
+    if (s_capture_count == 0) {
+        ESP_LOGE(TAG, "no usable JPEG captures in %s", dir);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    s_fbs = calloc(fb_count, sizeof(*s_fbs));
+    s_fb_busy = calloc(fb_count, sizeof(*s_fb_busy));
+    if (s_fbs == NULL || s_fb_busy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_fb_count = fb_count;
+    s_fps = fps;
+    s_start_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "replaying %zu captures from %s at %" PRIu32 " fps, %ux%u first", s_capture_count, dir, fps,
+             s_captures[0].width, s_captures[0].height);
+
+    return ESP_OK;
+}
+
+camera_fb_t* esp_camera_fb_get(void) {
+    if (unlikely(s_capture_count == 0)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&s_lock);
+
+    // The sensor runs at a fixed rate; a late reader gets the next frame, not a burst of old ones
+    int64_t due = s_start_us + (int64_t)(s_frame * 1000000ULL / s_fps);
+    int64_t now = esp_timer_get_time();
+    while (due + 1000000LL / s_fps <= now) {
+        s_frame++;
+        due = s_start_us + (int64_t)(s_frame * 1000000ULL / s_fps);
+    }
+    const uint64_t frame = s_frame++;
+
+    size_t slot = s_fb_count;
+    while (slot == s_fb_count) {
+        for (slot = 0; slot < s_fb_count && s_fb_busy[slot]; slot++) {
+        }
+        if (slot == s_fb_count) {
+            pthread_cond_wait(&s_fb_free, &s_lock);
+        }
+    }
+    s_fb_busy[slot] = true;
+
+    pthread_mutex_unlock(&s_lock);
+
+    if (due > now) {
+        vTaskDelay(pdMS_TO_TICKS((due - now + 999) / 1000));
+    }
+
+    const struct capture* capture = &s_captures[frame % s_capture_count];
+    const int64_t captured_us = esp_timer_get_time();
+
+    camera_fb_t* fb = &s_fbs[slot];
+    fb->buf = capture->data;
+    fb->len = capture->len;
+    fb->width = capture->width;
+    fb->height = capture->height;
+    fb->format = PIXFORMAT_JPEG;
+    fb->timestamp.tv_sec = captured_us / 1000000;
+    fb->timestamp.tv_usec = captured_us % 1000000;
+
+    return fb;
+}
+
+void esp_camera_fb_return(camera_fb_t* fb) {
+    if (fb == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&s_lock);
+    s_fb_busy[fb - s_fbs] = false;
+    pthread_cond_signal(&s_fb_free);
+    pthread_mutex_unlock(&s_lock);
+}
+
+sensor_t* esp_camera_sensor_get(void) {
+    return &s_sensor;
+}
@@ -0,0 +1,178 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "host.h"
+
+esp_log_level_t host_log_level = ESP_LOG_INFO;
+
+static struct timespec s_start;
+
+__attribute__((constructor)) static void esp_timer_init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &s_start);
+}
+
+int64_t esp_timer_get_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t)(now.tv_sec - s_start.tv_sec) * 1000000LL + (now.tv_nsec - s_start.tv_nsec) / 1000;
+}
+
+struct host_timer {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t thread;
+    esp_timer_cb_t callback;
+    void* arg;
+    int64_t due_us; // 0 while stopped
+    bool deleted;
+};
+
+static void* timer_thread(void* arg) {
+    struct host_timer* t = arg;
+
+    pthread_mutex_lock(&t->lock);
+    while (!t->deleted) {
+        if (t->due_us == 0) {
+            pthread_cond_wait(&t->changed, &t->lock);
+            continue;
+        }
+
+        // esp_timer_get_time counts CLOCK_MONOTONIC from s_start, the condition waits on the same clock
+        const int64_t due_ns = (t->due_us + s_start.tv_sec * 1000000LL) * 1000LL + s_start.tv_nsec;
+        const struct timespec until = {.tv_sec = due_ns / 1000000000LL, .tv_nsec = due_ns % 1000000000LL};
+        if (pthread_cond_timedwait(&t->changed, &t->lock, &until) != ETIMEDOUT || t->due_us == 0) {
+            continue; // restarted, stopped or deleted
+        }
+
+        t->due_us = 0;
+        pthread_mutex_unlock(&t->lock);
+        t->callback(t->arg);
+        pthread_mutex_lock(&t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+    struct host_timer* t = calloc(1, sizeof(*t));
+    if (t == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->changed, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&t->lock, NULL);
+    t->callback = args->callback;
+    t->arg = args->arg;
+
+    if (pthread_create(&t->thread, NULL, timer_thread, t) != 0) {
+        pthread_cond_destroy(&t->changed);
+        pthread_mutex_destroy(&t->lock);
+        free(t);
+        return ESP_ERR_NO_MEM;
+    }
+
+    *out = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us) {
+    esp_err_t err = ESP_OK;
+
+    pthread_mutex_lock(&t->lock);
+    if (t->due_us) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        t->due_us = esp_timer_get_time() + (int64_t)timeout_us;
+        t->due_us = t->due_us ? t->due_us : 1;
+        pthread_cond_signal(&t->changed);
+    }
+    pthread_mutex_unlock(&t->lock);
+
+    return err;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t) {
+    pthread_mutex_lock(&t->lock);
+    const bool running = t->due_us != 0;
+    t->due_us = 0;
+    pthread_cond_signal(&t->changed);
+    pthread_mutex_unlock(&t->lock);
+
+    return running ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t t) {
+    pthread_mutex_lock(&t->lock);
+    t->deleted = true;
+    pthread_cond_signal(&t->changed);
+    pthread_mutex_unlock(&t->lock);
+
+    pthread_join(t->thread, NULL);
+    pthread_cond_destroy(&t->changed);
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+
+    return ESP_OK;
+}
+
+uint32_t esp_log_timestamp(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void host_log_set_level(esp_log_level_t level) {
+    host_log_level = level;
+}
+
+uint32_t esp_random(void) {
+    uint32_t value;
+
+    FILE* f = fopen("/dev/urandom", "rb");
+    if (f == NULL || fread(&value, sizeof(value), 1, f) != 1) {
+        value = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+    }
+    if (f) {
+        fclose(f);
+    }
+
+    return value;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,232 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+struct task_start {
+    TaskFunction_t fn;
+    void* arg;
+};
+
+static void* task_entry(void* arg) {
+    struct task_start start = *(struct task_start*)arg;
+    free(arg);
+
+    start.fn(start.arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack_depth, void* arg, UBaseType_t priority,
+                       TaskHandle_t* handle) {
+    struct task_start* start = malloc(sizeof(*start));
+    if (start == NULL) {
+        return pdFAIL;
+    }
+    start->fn = fn;
+    start->arg = arg;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_entry, start) != 0) {
+        free(start);
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+
+    if (handle) {
+        *handle = (TaskHandle_t)thread;
+    }
+
+    return pdPASS;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() / 1000 / portTICK_PERIOD_MS);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    const uint64_t us = (uint64_t)ticks * portTICK_PERIOD_MS * 1000U;
+    struct timespec ts = {.tv_sec = us / 1000000U, .tv_nsec = (us % 1000000U) * 1000U};
+
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t increment) {
+    const TickType_t wake = *previous_wake + increment;
+    const TickType_t now = xTaskGetTickCount();
+
+    if ((int32_t)(wake - now) > 0) {
+        vTaskDelay(wake - now);
+    }
+    *previous_wake = wake;
+}
+
+/* Absolute CLOCK_REALTIME deadline for pthread timed waits */
+static struct timespec deadline(TickType_t ticks) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    const uint64_t ns = (uint64_t)ticks * portTICK_PERIOD_MS * 1000000U + ts.tv_nsec;
+    ts.tv_sec += ns / 1000000000U;
+    ts.tv_nsec = ns % 1000000000U;
+
+    return ts;
+}
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t items[];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct host_queue* q = calloc(1, sizeof(*q) + (size_t)length * item_size);
+    if (q == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    q->length = length;
+    q->item_size = item_size;
+
+    return q;
+}
+
+/* Wait on the queue condition until pred holds; false on timeout */
+#define QUEUE_WAIT(q, ticks, pred)                                                                                     \
+    ({                                                                                                                 \
+        const struct timespec until_ = deadline(ticks);                                                                \
+        int rc_ = 0;                                                                                                   \
+        while (!(pred) && rc_ != ETIMEDOUT && (ticks) != 0) {                                                          \
+            rc_ = ((ticks) == portMAX_DELAY) ? pthread_cond_wait(&(q)->changed, &(q)->lock)                            \
+                                             : pthread_cond_timedwait(&(q)->changed, &(q)->lock, &until_);             \
+        }                                                                                                              \
+        (pred);                                                                                                        \
+    })
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks) {
+    pthread_mutex_lock(&q->lock);
+
+    if (!QUEUE_WAIT(q, ticks, q->count < q->length)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFAIL;
+    }
+
+    memcpy(q->items + (size_t)((q->head + q->count) % q->length) * q->item_size, item, q->item_size);
+    q->count++;
+
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks) {
+    pthread_mutex_lock(&q->lock);
+
+    if (!QUEUE_WAIT(q, ticks, q->count > 0)) {
+        pthread_mutex_unlock(&q->lock);
+        return pdFAIL;
+    }
+
+    memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+
+    pthread_cond_broadcast(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    pthread_mutex_lock(&q->lock);
+    const UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->lock);
+
+    return count;
+}
+
+/* A mutex, or a binary semaphore that starts empty */
+struct host_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    bool binary;
+    bool full;
+};
+
+static SemaphoreHandle_t semaphore_create(bool binary) {
+    struct host_semaphore* sem = calloc(1, sizeof(*sem));
+    if (sem) {
+        pthread_mutex_init(&sem->lock, NULL);
+        pthread_cond_init(&sem->changed, NULL);
+        sem->binary = binary;
+    }
+
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return semaphore_create(false);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return semaphore_create(true);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    if (sem->binary) {
+        pthread_mutex_lock(&sem->lock);
+        const bool taken = QUEUE_WAIT(sem, ticks, sem->full);
+        sem->full = false;
+        pthread_mutex_unlock(&sem->lock);
+        return taken ? pdPASS : pdFAIL;
+    }
+
+    if (ticks == portMAX_DELAY) {
+        return pthread_mutex_lock(&sem->lock) == 0 ? pdPASS : pdFAIL;
+    }
+
+    const struct timespec until = deadline(ticks);
+    return pthread_mutex_timedlock(&sem->lock, &until) == 0 ? pdPASS : pdFAIL;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    if (sem->binary) {
+        pthread_mutex_lock(&sem->lock);
+        const bool given = !sem->full;
+        sem->full = true;
+        pthread_cond_signal(&sem->changed);
+        pthread_mutex_unlock(&sem->lock);
+        return given ? pdPASS : pdFAIL;
+    }
+
+    return pthread_mutex_unlock(&sem->lock) == 0 ? pdPASS : pdFAIL;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t* higher_priority_task_woken) {
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdFALSE; // threads need no yield
+    }
+    return xSemaphoreGive(sem);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    pthread_mutex_destroy(&sem->lock);
+    pthread_cond_destroy(&sem->changed);
+    free(sem);
+}
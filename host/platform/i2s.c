@@ -0,0 +1,249 @@
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "driver/i2s_pdm.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "host.h"
+
+static const char* const TAG = "host_i2s";
+
+#define TONE_HZ 440.0
+#define TONE_AMPLITUDE 8000.0
+
+struct host_i2s_channel {
+    uint32_t sample_rate;
+    bool enabled;
+    int64_t start_us;
+    uint64_t delivered; // samples handed out since enable
+
+    uint32_t dma_desc_num;
+    uint32_t dma_frame_num;
+    int16_t* dma; // dma_desc_num buffers back to back, while a callback is registered
+    i2s_event_callbacks_t callbacks;
+    void* user_data;
+};
+
+static struct host_i2s_channel s_rx;
+
+static int16_t* s_samples;
+static size_t s_sample_count;
+static uint32_t s_sample_rate;
+static double s_clock_scale = 1.0; // actual sample rate over the nominal one
+
+static inline uint32_t read_le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint16_t read_le16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static esp_err_t load_wav(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint8_t riff[12];
+    if (fread(riff, 1, sizeof(riff), f) != sizeof(riff) || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+        fclose(f);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    bool format_ok = false;
+    uint8_t chunk[8];
+    while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+        const uint32_t size = read_le32(chunk + 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            uint8_t fmt[16];
+            if (fread(fmt, 1, sizeof(fmt), f) != sizeof(fmt)) {
+                break;
+            }
+            // PCM, mono, 16-bit
+            format_ok = read_le16(fmt) == 1 && read_le16(fmt + 2) == 1 && read_le16(fmt + 14) == 16;
+            s_sample_rate = read_le32(fmt + 4);
+            fseek(f, size - sizeof(fmt) + (size & 1), SEEK_CUR);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!format_ok) {
+                err = ESP_ERR_NOT_SUPPORTED;
+                break;
+            }
+            s_samples = malloc(size);
+            s_sample_count = s_samples ? fread(s_samples, sizeof(int16_t), size / sizeof(int16_t), f) : 0;
+            err = s_sample_count ? ESP_OK : ESP_ERR_INVALID_SIZE;
+            break;
+        } else {
+            fseek(f, size + (size & 1), SEEK_CUR);
+        }
+    }
+
+    fclose(f);
+    return err;
+}
+
+esp_err_t host_mic_init(const char* wav_path, double clock_ppm) {
+    s_clock_scale = 1.0 + clock_ppm / 1e6;
+    if (clock_ppm != 0.0) {
+        ESP_LOGI(TAG, "sample clock %+.0f ppm against esp_timer", clock_ppm);
+    }
+
+    if (wav_path == NULL) {
+        s_sample_rate = 8000;
+        s_sample_count = s_sample_rate; // one second, a whole number of periods
+        s_samples = malloc(s_sample_count * sizeof(int16_t));
+        if (s_samples == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        for (size_t i = 0; i < s_sample_count; i++) {
+            s_samples[i] = (int16_t)lrint(TONE_AMPLITUDE * sin(2.0 * M_PI * TONE_HZ * i / s_sample_rate));
+        }
+        ESP_LOGI(TAG, "no WAV given, generating a %.0f Hz tone", TONE_HZ);
+        return ESP_OK;
+    }
+
+    esp_err_t err = load_wav(wav_path);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "%s: %s (need 16-bit mono PCM)", wav_path, esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "looping %s, %zu samples at %" PRIu32 " Hz", wav_path, s_sample_count, s_sample_rate);
+    return ESP_OK;
+}
+
+esp_err_t i2s_new_channel(const i2s_chan_config_t* chan_cfg, i2s_chan_handle_t* ret_tx_handle,
+                          i2s_chan_handle_t* ret_rx_handle) {
+    if (chan_cfg == NULL || ret_tx_handle != NULL || ret_rx_handle == NULL) {
+        return ESP_ERR_NOT_SUPPORTED; // the host only models an RX channel
+    }
+
+    memset(&s_rx, 0, sizeof(s_rx));
+    s_rx.dma_desc_num = chan_cfg->dma_desc_num;
+    s_rx.dma_frame_num = chan_cfg->dma_frame_num;
+    *ret_rx_handle = &s_rx;
+
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_init_pdm_rx_mode(i2s_chan_handle_t handle, const i2s_pdm_rx_config_t* pdm_rx_cfg) {
+    if (pdm_rx_cfg->slot_cfg.data_bit_width != I2S_DATA_BIT_WIDTH_16BIT ||
+        pdm_rx_cfg->slot_cfg.slot_mode != I2S_SLOT_MODE_MONO) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    handle->sample_rate = pdm_rx_cfg->clk_cfg.sample_rate_hz;
+    if (s_samples && s_sample_rate != handle->sample_rate) {
+        ESP_LOGW(TAG, "source is %" PRIu32 " Hz, channel runs at %" PRIu32 " Hz; pitch will shift", s_sample_rate,
+                 handle->sample_rate);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_register_event_callback(i2s_chan_handle_t handle, const i2s_event_callbacks_t* callbacks,
+                                              void* user_data) {
+    if (handle->enabled) {
+        return ESP_ERR_INVALID_STATE; // as on the target
+    }
+
+    handle->callbacks = *callbacks;
+    handle->user_data = user_data;
+
+    return ESP_OK;
+}
+
+/** When the sample before sample n has been captured, on the skewed sample clock */
+static int64_t sample_time_us(const struct host_i2s_channel* ch, uint64_t n) {
+    return ch->start_us + (int64_t)((double)n * 1e6 / (ch->sample_rate * s_clock_scale));
+}
+
+static void sleep_until(int64_t until_us) {
+    const int64_t us = until_us - esp_timer_get_time();
+    if (us <= 0) {
+        return;
+    }
+
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+/** The DMA: fill the descriptors in turn, each completion is an on_recv */
+static void dma_task(void* arg) {
+    struct host_i2s_channel* ch = arg;
+
+    for (uint32_t desc = 0; ch->enabled; desc = (desc + 1) % ch->dma_desc_num) {
+        int16_t* buf = ch->dma + (size_t)desc * ch->dma_frame_num;
+
+        sleep_until(sample_time_us(ch, ch->delivered + ch->dma_frame_num));
+        for (uint32_t i = 0; i < ch->dma_frame_num; i++) {
+            buf[i] = s_samples[(ch->delivered + i) % s_sample_count];
+        }
+        ch->delivered += ch->dma_frame_num;
+
+        i2s_event_data_t event = {.data = &buf, .size = ch->dma_frame_num * sizeof(int16_t)};
+        ch->callbacks.on_recv(ch, &event, ch->user_data);
+    }
+}
+
+esp_err_t i2s_channel_enable(i2s_chan_handle_t handle) {
+    if (s_samples == NULL) {
+        return ESP_ERR_INVALID_STATE; // host_mic_init was not called
+    }
+
+    handle->start_us = esp_timer_get_time();
+    handle->delivered = 0;
+    handle->enabled = true;
+
+    if (handle->callbacks.on_recv) {
+        handle->dma = calloc((size_t)handle->dma_desc_num * handle->dma_frame_num, sizeof(int16_t));
+        if (handle->dma == NULL || handle->dma_desc_num == 0) {
+            return ESP_ERR_NO_MEM;
+        }
+        if (xTaskCreate(dma_task, "i2s_dma", 4096, handle, 24, NULL) != pdPASS) {
+            return ESP_FAIL;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t i2s_channel_read(i2s_chan_handle_t handle, void* dest, size_t size, size_t* bytes_read,
+                           uint32_t timeout_ms) {
+    if (unlikely(!handle->enabled)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const size_t count = size / sizeof(int16_t);
+
+    // Block until the last requested sample would have been captured
+    const int64_t ready_us = sample_time_us(handle, handle->delivered + count);
+    const int64_t wait_us = ready_us - esp_timer_get_time();
+    if (wait_us > (int64_t)timeout_ms * 1000) {
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        *bytes_read = 0;
+        return ESP_ERR_TIMEOUT;
+    }
+    if (wait_us > 0) {
+        vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000));
+    }
+
+    int16_t* out = dest;
+    for (size_t i = 0; i < count; i++) {
+        out[i] = s_samples[(handle->delivered + i) % s_sample_count];
+    }
+    handle->delivered += count;
+    *bytes_read = count * sizeof(int16_t);
+
+    return ESP_OK;
+}
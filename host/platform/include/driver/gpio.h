@@ -0,0 +1,7 @@
+#pragma once
+
+typedef enum {
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_41 = 41,
+    GPIO_NUM_42 = 42,
+} gpio_num_t;
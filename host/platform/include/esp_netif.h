@@ -0,0 +1,28 @@
+#pragma once
+
+/* Network interfaces are managed by the host OS */
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct {
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct {
+    esp_ip4_addr_t ip;
+    esp_ip4_addr_t netmask;
+    esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+/* No default interface: callers fall back to letting the kernel route */
+static inline esp_netif_t* esp_netif_get_default_netif(void) {
+    return NULL;
+}
+
+static inline esp_err_t esp_netif_get_ip_info(esp_netif_t* esp_netif, esp_netif_ip_info_t* ip_info) {
+    return ESP_ERR_INVALID_ARG;
+}
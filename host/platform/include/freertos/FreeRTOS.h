@@ -0,0 +1,26 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "esp_attr.h"
+#include "esp_compiler.h"
+#include "sdkconfig.h"
+
+/* FreeRTOS subset implemented with pthreads */
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+
+#define configASSERT(x) assert(x)
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+/**
+ * Replay every *.jpg in dir, in name order, as camera frames at fps.
+ * fb_count bounds the frames checked out at once, like the driver's fb_count.
+ */
+esp_err_t host_camera_init(const char* dir, uint32_t fps, size_t fb_count);
+
+/**
+ * Feed the I2S RX channel from a 16-bit mono PCM WAV file, looped. With a
+ * NULL path a 440 Hz tone is generated instead. The sample clock runs
+ * clock_ppm parts per million fast against esp_timer (negative: slow), like
+ * a microphone on its own crystal.
+ */
+esp_err_t host_mic_init(const char* wav_path, double clock_ppm);
+
+/**
+ * Write every datagram sent through sendto/sendmsg to a pcap file (raw IPv4,
+ * nanosecond timestamps taken right before the send).
+ */
+esp_err_t host_pcap_open(const char* path);
+void host_pcap_close(void);
+
+/**
+ * Lose loss_pct % of what goes out, per 1448-byte segment: a UDP datagram
+ * vanishes (and is still in the pcap), a TCP send stalls its connection for
+ * rto_ms, the retransmission timeout, during which non-blocking sends fail
+ * with EAGAIN and blocking ones wait, as if the socket buffer were full.
+ * Pessimistic for TCP, where most losses are repaired in one round trip.
+ */
+void host_netsim_init(double loss_pct, uint32_t rto_ms);
+
+/** Whether a packet of len bytes is lost, for the socket wrappers */
+bool host_netsim_lose(size_t len);
+
+void host_log_set_level(esp_log_level_t level);
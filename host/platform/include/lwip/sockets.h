@@ -0,0 +1,35 @@
+#pragma once
+
+/* lwIP socket API mapped onto POSIX sockets */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "esp_random.h"
+#include "sdkconfig.h"
+
+#define closesocket(s) close(s)
+
+/* lwIP's inet_aton takes an ip4_addr_t, callers pass &sin_addr.s_addr */
+#define inet_aton(cp, addr) inet_aton((cp), (struct in_addr*)(addr))
+
+#define ERR_OK 0
+
+/* Like lwIP's compat macros, so the host can tap every datagram, see host_pcap_open and host_netsim_init */
+ssize_t host_sendto(int s, const void* data, size_t size, int flags, const struct sockaddr* to, socklen_t tolen);
+ssize_t host_sendmsg(int s, const struct msghdr* msg, int flags);
+ssize_t host_send(int s, const void* data, size_t size, int flags);
+
+#define sendto(s, data, size, flags, to, tolen) host_sendto(s, data, size, flags, to, tolen)
+#define sendmsg(s, msg, flags) host_sendmsg(s, msg, flags)
+#define send(s, data, size, flags) host_send(s, data, size, flags)
+
+#define DEFAULT_THREAD_STACKSIZE 4096
+#define DEFAULT_THREAD_PRIO 5
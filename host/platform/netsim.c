@@ -0,0 +1,70 @@
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "host.h"
+
+/* Not lwip/sockets.h: this file calls the real socket functions */
+ssize_t host_send(int s, const void* data, size_t size, int flags);
+
+static const char* const TAG = "host_netsim";
+
+#define NETSIM_MSS 1448 // Ethernet MTU minus IPv4, TCP and timestamp option headers
+
+static double s_loss; // per segment, 0..1
+static int64_t s_rto_us;
+static int64_t s_stalled_until[FD_SETSIZE]; // per TCP socket
+
+void host_netsim_init(double loss_pct, uint32_t rto_ms) {
+    s_loss = loss_pct / 100.0;
+    s_rto_us = rto_ms * 1000LL;
+    ESP_LOGI(TAG, "losing %.1f%% of sent packets, a TCP loss stalls for %" PRIu32 " ms", loss_pct, rto_ms);
+}
+
+bool host_netsim_lose(size_t len) {
+    if (s_loss <= 0.0) {
+        return false;
+    }
+
+    // any of its segments
+    const size_t segments = len / NETSIM_MSS + 1;
+    const double p = 1.0 - pow(1.0 - s_loss, (double)segments);
+    return esp_random() / 4294967296.0 < p;
+}
+
+static void sleep_us(int64_t us) {
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+ssize_t host_send(int s, const void* data, size_t size, int flags) {
+    if (s_loss > 0.0 && s >= 0 && s < FD_SETSIZE) {
+        const int64_t now = esp_timer_get_time();
+        int64_t until = __atomic_load_n(&s_stalled_until[s], __ATOMIC_RELAXED);
+
+        // the lost segment and everything after it wait for the retransmission
+        if (now >= until && host_netsim_lose(size)) {
+            until = now + s_rto_us;
+            __atomic_store_n(&s_stalled_until[s], until, __ATOMIC_RELAXED);
+        }
+
+        if (now < until) {
+            if (flags & MSG_DONTWAIT) {
+                errno = EAGAIN;
+                return -1;
+            }
+            sleep_us(until - now);
+        }
+    }
+
+    return send(s, data, size, flags);
+}
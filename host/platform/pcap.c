@@ -0,0 +1,201 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "esp_log.h"
+
+#include "host.h"
+
+/* Not lwip/sockets.h: this file calls the real socket functions */
+ssize_t host_sendto(int s, const void* data, size_t size, int flags, const struct sockaddr* to, socklen_t tolen);
+ssize_t host_sendmsg(int s, const struct msghdr* msg, int flags);
+
+static const char* const TAG = "host_pcap";
+
+#define PCAP_MAGIC_NS 0xA1B23C4DU
+#define PCAP_LINKTYPE_IPV4 228
+#define PCAP_SNAPLEN 65535
+
+#define IPV4_HEADER_SIZE 20
+#define UDP_HEADER_SIZE 8
+#define MAX_DATAGRAM (PCAP_SNAPLEN - IPV4_HEADER_SIZE - UDP_HEADER_SIZE)
+
+// stands in for an unbound source address (RFC 5737 documentation range)
+#define PCAP_UNKNOWN_SOURCE 0xC0000201U
+
+struct pcap_file_header {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct pcap_record_header {
+    uint32_t ts_sec;
+    uint32_t ts_nsec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+};
+
+static FILE* s_pcap;
+static pthread_mutex_t s_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint16_t s_ip_id;
+
+esp_err_t host_pcap_open(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "%s: %s", path, strerror(errno));
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const struct pcap_file_header header = {
+        .magic = PCAP_MAGIC_NS,
+        .version_major = 2,
+        .version_minor = 4,
+        .snaplen = PCAP_SNAPLEN,
+        .linktype = PCAP_LINKTYPE_IPV4,
+    };
+    fwrite(&header, sizeof(header), 1, f);
+    fflush(f);
+
+    pthread_mutex_lock(&s_lock);
+    s_pcap = f;
+    pthread_mutex_unlock(&s_lock);
+
+    ESP_LOGI(TAG, "capturing sent datagrams to %s", path);
+    return ESP_OK;
+}
+
+void host_pcap_close(void) {
+    pthread_mutex_lock(&s_lock);
+    if (s_pcap) {
+        fclose(s_pcap);
+        s_pcap = NULL;
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+static uint16_t ipv4_checksum(const uint8_t* header) {
+    uint32_t sum = 0;
+    for (int i = 0; i < IPV4_HEADER_SIZE; i += 2) {
+        sum += (header[i] << 8) | header[i + 1];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return ~sum & 0xFFFF;
+}
+
+/** Append one record: a synthesized IPv4/UDP header in front of the payload */
+static void record(int sock, const struct sockaddr* to, const struct timespec* ts, const struct iovec* iov,
+                   size_t iovcnt) {
+    if (to == NULL || to->sa_family != AF_INET) {
+        return;
+    }
+    const struct sockaddr_in* dst = (const struct sockaddr_in*)to;
+
+    size_t len = 0;
+    for (size_t i = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+    if (len > MAX_DATAGRAM) {
+        return;
+    }
+
+    struct sockaddr_in src = {0};
+    socklen_t src_len = sizeof(src);
+    getsockname(sock, (struct sockaddr*)&src, &src_len);
+    if (src.sin_addr.s_addr == htonl(INADDR_ANY)) {
+        src.sin_addr.s_addr = (ntohl(dst->sin_addr.s_addr) >> 24) == 127 ? dst->sin_addr.s_addr
+                                                                          : htonl(PCAP_UNKNOWN_SOURCE);
+    }
+
+    uint8_t header[IPV4_HEADER_SIZE + UDP_HEADER_SIZE] = {0};
+    const uint16_t total = sizeof(header) + len;
+    header[0] = 0x45; // IPv4, 5 words
+    header[2] = total >> 8;
+    header[3] = total & 0xFF;
+    header[4] = s_ip_id >> 8;
+    header[5] = s_ip_id & 0xFF;
+    header[6] = 0x40; // DF
+    header[8] = 64;   // TTL
+    header[9] = IPPROTO_UDP;
+    memcpy(header + 12, &src.sin_addr.s_addr, 4);
+    memcpy(header + 16, &dst->sin_addr.s_addr, 4);
+    const uint16_t checksum = ipv4_checksum(header);
+    header[10] = checksum >> 8;
+    header[11] = checksum & 0xFF;
+
+    uint8_t* udp = header + IPV4_HEADER_SIZE;
+    memcpy(udp, &src.sin_port, 2);
+    memcpy(udp + 2, &dst->sin_port, 2);
+    udp[4] = (UDP_HEADER_SIZE + len) >> 8;
+    udp[5] = (UDP_HEADER_SIZE + len) & 0xFF; // checksum 0: not computed
+
+    const struct pcap_record_header rec = {
+        .ts_sec = ts->tv_sec,
+        .ts_nsec = ts->tv_nsec,
+        .incl_len = total,
+        .orig_len = total,
+    };
+
+    pthread_mutex_lock(&s_lock);
+    if (s_pcap) {
+        s_ip_id++;
+        fwrite(&rec, sizeof(rec), 1, s_pcap);
+        fwrite(header, sizeof(header), 1, s_pcap);
+        for (size_t i = 0; i < iovcnt; i++) {
+            fwrite(iov[i].iov_base, 1, iov[i].iov_len, s_pcap);
+        }
+        fflush(s_pcap); // keep the file usable if the process is killed
+    }
+    pthread_mutex_unlock(&s_lock);
+}
+
+static inline bool capturing(void) {
+    return __atomic_load_n(&s_pcap, __ATOMIC_RELAXED) != NULL;
+}
+
+ssize_t host_sendto(int s, const void* data, size_t size, int flags, const struct sockaddr* to, socklen_t tolen) {
+    struct timespec ts;
+    const bool capture = capturing();
+    if (capture) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+    }
+
+    // a lost datagram still left the sender, it is recorded all the same
+    const ssize_t sent = host_netsim_lose(size) ? (ssize_t)size : sendto(s, data, size, flags, to, tolen);
+    if (capture && sent >= 0) {
+        const struct iovec iov = {.iov_base = (void*)data, .iov_len = size};
+        record(s, to, &ts, &iov, 1);
+    }
+
+    return sent;
+}
+
+ssize_t host_sendmsg(int s, const struct msghdr* msg, int flags) {
+    struct timespec ts;
+    const bool capture = capturing();
+    if (capture) {
+        clock_gettime(CLOCK_REALTIME, &ts);
+    }
+
+    size_t len = 0;
+    for (size_t i = 0; i < msg->msg_iovlen; i++) {
+        len += msg->msg_iov[i].iov_len;
+    }
+    const ssize_t sent = host_netsim_lose(len) ? (ssize_t)len : sendmsg(s, msg, flags);
+    if (capture && sent >= 0) {
+        record(s, msg->msg_name, &ts, msg->msg_iov, msg->msg_iovlen);
+    }
+
+    return sent;
+}
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "fec.h"
+#include "fec_decoder.h"
+
+static const char* const TAG = "fec_decoder";
+
+static inline uint16_t read_be16(const uint8_t* p) {
+    return ((uint16_t)p[0] << 8) | (uint16_t)p[1];
+}
+
+esp_err_t fec_decoder_init(struct fec_decoder* d) {
+    memset(d, 0, sizeof(*d));
+    d->history = calloc(FEC_DECODER_HISTORY, sizeof(struct fec_decoder_packet));
+    d->pending = calloc(FEC_DECODER_PENDING, sizeof(struct fec_decoder_parity));
+    if (d->history == NULL || d->pending == NULL) {
+        fec_decoder_free(d);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+void fec_decoder_free(struct fec_decoder* d) {
+    free(d->history);
+    free(d->pending);
+    d->history = NULL;
+    d->pending = NULL;
+}
+
+static struct fec_decoder_packet* find_media(struct fec_decoder* d, uint16_t seq) {
+    struct fec_decoder_packet* p = &d->history[seq % FEC_DECODER_HISTORY];
+    return p->valid && p->seq == seq ? p : NULL;
+}
+
+static void store_media(struct fec_decoder* d, const uint8_t* packet, size_t len) {
+    const uint16_t seq = read_be16(packet + 2);
+    struct fec_decoder_packet* p = &d->history[seq % FEC_DECODER_HISTORY];
+
+    p->valid = true;
+    p->seq = seq;
+    p->len = len;
+    memcpy(p->data, packet, len);
+
+    if (!d->started || (int16_t)(seq - d->newest_seq) > 0) {
+        d->newest_seq = seq;
+        d->started = true;
+    }
+}
+
+bool fec_decoder_add_media(struct fec_decoder* d, const uint8_t* packet, size_t len) {
+    if (len < sizeof(struct rtp_header) || len > RTP_PACKET_SIZE) {
+        return true;
+    }
+
+    const uint16_t seq = read_be16(packet + 2);
+    if (find_media(d, seq)) {
+        return false;
+    }
+
+    d->ssrc = ((uint32_t)read_be16(packet + 8) << 16) | read_be16(packet + 10);
+    store_media(d, packet, len);
+    return true;
+}
+
+void fec_decoder_add_parity(struct fec_decoder* d, const uint8_t* packet, size_t len) {
+    const size_t header = sizeof(struct rtp_header) + sizeof(struct fec_header) + FEC_ULP_HEADER_SIZE;
+    if (len < header + FEC_MASK_SIZE_SHORT) {
+        return;
+    }
+
+    d->parity_packets++;
+    d->parity_bytes += len;
+
+    const uint8_t* p = packet + sizeof(struct rtp_header);
+    if (p[0] & 0x80) {
+        return; // E bit: extension reserved by RFC 5109
+    }
+
+    const size_t mask_size = (p[0] & FEC_FLAG_LONG_MASK) ? FEC_MASK_SIZE_LONG : FEC_MASK_SIZE_SHORT;
+    const uint16_t protection_length = read_be16(p + sizeof(struct fec_header));
+    if (len < header + mask_size + protection_length || protection_length > RTP_PACKET_SIZE) {
+        return;
+    }
+
+    // reuse the oldest slot when everything is taken
+    struct fec_decoder_parity* slot = NULL;
+    for (size_t i = 0; i < FEC_DECODER_PENDING && slot == NULL; i++) {
+        if (!d->pending[i].valid) {
+            slot = &d->pending[i];
+        }
+    }
+    if (slot == NULL) {
+        slot = &d->pending[0];
+        for (size_t i = 1; i < FEC_DECODER_PENDING; i++) {
+            if ((int16_t)(d->pending[i].sn_base - slot->sn_base) < 0) {
+                slot = &d->pending[i];
+            }
+        }
+        d->unrecoverable++;
+    }
+
+    slot->valid = true;
+    slot->bits[0] = p[0];
+    slot->bits[1] = p[1];
+    slot->sn_base = read_be16(p + 2);
+    slot->ts = ((uint32_t)read_be16(p + 4) << 16) | read_be16(p + 6);
+    slot->length = read_be16(p + 8);
+    slot->protection_length = protection_length;
+
+    const uint8_t* m = p + sizeof(struct fec_header) + FEC_ULP_HEADER_SIZE;
+    slot->mask = 0;
+    for (size_t i = 0; i < mask_size; i++) {
+        slot->mask |= (uint64_t)m[i] << (40 - 8 * i);
+    }
+
+    memcpy(slot->payload, m + mask_size, protection_length);
+}
+
+/**
+ * Rebuild the single missing packet of a group (RFC 5109 section 8).
+ */
+static size_t recover_packet(struct fec_decoder* d, const struct fec_decoder_parity* f, uint16_t missing) {
+    uint8_t bits[2] = {f->bits[0], f->bits[1]};
+    uint32_t ts = f->ts;
+    uint16_t length = f->length;
+    uint8_t* out = d->recovered_packet;
+    uint8_t* payload = out + sizeof(struct rtp_header);
+
+    memcpy(payload, f->payload, f->protection_length);
+
+    for (unsigned bit = 0; bit < FEC_MAX_SPAN; bit++) {
+        const uint16_t seq = f->sn_base + bit;
+        if (!(f->mask & (1ULL << (FEC_MAX_SPAN - 1 - bit))) || seq == missing) {
+            continue;
+        }
+
+        const struct fec_decoder_packet* p = find_media(d, seq);
+        const size_t p_len = p->len - sizeof(struct rtp_header);
+        bits[0] ^= p->data[0];
+        bits[1] ^= p->data[1];
+        ts ^= ((uint32_t)read_be16(p->data + 4) << 16) | read_be16(p->data + 6);
+        length ^= p_len;
+
+        const size_t n = p_len < f->protection_length ? p_len : f->protection_length;
+        for (size_t i = 0; i < n; i++) {
+            payload[i] ^= p->data[sizeof(struct rtp_header) + i];
+        }
+    }
+
+    if (length > f->protection_length) {
+        ESP_LOGD(TAG, "seq %u: length %u beyond the protected %u bytes", missing, length, f->protection_length);
+        return 0;
+    }
+
+    out[0] = RTP_VERSION | (bits[0] & 0x3F);
+    out[1] = bits[1];
+    out[2] = missing >> 8;
+    out[3] = missing & 0xFF;
+    const uint32_t ts_be = htonl(ts);
+    const uint32_t ssrc_be = htonl(d->ssrc);
+    memcpy(out + 4, &ts_be, 4);
+    memcpy(out + 8, &ssrc_be, 4);
+
+    return sizeof(struct rtp_header) + length;
+}
+
+size_t fec_decoder_recover(struct fec_decoder* d, const uint8_t** packet) {
+    for (size_t i = 0; i < FEC_DECODER_PENDING; i++) {
+        struct fec_decoder_parity* f = &d->pending[i];
+        if (!f->valid) {
+            continue;
+        }
+
+        unsigned missing_count = 0;
+        uint16_t missing = 0;
+        uint16_t last = f->sn_base;
+        for (unsigned bit = 0; bit < FEC_MAX_SPAN; bit++) {
+            if (f->mask & (1ULL << (FEC_MAX_SPAN - 1 - bit))) {
+                last = f->sn_base + bit;
+                if (find_media(d, last) == NULL) {
+                    missing = last;
+                    missing_count++;
+                }
+            }
+        }
+
+        if (missing_count == 0) {
+            f->valid = false; // nothing lost in this group
+            continue;
+        }
+
+        if (missing_count > 1) {
+            // give up once the group has fallen out of the history
+            if (d->started && (uint16_t)(d->newest_seq - last) >= FEC_DECODER_HISTORY / 2) {
+                f->valid = false;
+                d->unrecoverable++;
+            }
+            continue;
+        }
+
+        f->valid = false;
+        const size_t len = recover_packet(d, f, missing);
+        if (len == 0) {
+            continue;
+        }
+
+        store_media(d, d->recovered_packet, len);
+        d->recovered++;
+        *packet = d->recovered_packet;
+        return len;
+    }
+
+    return 0;
+}
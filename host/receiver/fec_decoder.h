@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "common.h"
+
+/** Media packets kept for recovery, indexed by sequence number */
+#define FEC_DECODER_HISTORY 512
+/** Parity packets waiting for all but one of their media packets */
+#define FEC_DECODER_PENDING 64
+
+struct fec_decoder_packet {
+    bool valid;
+    uint16_t seq;
+    size_t len; // whole RTP packet
+    uint8_t data[RTP_PACKET_SIZE];
+};
+
+struct fec_decoder_parity {
+    bool valid;
+    uint16_t sn_base;
+    uint64_t mask; // bit 47 is sn_base
+    uint8_t bits[2];
+    uint32_t ts;
+    uint16_t length;
+    uint16_t protection_length;
+    uint8_t payload[RTP_PACKET_SIZE];
+};
+
+/**
+ * RFC 5109 ULPFEC level 0 decoder for one media stream. A parity packet
+ * rebuilds the one packet of its group that is missing; recovered packets
+ * go back into the history so they can complete other groups in turn.
+ */
+struct fec_decoder {
+    struct fec_decoder_packet* history;
+    struct fec_decoder_parity* pending;
+    uint32_t ssrc; // media SSRC, the FEC header does not carry it
+    bool started;
+    uint16_t newest_seq;
+    uint8_t recovered_packet[RTP_PACKET_SIZE];
+
+    uint32_t parity_packets;
+    uint64_t parity_bytes;
+    uint32_t recovered;
+    uint32_t unrecoverable; // parity dropped with more than one packet missing
+};
+
+esp_err_t fec_decoder_init(struct fec_decoder* d);
+void fec_decoder_free(struct fec_decoder* d);
+
+/**
+ * Store a media packet (RTP header included).
+ *
+ * @return false if the packet was already recovered, the caller should drop it
+ */
+bool fec_decoder_add_media(struct fec_decoder* d, const uint8_t* packet, size_t len);
+
+/** Store a parity packet (RTP header included) */
+void fec_decoder_add_parity(struct fec_decoder* d, const uint8_t* packet, size_t len);
+
+/**
+ * Rebuild the next missing packet the stored parity allows. Call until it
+ * returns 0 after every add.
+ *
+ * @return packet length, the packet is valid until the next call
+ */
+size_t fec_decoder_recover(struct fec_decoder* d, const uint8_t** packet);
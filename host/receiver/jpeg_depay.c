@@ -0,0 +1,312 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "jpeg.h"
+#include "jpeg_quant.h"
+
+#include "jpeg_depay.h"
+
+/* Standard Huffman tables (ITU-T T.81 K.3), the ones RFC 2435 payloads imply */
+
+static const uint8_t lum_dc_codelens[16] = {
+    0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+static const uint8_t lum_dc_symbols[12] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+};
+
+static const uint8_t lum_ac_codelens[16] = {
+    0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04, 0x04,
+    0x00, 0x00, 0x01, 0x7d,
+};
+
+static const uint8_t lum_ac_symbols[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06,
+    0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08,
+    0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72,
+    0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75,
+    0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3,
+    0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9,
+    0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+static const uint8_t chm_dc_codelens[16] = {
+    0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+static const uint8_t chm_dc_symbols[12] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+};
+
+static const uint8_t chm_ac_codelens[16] = {
+    0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04, 0x04,
+    0x00, 0x01, 0x02, 0x77,
+};
+
+static const uint8_t chm_ac_symbols[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41,
+    0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1,
+    0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74,
+    0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a,
+    0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+    0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4,
+    0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa,
+};
+
+static inline uint8_t* put_be16(uint8_t* p, uint16_t v) {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+    return p + 2;
+}
+
+static uint8_t* put_marker(uint8_t* p, uint8_t marker, uint16_t length) {
+    p[0] = 0xFF;
+    p[1] = marker;
+    return put_be16(p + 2, length);
+}
+
+static uint8_t* put_dqt(uint8_t* p, const uint8_t* table, uint8_t id) {
+    p = put_marker(p, JPEG_MARKER_DQT, 2 + 1 + QUANT_TABLE_SIZE);
+    *p++ = id; // 8-bit precision
+    memcpy(p, table, QUANT_TABLE_SIZE);
+    return p + QUANT_TABLE_SIZE;
+}
+
+static uint8_t* put_dht(uint8_t* p, const uint8_t* codelens, const uint8_t* symbols, size_t count, uint8_t class_id) {
+    p = put_marker(p, JPEG_MARKER_DHT, 2 + 1 + 16 + count);
+    *p++ = class_id;
+    memcpy(p, codelens, 16);
+    p += 16;
+    memcpy(p, symbols, count);
+    return p + count;
+}
+
+/**
+ * Write the JPEG headers for an RFC 2435 frame (RFC 2435 appendix B) and
+ * return the header length.
+ */
+static size_t make_headers(const struct jpeg_depay* d, uint8_t* out) {
+    uint8_t* p = out;
+
+    *p++ = 0xFF;
+    *p++ = JPEG_MARKER_SOI;
+
+    p = put_dqt(p, d->tables, 0);
+    p = put_dqt(p, d->tables + QUANT_TABLE_SIZE, 1);
+
+    if (d->restart_interval) {
+        p = put_marker(p, JPEG_MARKER_DRI, 4);
+        p = put_be16(p, d->restart_interval);
+    }
+
+    p = put_marker(p, JPEG_MARKER_SOF0, 17);
+    *p++ = 8; // precision
+    p = put_be16(p, d->height * 8);
+    p = put_be16(p, d->width * 8);
+    *p++ = 3;
+    *p++ = 0;                                                  // Y
+    *p++ = ((d->type & ~JPEG_TYPE_RESTART) == JPEG_TYPE_YUV420) ? 0x22 : 0x21; // 4:2:0 or 4:2:2
+    *p++ = 0;
+    *p++ = 1; // Cb
+    *p++ = 0x11;
+    *p++ = 1;
+    *p++ = 2; // Cr
+    *p++ = 0x11;
+    *p++ = 1;
+
+    p = put_dht(p, lum_dc_codelens, lum_dc_symbols, sizeof(lum_dc_symbols), 0x00);
+    p = put_dht(p, lum_ac_codelens, lum_ac_symbols, sizeof(lum_ac_symbols), 0x10);
+    p = put_dht(p, chm_dc_codelens, chm_dc_symbols, sizeof(chm_dc_symbols), 0x01);
+    p = put_dht(p, chm_ac_codelens, chm_ac_symbols, sizeof(chm_ac_symbols), 0x11);
+
+    p = put_marker(p, JPEG_MARKER_SOS, 12);
+    *p++ = 3;
+    *p++ = 0; // Y: DC 0, AC 0
+    *p++ = 0x00;
+    *p++ = 1; // Cb: DC 1, AC 1
+    *p++ = 0x11;
+    *p++ = 2; // Cr
+    *p++ = 0x11;
+    *p++ = 0;    // Ss
+    *p++ = 63;   // Se
+    *p++ = 0;    // Ah/Al
+
+    return p - out;
+}
+
+#define JPEG_DEPAY_MAX_HEADERS 1024
+
+esp_err_t jpeg_depay_init(struct jpeg_depay* d) {
+    memset(d, 0, sizeof(*d));
+
+    d->scan = malloc(JPEG_DEPAY_MAX_FRAME);
+    d->jfif = malloc(JPEG_DEPAY_MAX_HEADERS + JPEG_DEPAY_MAX_FRAME + 2);
+    if (d->scan == NULL || d->jfif == NULL) {
+        jpeg_depay_free(d);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+void jpeg_depay_free(struct jpeg_depay* d) {
+    free(d->scan);
+    free(d->jfif);
+    d->scan = NULL;
+    d->jfif = NULL;
+}
+
+static void start_frame(struct jpeg_depay* d, uint32_t rtp_ts, int64_t arrival_us) {
+    if (d->active) {
+        d->incomplete++;
+    }
+
+    d->started = true;
+    d->active = true;
+    d->rtp_ts = rtp_ts;
+    d->bytes = 0;
+    d->end = 0;
+    d->have_end = false;
+    d->packets = 0;
+    d->first_us = arrival_us;
+}
+
+static bool finish_frame(struct jpeg_depay* d, struct jpeg_depay_frame* out) {
+    size_t len = make_headers(d, d->jfif);
+    memcpy(d->jfif + len, d->scan, d->end);
+    len += d->end;
+
+    if (d->end < 2 || d->scan[d->end - 2] != 0xFF || d->scan[d->end - 1] != JPEG_MARKER_EOI) {
+        d->jfif[len++] = 0xFF;
+        d->jfif[len++] = JPEG_MARKER_EOI;
+    }
+
+    *out = (struct jpeg_depay_frame){
+        .jfif = d->jfif,
+        .len = len,
+        .rtp_ts = d->rtp_ts,
+        .width = d->width * 8,
+        .height = d->height * 8,
+        .type = d->type,
+        .q = d->q,
+        .packets = d->packets,
+        .first_us = d->first_us,
+        .last_us = d->last_us,
+    };
+
+    d->active = false;
+    d->complete++;
+    return true;
+}
+
+bool jpeg_depay_push(struct jpeg_depay* d, uint32_t rtp_ts, bool marker, const uint8_t* payload, size_t len,
+                     int64_t arrival_us, struct jpeg_depay_frame* out) {
+    if (len < sizeof(struct rtp_jpeg_header)) {
+        d->invalid++;
+        return false;
+    }
+
+    const struct rtp_jpeg_header* h = (const struct rtp_jpeg_header*)payload;
+    const size_t offset = ((size_t)h->fragment_offset[0] << 16) | (h->fragment_offset[1] << 8) | h->fragment_offset[2];
+    const uint8_t* p = payload + sizeof(*h);
+    const uint8_t* const payload_end = payload + len;
+
+    // a retransmission that missed its frame, or arrived after it completed
+    const int32_t age = rtp_ts - d->rtp_ts;
+    if (d->started && (age < 0 || (age == 0 && !d->active))) {
+        d->late++;
+        return false;
+    }
+    if (!d->active || d->rtp_ts != rtp_ts) {
+        start_frame(d, rtp_ts, arrival_us);
+    }
+
+    if ((h->type & ~JPEG_TYPE_RESTART) > JPEG_TYPE_YUV420) {
+        d->invalid++;
+        return false; // only types 0 and 1 are defined without out-of-band setup
+    }
+
+    uint16_t restart_interval = 0;
+    if (h->type & JPEG_TYPE_RESTART) {
+        if (p + sizeof(struct rtp_jpeg_restart_header) > payload_end) {
+            d->invalid++;
+            return false;
+        }
+        restart_interval = (p[0] << 8) | p[1];
+        p += sizeof(struct rtp_jpeg_restart_header);
+    }
+
+    if (offset == 0) {
+        d->type = h->type;
+        d->q = h->q;
+        d->width = h->width;
+        d->height = h->height;
+        d->restart_interval = restart_interval;
+
+        if (h->q >= 128) {
+            if (p + sizeof(struct jpeg_quant_header) > payload_end) {
+                d->invalid++;
+                return false;
+            }
+            const size_t tables_len = (p[2] << 8) | p[3];
+            p += sizeof(struct jpeg_quant_header);
+            if (p + tables_len > payload_end) {
+                d->invalid++;
+                return false;
+            }
+            // length 0 keeps the tables of the previous frame (RFC 2435 3.1.8)
+            if (tables_len == 2 * QUANT_TABLE_SIZE) {
+                memcpy(d->tables, p, tables_len);
+                d->have_tables = true;
+            } else if (tables_len == QUANT_TABLE_SIZE) {
+                memcpy(d->tables, p, QUANT_TABLE_SIZE);
+                memcpy(d->tables + QUANT_TABLE_SIZE, p, QUANT_TABLE_SIZE);
+                d->have_tables = true;
+            }
+            p += tables_len;
+        } else {
+            jpeg_quant_make_tables(h->q, d->tables, d->tables + QUANT_TABLE_SIZE);
+            d->have_tables = true;
+        }
+    }
+
+    const size_t fragment = payload_end - p;
+    if (offset + fragment > JPEG_DEPAY_MAX_FRAME) {
+        d->invalid++;
+        return false;
+    }
+
+    memcpy(d->scan + offset, p, fragment);
+    d->bytes += fragment;
+    d->packets++;
+    d->last_us = arrival_us;
+
+    if (marker) {
+        d->end = offset + fragment;
+        d->have_end = true;
+    }
+
+    // duplicates are filtered before the depacketizer, so byte counts add up
+    if (d->have_end && d->bytes == d->end && d->have_tables) {
+        return finish_frame(d, out);
+    }
+
+    return false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+/** Largest frame the depacketizer reassembles, the RFC 2435 offset field is 24 bits */
+#define JPEG_DEPAY_MAX_FRAME (4U * 1024U * 1024U)
+
+/** A reassembled frame, valid until the next jpeg_depay_push */
+struct jpeg_depay_frame {
+    const uint8_t* jfif; // complete JPEG file, headers rebuilt from the RTP headers
+    size_t len;
+    uint32_t rtp_ts;
+    uint16_t width;
+    uint16_t height;
+    uint8_t type;
+    uint8_t q;
+    uint32_t packets;
+    int64_t first_us; // arrival of the first and last fragment
+    int64_t last_us;
+};
+
+/** RFC 2435 reassembly state for one stream */
+struct jpeg_depay {
+    uint8_t* scan; // entropy-coded data placed by fragment offset
+    uint8_t* jfif;
+    bool started; // rtp_ts holds the newest frame seen
+    bool active;
+    uint32_t rtp_ts;
+    size_t bytes; // fragment bytes received for the current frame
+    size_t end;   // frame length, known once the marker packet arrived
+    bool have_end;
+    uint8_t type;
+    uint8_t q;
+    uint8_t width;
+    uint8_t height;
+    uint16_t restart_interval;
+    uint8_t tables[128]; // luma and chroma, zigzag order
+    bool have_tables;
+    uint32_t packets;
+    int64_t first_us;
+    int64_t last_us;
+
+    uint32_t complete;   // frames handed out
+    uint32_t incomplete; // frames abandoned with fragments missing
+    uint32_t invalid;    // payloads that could not be parsed
+    uint32_t late;       // fragments of a frame older than the one being assembled
+};
+
+esp_err_t jpeg_depay_init(struct jpeg_depay* d);
+void jpeg_depay_free(struct jpeg_depay* d);
+
+/**
+ * Feed one RTP payload of a JPEG stream.
+ *
+ * @return true when this fragment completed a frame; it is then described by out.
+ */
+bool jpeg_depay_push(struct jpeg_depay* d, uint32_t rtp_ts, bool marker, const uint8_t* payload, size_t len,
+                     int64_t arrival_us, struct jpeg_depay_frame* out);
@@ -0,0 +1,842 @@
+#include <getopt.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "common.h"
+#include "rtcp.h"
+
+#include "fec_decoder.h"
+#include "host.h"
+#include "jpeg_depay.h"
+#include "rtsp_client.h"
+#include "rx_stream.h"
+
+static const char* const TAG = "receiver";
+
+#define RX_REPORT_INTERVAL_US 1000000LL
+#define RX_CNAME "esp32rtp-receiver"
+#define RX_NACK_MAX_GAP 64 // a longer gap is an outage, not worth repairing
+
+/** Sample set for the summary percentiles */
+struct series {
+    double* values;
+    size_t count;
+    size_t cap;
+    double sum;
+};
+
+/** One RTP stream plus its RTCP port */
+struct rx_port {
+    const char* name;
+    int rtp_sock;
+    int rtcp_sock;
+    int channel; // interleaved RTP channel, RTCP on the next one; -1 over UDP
+    struct rx_stream stream;
+    struct sockaddr_in sender_rtcp; // where the sender's reports came from
+    bool have_sender;
+
+    uint32_t interval_received; // counters at the previous stats line
+    uint32_t interval_expected;
+    uint64_t interval_bytes;
+    uint32_t dropped_by_loss; // --loss simulation
+};
+
+struct options {
+    in_port_t video_port;
+    in_port_t audio_port;
+    const char* save_dir;
+    const char* wav_path;
+    const char* json_path;
+    unsigned duration;
+    double loss;
+    bool rtcp;
+    uint8_t fec_pt; // 0 = treat every payload type as media
+    bool nack;
+    struct in_addr group; // INADDR_ANY = unicast
+    struct in_addr iface;
+    const char* rtsp_url;
+    bool tcp;
+};
+
+static volatile sig_atomic_t s_stop;
+
+static struct rx_port s_video = {.name = "video"};
+static struct rx_port s_audio = {.name = "audio"};
+static struct jpeg_depay s_depay;
+static struct fec_decoder s_fec;
+static struct rtsp_client s_rtsp = {.sock = -1};
+static uint32_t s_interval_recovered;
+static uint32_t s_nack_requested;
+
+static uint32_t s_reporter_ssrc;
+static uint32_t s_interval_frames;
+static uint32_t s_saved;
+static struct series s_completion_ms;
+static struct series s_latency_ms;
+
+static FILE* s_wav;
+static uint32_t s_wav_samples;
+static double s_audio_sq_sum; // interval sum of squares for the level
+static uint32_t s_audio_samples;
+
+static void on_signal(int sig) {
+    s_stop = 1;
+}
+
+static void series_add(struct series* s, double v) {
+    if (s->count == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 256;
+        s->values = realloc(s->values, s->cap * sizeof(double));
+    }
+    s->values[s->count++] = v;
+    s->sum += v;
+}
+
+static int compare_double(const void* a, const void* b) {
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double series_percentile(struct series* s, double p) {
+    if (s->count == 0) {
+        return 0.0;
+    }
+    qsort(s->values, s->count, sizeof(double), compare_double);
+    return s->values[(size_t)(p * (s->count - 1) + 0.5)];
+}
+
+static int64_t unix_now_us(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static int bind_udp(in_port_t port, const struct options* opt) {
+    int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        return -1;
+    }
+
+    const int size = 4 * 1024 * 1024; // a UXGA frame arrives faster than we print
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    const bool multicast = opt->group.s_addr != htonl(INADDR_ANY);
+    if (multicast) {
+        // several receivers on one host share the group's ports
+        const int on = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+
+    struct sockaddr_in local = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(sock, (struct sockaddr*)&local, sizeof(local)) < 0) {
+        ESP_LOGE(TAG, "bind %u: %s", port, strerror(errno));
+        close(sock);
+        return -1;
+    }
+
+    if (multicast) {
+        const struct ip_mreq mreq = {.imr_multiaddr = opt->group, .imr_interface = opt->iface};
+        if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+            ESP_LOGE(TAG, "join %s: %s", inet_ntoa(opt->group), strerror(errno));
+            close(sock);
+            return -1;
+        }
+    }
+
+    return sock;
+}
+
+/* G.711 μ-law expansion */
+static int16_t ulaw_to_linear(uint8_t u) {
+    u = ~u;
+    int t = ((u & 0x0F) << 3) + 0x84;
+    t <<= (u & 0x70) >> 4;
+    return (u & 0x80) ? (0x84 - t) : (t - 0x84);
+}
+
+static void wav_write_header(FILE* f, uint32_t samples) {
+    const uint32_t rate = RTP_PCMU_CLOCK_RATE;
+    const uint32_t data = samples * 2;
+    uint8_t h[44];
+
+    memcpy(h, "RIFF", 4);
+    const uint32_t riff = 36 + data;
+    memcpy(h + 4, &riff, 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    const uint32_t fmt_len = 16;
+    const uint16_t pcm = 1, channels = 1, align = 2, bits = 16;
+    const uint32_t byte_rate = rate * 2;
+    memcpy(h + 16, &fmt_len, 4);
+    memcpy(h + 20, &pcm, 2);
+    memcpy(h + 22, &channels, 2);
+    memcpy(h + 24, &rate, 4);
+    memcpy(h + 28, &byte_rate, 4);
+    memcpy(h + 32, &align, 2);
+    memcpy(h + 34, &bits, 2);
+    memcpy(h + 36, "data", 4);
+    memcpy(h + 40, &data, 4);
+
+    fseek(f, 0, SEEK_SET);
+    fwrite(h, 1, sizeof(h), f);
+    fseek(f, 0, SEEK_END);
+}
+
+static bool simulate_loss(const struct options* opt) {
+    return opt->loss > 0.0 && (esp_random() / 4294967296.0) * 100.0 < opt->loss;
+}
+
+/** Payload of an RTP packet of n bytes, without CSRCs, extension and padding */
+static const uint8_t* rtp_payload(const uint8_t* buf, size_t n, size_t* len) {
+    // skip CSRCs and the extension header if a sender adds them
+    size_t header = sizeof(struct rtp_header) + (buf[0] & 0x0F) * 4;
+    if ((buf[0] & 0x10) && n >= header + 4) {
+        header += 4 + ((buf[header + 2] << 8) | buf[header + 3]) * 4;
+    }
+    size_t payload = n > header ? n - header : 0;
+    if ((buf[0] & 0x20) && payload > 0) {
+        payload -= buf[n - 1] < payload ? buf[n - 1] : payload; // padding
+    }
+
+    *len = payload;
+    return buf + header;
+}
+
+/** Feedback goes back the way the media came */
+static void send_rtcp(struct rx_port* port, const uint8_t* buf, size_t len) {
+    if (port->channel >= 0) {
+        rtsp_client_send_packet(&s_rtsp, port->channel + 1, buf, len);
+    } else {
+        sendto(port->rtcp_sock, buf, len, 0, (struct sockaddr*)&port->sender_rtcp, sizeof(port->sender_rtcp));
+    }
+}
+
+/**
+ * Ask for the gap [first, first + count) with RFC 4585 Generic NACKs, one FCI
+ * entry per 17 sequence numbers. Sent once per gap, a lost retransmission is
+ * not asked for again.
+ */
+static void send_nack(struct rx_port* port, uint16_t first, uint16_t count) {
+    if (!port->have_sender) {
+        return; // no SR yet, so no address to send feedback to
+    }
+
+    uint8_t buf[sizeof(struct rtcp_header) + 8 + (RX_NACK_MAX_GAP / 17 + 1) * sizeof(struct rtcp_nack)];
+    struct rtcp_header* h = (struct rtcp_header*)buf;
+    uint8_t* p = buf + sizeof(*h);
+
+    const uint32_t sender = htonl(s_reporter_ssrc);
+    const uint32_t media = htonl(port->stream.ssrc);
+    memcpy(p, &sender, 4);
+    memcpy(p + 4, &media, 4);
+    p += 8;
+
+    for (uint16_t i = 0; i < count; i += 17) {
+        uint16_t blp = 0;
+        for (uint16_t bit = 0; bit < 16 && i + 1 + bit < count; bit++) {
+            blp |= 1U << bit;
+        }
+        const struct rtcp_nack nack = {.pid = htons(first + i), .blp = htons(blp)};
+        memcpy(p, &nack, sizeof(nack));
+        p += sizeof(nack);
+    }
+
+    h->version = RTCP_VERSION | RTCP_FB_NACK;
+    h->type = RTCP_RTPFB;
+    h->length = htons((p - buf) / 4 - 1);
+
+    send_rtcp(port, buf, p - buf);
+    s_nack_requested += count;
+}
+
+/**
+ * Run one packet through the stream statistics; false if it is dropped.
+ * Parity packets are handed to the FEC decoder here, they have their own SSRC
+ * and sequence numbers and stay out of the media statistics.
+ */
+static bool receive_rtp(struct rx_port* port, const struct options* opt, const uint8_t* buf, size_t n,
+                        int64_t arrival_us) {
+    if (n < sizeof(struct rtp_header) || (buf[0] & 0xC0) != RTP_VERSION) {
+        return false;
+    }
+    if (simulate_loss(opt)) {
+        port->dropped_by_loss++;
+        return false;
+    }
+
+    const struct rtp_header* h = (const struct rtp_header*)buf;
+    if (port == &s_video && opt->fec_pt && (h->payloadtype & ~RTP_MARKER_MASK) == opt->fec_pt) {
+        fec_decoder_add_parity(&s_fec, buf, n);
+        return false;
+    }
+
+    const bool started = port->stream.started;
+    const uint16_t next_seq = port->stream.max_seq + 1;
+    if (!rx_stream_update(&port->stream, ntohl(h->ssrc), ntohs(h->seqNum), ntohl(h->timestamp), arrival_us,
+                          n - sizeof(*h))) {
+        return false;
+    }
+
+    const uint16_t gap = ntohs(h->seqNum) - next_seq;
+    if (opt->nack && port == &s_video && started && gap > 0 && gap <= RX_NACK_MAX_GAP) {
+        send_nack(port, next_seq, gap);
+    }
+
+    if (port == &s_video && opt->fec_pt && !fec_decoder_add_media(&s_fec, buf, n)) {
+        return false; // already recovered from parity
+    }
+
+    return true;
+}
+
+static void on_frame(const struct jpeg_depay_frame* frame, const struct options* opt) {
+    s_interval_frames++;
+    series_add(&s_completion_ms, (frame->last_us - frame->first_us) / 1000.0);
+
+    int64_t captured_us;
+    if (rx_stream_wallclock(&s_video.stream, frame->rtp_ts, &captured_us)) {
+        series_add(&s_latency_ms, (unix_now_us() - captured_us) / 1000.0);
+    }
+
+    if (opt->save_dir) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/frame_%06" PRIu32 ".jpg", opt->save_dir, s_saved++);
+        FILE* f = fopen(path, "wb");
+        if (f) {
+            fwrite(frame->jfif, 1, frame->len, f);
+            fclose(f);
+        } else {
+            ESP_LOGW(TAG, "%s: %s", path, strerror(errno));
+        }
+    }
+
+    ESP_LOGD(TAG, "frame ts %" PRIu32 " %ux%u type %u q %u, %" PRIu32 " packets, %zu bytes", frame->rtp_ts,
+             frame->width, frame->height, frame->type, frame->q, frame->packets, frame->len);
+}
+
+static void depacketize(const uint8_t* packet, size_t n, int64_t arrival_us, const struct options* opt) {
+    size_t len;
+    const uint8_t* payload = rtp_payload(packet, n, &len);
+
+    const struct rtp_header* h = (const struct rtp_header*)packet;
+    struct jpeg_depay_frame frame;
+    if (jpeg_depay_push(&s_depay, ntohl(h->timestamp), h->payloadtype & RTP_MARKER_MASK, payload, len, arrival_us,
+                        &frame)) {
+        on_frame(&frame, opt);
+    }
+}
+
+static void handle_video(const uint8_t* packet, size_t n, int64_t arrival_us, const struct options* opt) {
+    if (receive_rtp(&s_video, opt, packet, n, arrival_us)) {
+        depacketize(packet, n, arrival_us, opt);
+    }
+
+    // a media or a parity packet may have completed a group
+    const uint8_t* recovered;
+    while (opt->fec_pt && (n = fec_decoder_recover(&s_fec, &recovered)) > 0) {
+        s_interval_recovered++;
+        depacketize(recovered, n, arrival_us, opt);
+    }
+}
+
+static void handle_audio(const uint8_t* packet, size_t len, int64_t arrival_us, const struct options* opt) {
+    if (!receive_rtp(&s_audio, opt, packet, len, arrival_us)) {
+        return;
+    }
+    const uint8_t* payload = rtp_payload(packet, len, &len);
+
+    // a datagram may carry far more samples than one buffer, decode it a buffer at a time
+    int16_t pcm[2048];
+    for (size_t done = 0; done < len;) {
+        size_t chunk = len - done;
+        if (chunk > sizeof(pcm) / sizeof(pcm[0])) {
+            chunk = sizeof(pcm) / sizeof(pcm[0]);
+        }
+
+        for (size_t i = 0; i < chunk; i++) {
+            pcm[i] = ulaw_to_linear(payload[done + i]);
+            s_audio_sq_sum += (double)pcm[i] * pcm[i];
+        }
+
+        if (s_wav) {
+            fwrite(pcm, sizeof(int16_t), chunk, s_wav);
+            s_wav_samples += chunk;
+        }
+        done += chunk;
+    }
+    s_audio_samples += len;
+}
+
+/** Take the sender reports out of a compound packet; from is where to send feedback, NULL when interleaved */
+static void handle_rtcp(struct rx_port* port, const uint8_t* buf, size_t n, int64_t arrival_us,
+                        const struct sockaddr_in* from) {
+    size_t pos = 0;
+    while (pos + sizeof(struct rtcp_header) <= n) {
+        const struct rtcp_header* h = (const struct rtcp_header*)(buf + pos);
+        const size_t len = (ntohs(h->length) + 1) * 4;
+        if ((h->version & 0xC0) != RTCP_VERSION || pos + len > n) {
+            break;
+        }
+
+        if (h->type == RTCP_SR && len >= sizeof(*h) + sizeof(struct rtcp_sender_info)) {
+            struct rtcp_sender_info info;
+            memcpy(&info, h + 1, sizeof(info));
+            rx_stream_on_sr(&port->stream, ((uint64_t)ntohl(info.ntp_sec) << 32) | ntohl(info.ntp_frac),
+                            ntohl(info.rtp_ts), arrival_us);
+            if (from) {
+                port->sender_rtcp = *from;
+            }
+            port->have_sender = true;
+        } else if (h->type == RTCP_BYE) {
+            ESP_LOGI(TAG, "%s: BYE", port->name);
+        }
+
+        pos += len;
+    }
+}
+
+/** RR with one report block plus SDES CNAME, sent back to where the SRs come from */
+static void send_receiver_report(struct rx_port* port) {
+    struct rx_stream* s = &port->stream;
+    if (!port->have_sender || !s->started) {
+        return;
+    }
+
+    uint8_t buf[128];
+    uint8_t* p = buf;
+
+    struct rtcp_header* rr = (struct rtcp_header*)p;
+    rr->version = RTCP_VERSION | 1;
+    rr->type = RTCP_RR;
+    rr->length = htons((sizeof(*rr) + 4 + sizeof(struct rtcp_report_block)) / 4 - 1);
+    p += sizeof(*rr);
+
+    const uint32_t reporter = htonl(s_reporter_ssrc);
+    memcpy(p, &reporter, 4);
+    p += 4;
+
+    int32_t lost = rx_stream_lost(s);
+    lost = lost > 0x7FFFFF ? 0x7FFFFF : (lost < -0x800000 ? -0x800000 : lost);
+    const uint32_t dlsr = (uint32_t)((esp_timer_get_time() - s->sr_arrival_us) * 65536 / 1000000);
+
+    struct rtcp_report_block block = {
+        .ssrc = htonl(s->ssrc),
+        .lost = htonl(((uint32_t)rx_stream_fraction_lost(s) << 24) | ((uint32_t)lost & 0xFFFFFF)),
+        .highest_seq = htonl(rx_stream_extended_max(s)),
+        .jitter = htonl((uint32_t)s->jitter),
+        .lsr = htonl(s->sr_ntp_mid),
+        .dlsr = htonl(dlsr),
+    };
+    memcpy(p, &block, sizeof(block));
+    p += sizeof(block);
+
+    struct rtcp_header* sdes = (struct rtcp_header*)p;
+    uint8_t* sdes_start = p;
+    sdes->version = RTCP_VERSION | 1;
+    sdes->type = RTCP_SDES;
+    p += sizeof(*sdes);
+    memcpy(p, &reporter, 4);
+    p += 4;
+    *p++ = RTCP_SDES_CNAME;
+    *p++ = sizeof(RX_CNAME) - 1;
+    memcpy(p, RX_CNAME, sizeof(RX_CNAME) - 1);
+    p += sizeof(RX_CNAME) - 1;
+    do {
+        *p++ = RTCP_SDES_END; // at least one null octet, then pad to 32 bits
+    } while ((p - sdes_start) % 4);
+    sdes->length = htons((p - sdes_start) / 4 - 1);
+
+    send_rtcp(port, buf, p - buf);
+}
+
+static void read_rtp(struct rx_port* port, const struct options* opt) {
+    static uint8_t buf[65536];
+
+    const ssize_t n = recv(port->rtp_sock, buf, sizeof(buf), 0);
+    if (n <= 0) {
+        return;
+    }
+    if (port == &s_video) {
+        handle_video(buf, n, esp_timer_get_time(), opt);
+    } else {
+        handle_audio(buf, n, esp_timer_get_time(), opt);
+    }
+}
+
+static void read_rtcp(struct rx_port* port) {
+    uint8_t buf[1500];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+
+    const ssize_t n = recvfrom(port->rtcp_sock, buf, sizeof(buf), 0, (struct sockaddr*)&from, &from_len);
+    if (n > 0) {
+        handle_rtcp(port, buf, n, esp_timer_get_time(), &from);
+    }
+}
+
+static void on_interleaved(uint8_t channel, const uint8_t* data, size_t len, void* arg) {
+    const struct options* opt = arg;
+    const int64_t arrival_us = esp_timer_get_time();
+
+    if (channel == s_video.channel) {
+        handle_video(data, len, arrival_us, opt);
+    } else if (channel == s_audio.channel) {
+        handle_audio(data, len, arrival_us, opt);
+    } else if (channel == s_video.channel + 1) {
+        handle_rtcp(&s_video, data, len, arrival_us, NULL);
+    } else if (channel == s_audio.channel + 1) {
+        handle_rtcp(&s_audio, data, len, arrival_us, NULL);
+    }
+}
+
+static void print_interval(int64_t elapsed_us, int64_t interval_us) {
+    struct rx_port* ports[] = {&s_video, &s_audio};
+    const double seconds = interval_us / 1e6;
+
+    printf("[%5.1fs]", elapsed_us / 1e6);
+    for (size_t i = 0; i < 2; i++) {
+        struct rx_port* port = ports[i];
+        const struct rx_stream* s = &port->stream;
+        const uint32_t expected = rx_stream_expected(s) - port->interval_expected;
+        const uint32_t received = s->received - port->interval_received;
+        const int32_t lost = (int32_t)(expected - received);
+        const uint64_t bytes = s->bytes - port->interval_bytes;
+
+        printf(" %s %4" PRIu32 " pkt %6.0f kbit/s lost %3" PRId32 " (%4.1f%%) jitter %6.2f ms", port->name, received,
+               bytes * 8 / seconds / 1000, lost, expected ? lost * 100.0 / expected : 0.0,
+               s->clock_rate ? s->jitter * 1000.0 / s->clock_rate : 0.0);
+
+        if (port == &s_video) {
+            printf(" %4.1f fps", s_interval_frames / seconds);
+            if (s_completion_ms.count) {
+                printf(" completion %5.1f ms", s_completion_ms.values[s_completion_ms.count - 1]);
+            }
+            if (s_latency_ms.count) {
+                printf(" latency %5.1f ms", s_latency_ms.values[s_latency_ms.count - 1]);
+            }
+            if (s_fec.parity_packets) {
+                printf(" recovered %3" PRIu32, s_interval_recovered);
+            }
+            printf(" |");
+        } else if (s_audio_samples) {
+            printf(" level %5.1f dBFS", 10.0 * log10(s_audio_sq_sum / s_audio_samples / (32768.0 * 32768.0) + 1e-12));
+        }
+
+        port->interval_expected = rx_stream_expected(s);
+        port->interval_received = s->received;
+        port->interval_bytes = s->bytes;
+    }
+    printf("\n");
+    fflush(stdout);
+
+    s_interval_frames = 0;
+    s_interval_recovered = 0;
+    s_audio_sq_sum = 0.0;
+    s_audio_samples = 0;
+}
+
+static void json_stream(FILE* f, const struct rx_port* port, double seconds) {
+    const struct rx_stream* s = &port->stream;
+    const uint32_t expected = rx_stream_expected(s);
+    const int32_t lost = rx_stream_lost(s);
+
+    fprintf(f,
+            "\"%s\":{\"packets\":%" PRIu32 ",\"expected\":%" PRIu32 ",\"lost\":%" PRId32 ",\"loss_pct\":%.3f,"
+            "\"duplicates\":%" PRIu32 ",\"reordered\":%" PRIu32 ",\"simulated_drops\":%" PRIu32 ",\"bytes\":%" PRIu64
+            ",\"kbps\":%.1f,\"jitter_ms\":%.3f",
+            port->name, s->received, expected, lost, expected ? lost * 100.0 / expected : 0.0, s->duplicates,
+            s->reordered, port->dropped_by_loss, s->bytes, seconds > 0 ? s->bytes * 8 / seconds / 1000 : 0.0,
+            s->clock_rate ? s->jitter * 1000.0 / s->clock_rate : 0.0);
+}
+
+static void json_series(FILE* f, const char* name, struct series* s) {
+    fprintf(f, ",\"%s\":{\"count\":%zu,\"mean\":%.3f,\"p50\":%.3f,\"p95\":%.3f,\"max\":%.3f}", name, s->count,
+            s->count ? s->sum / s->count : 0.0, series_percentile(s, 0.5), series_percentile(s, 0.95),
+            series_percentile(s, 1.0));
+}
+
+static void write_summary(const char* path, double seconds) {
+    FILE* f = strcmp(path, "-") == 0 ? stdout : fopen(path, "w");
+    if (f == NULL) {
+        ESP_LOGE(TAG, "%s: %s", path, strerror(errno));
+        return;
+    }
+
+    fprintf(f, "{\"duration_s\":%.3f,", seconds);
+    json_stream(f, &s_video, seconds);
+    fprintf(f,
+            ",\"frames_complete\":%" PRIu32 ",\"frames_incomplete\":%" PRIu32 ",\"invalid_payloads\":%" PRIu32
+            ",\"fps\":%.2f",
+            s_depay.complete, s_depay.incomplete, s_depay.invalid, seconds > 0 ? s_depay.complete / seconds : 0.0);
+    json_series(f, "completion_ms", &s_completion_ms);
+    json_series(f, "latency_ms", &s_latency_ms);
+    fprintf(f,
+            ",\"fec\":{\"packets\":%" PRIu32 ",\"bytes\":%" PRIu64 ",\"overhead_pct\":%.2f,\"recovered\":%" PRIu32
+            ",\"unrecoverable\":%" PRIu32 "}",
+            s_fec.parity_packets, s_fec.parity_bytes,
+            s_video.stream.bytes ? s_fec.parity_bytes * 100.0 / s_video.stream.bytes : 0.0, s_fec.recovered,
+            s_fec.unrecoverable);
+    fprintf(f, ",\"nack\":{\"requested\":%" PRIu32 ",\"late_fragments\":%" PRIu32 "}", s_nack_requested,
+            s_depay.late);
+    fprintf(f, "},");
+    json_stream(f, &s_audio, seconds);
+    fprintf(f, "}}\n");
+
+    if (f != stdout) {
+        fclose(f);
+    }
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -p, --video-port N   RTP/JPEG port, RTCP on N+1 (default %d, 0 disables)\n"
+            "  -a, --audio-port N   RTP/PCMU port, RTCP on N+1 (default %d, 0 disables)\n"
+            "  -s, --save DIR       write every complete frame as DIR/frame_NNNNNN.jpg\n"
+            "  -w, --wav FILE       write the decoded audio as 8 kHz 16-bit WAV\n"
+            "  -j, --json FILE      write a JSON summary on exit ('-' for stdout)\n"
+            "  -d, --duration SEC   stop after SEC seconds (default: until interrupted)\n"
+            "  -l, --loss PCT       drop PCT %% of RTP packets on arrival\n"
+            "  -n, --no-rtcp        do not send receiver reports\n"
+            "  -f, --fec-pt N       ULPFEC payload type on the video port (default %d, 0 disables)\n"
+            "  -k, --nack           ask for lost video packets with RTCP Generic NACK\n"
+            "  -g, --group ADDR     join multicast group ADDR on both ports (e.g. %s)\n"
+            "  -i, --iface ADDR     local address of the interface to join on (default: any)\n"
+            "  -u, --rtsp URL       play rtsp://host:port/ with the ports above as client ports\n"
+            "  -t, --tcp            with --rtsp, take the media interleaved on the RTSP connection\n"
+            "  -v, --verbose        log every frame\n",
+            argv0, CONFIG_ESPRTP_UDP_VIDEO_PORT, CONFIG_ESPRTP_UDP_AUDIO_PORT, CONFIG_ESPRTP_FEC_PAYLOADTYPE,
+            CONFIG_ESPRTP_MULTICAST_ADDR);
+}
+
+static bool parse_options(int argc, char** argv, struct options* opt) {
+    static const struct option options[] = {
+        {"video-port", required_argument, NULL, 'p'}, {"audio-port", required_argument, NULL, 'a'},
+        {"save", required_argument, NULL, 's'},       {"wav", required_argument, NULL, 'w'},
+        {"json", required_argument, NULL, 'j'},       {"duration", required_argument, NULL, 'd'},
+        {"loss", required_argument, NULL, 'l'},       {"no-rtcp", no_argument, NULL, 'n'},
+        {"fec-pt", required_argument, NULL, 'f'},     {"nack", no_argument, NULL, 'k'},
+        {"group", required_argument, NULL, 'g'},      {"iface", required_argument, NULL, 'i'},
+        {"rtsp", required_argument, NULL, 'u'},       {"tcp", no_argument, NULL, 't'},
+        {"verbose", no_argument, NULL, 'v'},          {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    *opt = (struct options){
+        .video_port = CONFIG_ESPRTP_UDP_VIDEO_PORT,
+        .audio_port = CONFIG_ESPRTP_UDP_AUDIO_PORT,
+        .rtcp = true,
+        .fec_pt = CONFIG_ESPRTP_FEC_PAYLOADTYPE,
+        .group.s_addr = htonl(INADDR_ANY),
+        .iface.s_addr = htonl(INADDR_ANY),
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "p:a:s:w:j:d:l:nf:kg:i:u:tvh", options, NULL)) != -1) {
+        switch (c) {
+        case 'p':
+            opt->video_port = strtoul(optarg, NULL, 10);
+            break;
+        case 'a':
+            opt->audio_port = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            opt->save_dir = optarg;
+            break;
+        case 'w':
+            opt->wav_path = optarg;
+            break;
+        case 'j':
+            opt->json_path = optarg;
+            break;
+        case 'd':
+            opt->duration = strtoul(optarg, NULL, 10);
+            break;
+        case 'l':
+            opt->loss = strtod(optarg, NULL);
+            break;
+        case 'n':
+            opt->rtcp = false;
+            break;
+        case 'k':
+            opt->nack = true;
+            break;
+        case 'f':
+            opt->fec_pt = strtoul(optarg, NULL, 10) & 0x7F;
+            break;
+        case 'g':
+            if (inet_aton(optarg, &opt->group.s_addr) == 0 || !IN_MULTICAST(ntohl(opt->group.s_addr))) {
+                ESP_LOGE(TAG, "%s is not a multicast group", optarg);
+                return false;
+            }
+            break;
+        case 'i':
+            if (inet_aton(optarg, &opt->iface.s_addr) == 0) {
+                usage(argv[0]);
+                return false;
+            }
+            break;
+        case 'u':
+            opt->rtsp_url = optarg;
+            break;
+        case 't':
+            opt->tcp = true;
+            break;
+        case 'v':
+            host_log_set_level(ESP_LOG_DEBUG);
+            break;
+        default:
+            usage(argv[0]);
+            return false;
+        }
+    }
+
+    if (opt->tcp && opt->rtsp_url == NULL) {
+        ESP_LOGE(TAG, "--tcp needs --rtsp");
+        return false;
+    }
+
+    return true;
+}
+
+static bool open_port(struct rx_port* port, in_port_t rtp_port, uint32_t clock_rate, uint8_t channel,
+                      const struct options* opt) {
+    rx_stream_init(&port->stream, clock_rate);
+    port->rtp_sock = -1;
+    port->rtcp_sock = -1;
+    port->channel = -1;
+    if (rtp_port == 0) {
+        return true;
+    }
+
+    if (opt->tcp) {
+        port->channel = channel; // as rtsp_client_open sets them up
+        return true;
+    }
+
+    port->rtp_sock = bind_udp(rtp_port, opt);
+    port->rtcp_sock = bind_udp(rtp_port + 1, opt);
+    if (port->rtp_sock < 0 || port->rtcp_sock < 0) {
+        return false;
+    }
+
+    ESP_LOGI(TAG, "%s on port %u, RTCP %u", port->name, rtp_port, rtp_port + 1);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    struct options opt;
+    if (!parse_options(argc, argv, &opt)) {
+        return EXIT_FAILURE;
+    }
+
+    if (!open_port(&s_video, opt.video_port, RTP_JPEG_CLOCK_RATE, 0, &opt) ||
+        !open_port(&s_audio, opt.audio_port, RTP_PCMU_CLOCK_RATE, 2, &opt) || jpeg_depay_init(&s_depay) != ESP_OK ||
+        fec_decoder_init(&s_fec) != ESP_OK) {
+        return EXIT_FAILURE;
+    }
+
+    if (opt.wav_path) {
+        s_wav = fopen(opt.wav_path, "wb");
+        if (s_wav == NULL) {
+            ESP_LOGE(TAG, "%s: %s", opt.wav_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+        wav_write_header(s_wav, 0);
+    }
+
+    if (opt.rtsp_url && !rtsp_client_open(&s_rtsp, opt.rtsp_url, opt.video_port, opt.audio_port, opt.tcp)) {
+        rtsp_client_close(&s_rtsp);
+        return EXIT_FAILURE;
+    }
+
+    s_reporter_ssrc = esp_random();
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    const int64_t start_us = esp_timer_get_time();
+    int64_t last_report_us = start_us;
+
+    while (!s_stop) {
+        fd_set fds;
+        FD_ZERO(&fds);
+        int max_fd = -1;
+        const int socks[] = {s_video.rtp_sock, s_video.rtcp_sock, s_audio.rtp_sock, s_audio.rtcp_sock,
+                             opt.tcp ? s_rtsp.sock : -1};
+        for (size_t i = 0; i < sizeof(socks) / sizeof(socks[0]); i++) {
+            if (socks[i] >= 0) {
+                FD_SET(socks[i], &fds);
+                max_fd = socks[i] > max_fd ? socks[i] : max_fd;
+            }
+        }
+
+        struct timeval tv = {.tv_sec = 0, .tv_usec = 100000};
+        const int ready = select(max_fd + 1, &fds, NULL, NULL, &tv);
+        if (ready < 0 && errno != EINTR) {
+            ESP_LOGE(TAG, "select: %s", strerror(errno));
+            break;
+        }
+
+        if (ready > 0) {
+            if (s_video.rtp_sock >= 0 && FD_ISSET(s_video.rtp_sock, &fds)) {
+                read_rtp(&s_video, &opt);
+            }
+            if (s_audio.rtp_sock >= 0 && FD_ISSET(s_audio.rtp_sock, &fds)) {
+                read_rtp(&s_audio, &opt);
+            }
+            if (s_video.rtcp_sock >= 0 && FD_ISSET(s_video.rtcp_sock, &fds)) {
+                read_rtcp(&s_video);
+            }
+            if (s_audio.rtcp_sock >= 0 && FD_ISSET(s_audio.rtcp_sock, &fds)) {
+                read_rtcp(&s_audio);
+            }
+            if (opt.tcp && FD_ISSET(s_rtsp.sock, &fds) && !rtsp_client_read(&s_rtsp, on_interleaved, &opt)) {
+                break;
+            }
+        }
+
+        const int64_t now = esp_timer_get_time();
+        if (now - last_report_us >= RX_REPORT_INTERVAL_US) {
+            print_interval(now - start_us, now - last_report_us);
+            if (opt.rtcp) {
+                send_receiver_report(&s_video);
+                send_receiver_report(&s_audio);
+            }
+            last_report_us = now;
+        }
+
+        rtsp_client_poll(&s_rtsp);
+
+        if (opt.duration && now - start_us >= (int64_t)opt.duration * 1000000LL) {
+            break;
+        }
+    }
+
+    rtsp_client_close(&s_rtsp);
+
+    const double seconds = (esp_timer_get_time() - start_us) / 1e6;
+    if (opt.json_path) {
+        write_summary(opt.json_path, seconds);
+    }
+
+    if (s_wav) {
+        wav_write_header(s_wav, s_wav_samples);
+        fclose(s_wav);
+    }
+    jpeg_depay_free(&s_depay);
+    fec_decoder_free(&s_fec);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,377 @@
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "rtsp_client.h"
+
+static const char* const TAG = "rtsp_client";
+
+#define RTSP_CLIENT_RESPONSE_SIZE 2048
+#define RTSP_CLIENT_RECV_TIMEOUT_S 3
+#define RTSP_CLIENT_DEFAULT_PORT 554
+#define RTSP_CLIENT_DEFAULT_TIMEOUT_S 60
+
+static char s_response[RTSP_CLIENT_RESPONSE_SIZE + 1];
+
+/** Copy out a header value of the NUL terminated response head */
+static bool header(const char* head, const char* name, char* out, size_t size) {
+    const size_t name_len = strlen(name);
+
+    for (const char* line = strstr(head, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, name, name_len) != 0 || line[name_len] != ':') {
+            continue;
+        }
+
+        const char* v = line + name_len + 1;
+        while (*v == ' ') {
+            v++;
+        }
+        const char* end = strstr(v, "\r\n");
+        size_t n = end ? (size_t)(end - v) : strlen(v);
+        n = n < size ? n : size - 1;
+        memcpy(out, v, n);
+        out[n] = '\0';
+        return true;
+    }
+
+    return false;
+}
+
+static bool send_request(struct rtsp_client* c, const char* method, const char* url, const char* headers) {
+    char req[512];
+    int len = snprintf(req, sizeof(req), "%s %s RTSP/1.0\r\nCSeq: %u\r\nUser-Agent: esp32rtp-receiver\r\n", method,
+                       url, ++c->cseq);
+    if (c->session[0]) {
+        len += snprintf(req + len, sizeof(req) - len, "Session: %s\r\n", c->session);
+    }
+    len += snprintf(req + len, sizeof(req) - len, "%s\r\n", headers ? headers : "");
+
+    if (send(c->sock, req, len, MSG_NOSIGNAL) != len) {
+        ESP_LOGE(TAG, "%s: send: %s", method, strerror(errno));
+        return false;
+    }
+    c->last_request_us = esp_timer_get_time();
+    return true;
+}
+
+/**
+ * Send one request and wait for its response into s_response.
+ *
+ * @return the status code, -1 when the connection failed; *body points
+ *         at the NUL terminated body
+ */
+static int request(struct rtsp_client* c, const char* method, const char* url, const char* headers,
+                   const char** body) {
+    if (!send_request(c, method, url, headers)) {
+        return -1;
+    }
+
+    size_t got = 0;
+    size_t total = 0;
+    char* head_end = NULL;
+    while (total == 0 || got < total) {
+        if (got == RTSP_CLIENT_RESPONSE_SIZE) {
+            ESP_LOGE(TAG, "%s: response too large", method);
+            return -1;
+        }
+        const ssize_t n = recv(c->sock, s_response + got, RTSP_CLIENT_RESPONSE_SIZE - got, 0);
+        if (n <= 0) {
+            ESP_LOGE(TAG, "%s: %s", method, n == 0 ? "connection closed" : strerror(errno));
+            return -1;
+        }
+        got += n;
+        s_response[got] = '\0';
+
+        if (head_end == NULL && (head_end = strstr(s_response, "\r\n\r\n")) != NULL) {
+            char length[16] = "0";
+            header(s_response, "Content-Length", length, sizeof(length));
+            total = (head_end + 4 - s_response) + strtoul(length, NULL, 10);
+            if (total > RTSP_CLIENT_RESPONSE_SIZE) {
+                ESP_LOGE(TAG, "%s: response too large", method);
+                return -1;
+            }
+        }
+    }
+
+    // interleaved packets may follow the PLAY response in the same read
+    c->rx_len = got - total;
+    memcpy(c->rx, s_response + total, c->rx_len);
+    s_response[total] = '\0';
+
+    *body = head_end + 4;
+    head_end[2] = '\0'; // the head keeps its last CRLF for header()
+
+    int status = -1;
+    sscanf(s_response, "RTSP/1.0 %d", &status);
+    ESP_LOGD(TAG, "%s %s: %d", method, url, status);
+    return status;
+}
+
+static bool connect_url(struct rtsp_client* c, const char* url) {
+    char host[128];
+    unsigned port = RTSP_CLIENT_DEFAULT_PORT;
+    if (sscanf(url, "rtsp://%127[^:/]:%u", host, &port) < 1) {
+        ESP_LOGE(TAG, "%s: not an rtsp:// URL", url);
+        return false;
+    }
+
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_STREAM};
+    struct addrinfo* ai;
+    if (getaddrinfo(host, NULL, &hints, &ai) != 0) {
+        ESP_LOGE(TAG, "%s: unknown host", host);
+        return false;
+    }
+    struct sockaddr_in addr = *(struct sockaddr_in*)ai->ai_addr;
+    addr.sin_port = htons(port);
+    freeaddrinfo(ai);
+
+    c->sock = socket(PF_INET, SOCK_STREAM, IPPROTO_IP);
+    const struct timeval tv = {.tv_sec = RTSP_CLIENT_RECV_TIMEOUT_S};
+    setsockopt(c->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(c->sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        ESP_LOGE(TAG, "connect %s:%u: %s", host, port, strerror(errno));
+        close(c->sock);
+        c->sock = -1;
+        return false;
+    }
+
+    return true;
+}
+
+/** a=control of the m=<media> section, resolved against the base URL */
+static bool media_url(const struct rtsp_client* c, const char* sdp, const char* media, char* out, size_t size) {
+    const size_t media_len = strlen(media);
+    bool in_media = false;
+
+    for (const char* line = sdp; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+        if (strncmp(line, "m=", 2) == 0) {
+            in_media = strncmp(line + 2, media, media_len) == 0 && line[2 + media_len] == ' ';
+        } else if (in_media && strncmp(line, "a=control:", 10) == 0) {
+            const char* control = line + 10;
+            const int len = (int)strcspn(control, "\r\n");
+            const int n = strncmp(control, "rtsp://", 7) == 0 ? snprintf(out, size, "%.*s", len, control)
+                                                               : snprintf(out, size, "%s%.*s", c->base, len, control);
+            return n < (int)size;
+        }
+    }
+
+    return false;
+}
+
+static bool setup(struct rtsp_client* c, const char* sdp, const char* media, in_port_t port, uint8_t channel) {
+    char url[RTSP_CLIENT_URL_SIZE];
+    if (port == 0 || !media_url(c, sdp, media, url, sizeof(url))) {
+        return false;
+    }
+
+    char transport[96];
+    if (c->interleaved) {
+        snprintf(transport, sizeof(transport), "Transport: RTP/AVP/TCP;unicast;interleaved=%u-%u\r\n", channel,
+                 channel + 1);
+    } else {
+        snprintf(transport, sizeof(transport), "Transport: RTP/AVP;unicast;client_port=%u-%u\r\n", port, port + 1);
+    }
+    const char* body;
+    const int status = request(c, "SETUP", url, transport, &body);
+    if (status != 200) {
+        ESP_LOGE(TAG, "SETUP %s: %d", url, status);
+        return false;
+    }
+
+    // "id;timeout=N"
+    char session[sizeof(c->session)];
+    if (header(s_response, "Session", session, sizeof(session))) {
+        const char* timeout = strstr(session, ";timeout=");
+        c->timeout_s = timeout ? strtoul(timeout + 9, NULL, 10) : RTSP_CLIENT_DEFAULT_TIMEOUT_S;
+        session[strcspn(session, ";")] = '\0';
+        snprintf(c->session, sizeof(c->session), "%s", session);
+    }
+
+    char reply[128] = "";
+    header(s_response, "Transport", reply, sizeof(reply));
+    ESP_LOGI(TAG, "%s: %s", media, reply);
+    return true;
+}
+
+bool rtsp_client_open(struct rtsp_client* c, const char* url, in_port_t video_port, in_port_t audio_port, bool tcp) {
+    memset(c, 0, sizeof(*c));
+    c->sock = -1;
+    c->interleaved = tcp;
+    c->timeout_s = RTSP_CLIENT_DEFAULT_TIMEOUT_S;
+    snprintf(c->url, sizeof(c->url), "%s", url);
+    if (!connect_url(c, url)) {
+        return false;
+    }
+
+    const char* body;
+    int status = request(c, "OPTIONS", c->url, NULL, &body);
+    if (status != 200) {
+        ESP_LOGE(TAG, "OPTIONS: %d", status);
+        return false;
+    }
+
+    status = request(c, "DESCRIBE", c->url, "Accept: application/sdp\r\n", &body);
+    if (status != 200) {
+        ESP_LOGE(TAG, "DESCRIBE: %d", status);
+        return false;
+    }
+    if (!header(s_response, "Content-Base", c->base, sizeof(c->base))) {
+        const size_t len = strlen(c->url);
+        if (snprintf(c->base, sizeof(c->base), "%s%s", c->url, len && c->url[len - 1] == '/' ? "" : "/") >=
+            (int)sizeof(c->base)) {
+            ESP_LOGE(TAG, "%s: URL too long", url);
+            return false;
+        }
+    }
+
+    char sdp[RTSP_CLIENT_RESPONSE_SIZE];
+    snprintf(sdp, sizeof(sdp), "%s", body);
+    ESP_LOGD(TAG, "SDP:\n%s", sdp);
+
+    const bool video = setup(c, sdp, "video", video_port, 0);
+    const bool audio = setup(c, sdp, "audio", audio_port, 2);
+    if (!video && !audio) {
+        ESP_LOGE(TAG, "%s: nothing to play", url);
+        return false;
+    }
+
+    status = request(c, "PLAY", c->base, "Range: npt=0.000-\r\n", &body);
+    if (status != 200) {
+        ESP_LOGE(TAG, "PLAY: %d", status);
+        return false;
+    }
+    c->playing = true;
+
+    ESP_LOGI(TAG, "playing %s, session %s, timeout %u s", url, c->session, c->timeout_s);
+    return true;
+}
+
+void rtsp_client_poll(struct rtsp_client* c) {
+    if (c->sock < 0 || esp_timer_get_time() - c->last_request_us < c->timeout_s * 1000000LL / 3) {
+        return;
+    }
+
+    if (c->interleaved) {
+        send_request(c, "GET_PARAMETER", c->base, NULL); // rtsp_client_read takes the response
+        return;
+    }
+
+    const char* body;
+    const int status = request(c, "GET_PARAMETER", c->base, NULL, &body);
+    if (status != 200) {
+        ESP_LOGW(TAG, "keepalive: %d", status);
+    }
+}
+
+/** End of the head, at its blank line; NULL if it is not all there */
+static const uint8_t* find_head_end(const uint8_t* p, size_t len) {
+    for (size_t i = 0; i + 4 <= len; i++) {
+        if (memcmp(p + i, "\r\n\r\n", 4) == 0) {
+            return p + i;
+        }
+    }
+    return NULL;
+}
+
+/** Skip the response at the front of len bytes; 0 until all of it is there, -1 if it is not one */
+static ssize_t skip_response(const uint8_t* p, size_t len) {
+    const uint8_t* end = find_head_end(p, len);
+    if (end == NULL) {
+        return len < RTSP_CLIENT_RESPONSE_SIZE ? 0 : -1;
+    }
+
+    const size_t head = end + 4 - p;
+    if (head > RTSP_CLIENT_RESPONSE_SIZE) {
+        return -1;
+    }
+    memcpy(s_response, p, head);
+    s_response[head - 2] = '\0';
+
+    int status = -1;
+    if (sscanf(s_response, "RTSP/1.0 %d", &status) != 1) {
+        return -1;
+    }
+    if (status != 200) {
+        ESP_LOGW(TAG, "keepalive: %d", status);
+    }
+
+    char length[16] = "0";
+    header(s_response, "Content-Length", length, sizeof(length));
+    const size_t total = head + strtoul(length, NULL, 10);
+    return len >= total ? (ssize_t)total : 0;
+}
+
+bool rtsp_client_read(struct rtsp_client* c, rtsp_client_packet_cb on_packet, void* arg) {
+    const ssize_t n = recv(c->sock, c->rx + c->rx_len, sizeof(c->rx) - c->rx_len, MSG_DONTWAIT);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+        ESP_LOGE(TAG, "%s", n == 0 ? "connection closed" : strerror(errno));
+        return false;
+    }
+    c->rx_len += n > 0 ? n : 0;
+
+    size_t pos = 0;
+    while (pos < c->rx_len) {
+        const uint8_t* p = c->rx + pos;
+        const size_t left = c->rx_len - pos;
+
+        if (p[0] == '$') {
+            if (left < 4 || left < 4 + (size_t)((p[2] << 8) | p[3])) {
+                break;
+            }
+            const size_t len = (p[2] << 8) | p[3];
+            on_packet(p[1], p + 4, len, arg);
+            pos += 4 + len;
+            continue;
+        }
+
+        const ssize_t skip = skip_response(p, left);
+        if (skip < 0) {
+            ESP_LOGE(TAG, "neither an interleaved packet nor a response");
+            return false;
+        }
+        if (skip == 0) {
+            break;
+        }
+        pos += skip;
+    }
+
+    memmove(c->rx, c->rx + pos, c->rx_len - pos);
+    c->rx_len -= pos;
+    return true;
+}
+
+void rtsp_client_send_packet(struct rtsp_client* c, uint8_t channel, const uint8_t* data, size_t len) {
+    if (c->sock < 0 || len > 0xFFFF) {
+        return;
+    }
+
+    uint8_t framing[4] = {'$', channel, len >> 8, len & 0xFF};
+    struct iovec iov[] = {{framing, sizeof(framing)}, {(void*)data, len}};
+    const struct msghdr msg = {.msg_iov = iov, .msg_iovlen = 2};
+    if (sendmsg(c->sock, &msg, MSG_NOSIGNAL) != (ssize_t)(sizeof(framing) + len)) {
+        ESP_LOGW(TAG, "channel %u: send: %s", channel, strerror(errno));
+    }
+}
+
+void rtsp_client_close(struct rtsp_client* c) {
+    if (c->sock < 0) {
+        return;
+    }
+
+    const char* body;
+    if (c->session[0] && c->playing && c->interleaved) {
+        send_request(c, "TEARDOWN", c->base, NULL); // the response would queue behind media
+    } else if (c->session[0]) {
+        request(c, "TEARDOWN", c->base, NULL, &body);
+    }
+    close(c->sock);
+    c->sock = -1;
+}
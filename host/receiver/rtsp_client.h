@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "common.h"
+
+#define RTSP_CLIENT_URL_SIZE 256
+#define RTSP_CLIENT_RX_SIZE (2 * (4 + 65535)) // two of the largest interleaved frames
+
+/** Just enough RTSP/1.0 to play the sender's streams over UDP or interleaved on the connection */
+struct rtsp_client {
+    int sock;
+    bool interleaved; // RTP/AVP/TCP, video on channels 0-1 and audio on 2-3
+    bool playing;     // responses are read by rtsp_client_read from here on
+    char url[RTSP_CLIENT_URL_SIZE];
+    char base[RTSP_CLIENT_URL_SIZE]; // Content-Base, track controls are relative to it
+    char session[64];
+    unsigned cseq;
+    unsigned timeout_s;
+    int64_t last_request_us;
+    uint8_t rx[RTSP_CLIENT_RX_SIZE]; // received, not yet demultiplexed
+    size_t rx_len;
+};
+
+/** One interleaved packet; even channels carry RTP, odd ones RTCP */
+typedef void (*rtsp_client_packet_cb)(uint8_t channel, const uint8_t* data, size_t len, void* arg);
+
+/**
+ * Connect to rtsp://host[:port]/path, DESCRIBE it, SETUP the video and audio
+ * media on the given client ports (0 skips one) and PLAY. With tcp the media
+ * are interleaved on the connection instead and the ports only choose which
+ * of them to SETUP.
+ *
+ * @return false with the reason logged
+ */
+bool rtsp_client_open(struct rtsp_client* c, const char* url, in_port_t video_port, in_port_t audio_port, bool tcp);
+
+/**
+ * Read what the connection has and hand every complete interleaved packet to
+ * on_packet; responses to the keepalives are skipped.
+ *
+ * @return false if the connection closed or the stream is garbled
+ */
+bool rtsp_client_read(struct rtsp_client* c, rtsp_client_packet_cb on_packet, void* arg);
+
+/** Send an RTCP packet on an interleaved channel */
+void rtsp_client_send_packet(struct rtsp_client* c, uint8_t channel, const uint8_t* data, size_t len);
+
+/** Keep the session alive with GET_PARAMETER at a third of its timeout */
+void rtsp_client_poll(struct rtsp_client* c);
+
+/** TEARDOWN and close the connection */
+void rtsp_client_close(struct rtsp_client* c);
@@ -0,0 +1,102 @@
+#include <math.h>
+#include <string.h>
+
+#include "rtcp.h"
+
+#include "rx_stream.h"
+
+#define RTP_SEQ_MOD (1U << 16)
+#define MAX_DROPOUT 3000
+
+void rx_stream_init(struct rx_stream* s, uint32_t clock_rate) {
+    memset(s, 0, sizeof(*s));
+    s->clock_rate = clock_rate;
+}
+
+bool rx_stream_update(struct rx_stream* s, uint32_t ssrc, uint16_t seq, uint32_t rtp_ts, int64_t arrival_us,
+                      size_t bytes) {
+    if (!s->started || ssrc != s->ssrc) {
+        const uint32_t clock_rate = s->clock_rate;
+        rx_stream_init(s, clock_rate);
+        s->started = true;
+        s->ssrc = ssrc;
+        s->base_seq = seq;
+        s->max_seq = seq;
+    } else {
+        const uint16_t delta = seq - s->max_seq;
+        if (delta == 0) {
+            s->duplicates++;
+            return false;
+        }
+        if (delta < MAX_DROPOUT) {
+            if (seq < s->max_seq) {
+                s->cycles += RTP_SEQ_MOD;
+            }
+            s->max_seq = seq;
+        } else {
+            s->reordered++; // late or duplicated older packet, counted as received like A.1 does
+        }
+    }
+
+    s->received++;
+    s->bytes += bytes;
+
+    // interarrival jitter, A.8
+    const int64_t arrival = arrival_us * s->clock_rate / 1000000;
+    const int64_t transit = arrival - rtp_ts;
+    if (s->received > 1) {
+        const double d = fabs((double)(int32_t)(transit - s->transit));
+        s->jitter += (d - s->jitter) / 16.0;
+    }
+    s->transit = transit;
+
+    return true;
+}
+
+uint32_t rx_stream_extended_max(const struct rx_stream* s) {
+    return s->cycles + s->max_seq;
+}
+
+uint32_t rx_stream_expected(const struct rx_stream* s) {
+    return s->started ? rx_stream_extended_max(s) - s->base_seq + 1 : 0;
+}
+
+int32_t rx_stream_lost(const struct rx_stream* s) {
+    return (int32_t)(rx_stream_expected(s) - s->received);
+}
+
+uint8_t rx_stream_fraction_lost(struct rx_stream* s) {
+    const uint32_t expected = rx_stream_expected(s);
+    const uint32_t expected_interval = expected - s->expected_prior;
+    const uint32_t received_interval = s->received - s->received_prior;
+    s->expected_prior = expected;
+    s->received_prior = s->received;
+
+    const int32_t lost_interval = (int32_t)(expected_interval - received_interval);
+    if (expected_interval == 0 || lost_interval <= 0) {
+        return 0;
+    }
+
+    return (uint8_t)(((uint32_t)lost_interval << 8) / expected_interval);
+}
+
+void rx_stream_on_sr(struct rx_stream* s, uint64_t ntp, uint32_t rtp_ts, int64_t arrival_us) {
+    s->have_sr = true;
+    s->sr_ntp = ntp;
+    s->sr_ntp_mid = (uint32_t)(ntp >> 16);
+    s->sr_rtp_ts = rtp_ts;
+    s->sr_arrival_us = arrival_us;
+}
+
+bool rx_stream_wallclock(const struct rx_stream* s, uint32_t rtp_ts, int64_t* unix_us) {
+    if (!s->have_sr) {
+        return false;
+    }
+
+    const int64_t sr_us = (int64_t)((s->sr_ntp >> 32) - RTCP_NTP_UNIX_OFFSET) * 1000000LL +
+                          (int64_t)(((s->sr_ntp & 0xFFFFFFFFULL) * 1000000ULL) >> 32);
+    const int32_t delta = (int32_t)(rtp_ts - s->sr_rtp_ts);
+    *unix_us = sr_us + (int64_t)delta * 1000000LL / s->clock_rate;
+
+    return true;
+}
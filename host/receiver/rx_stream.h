@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** Reception statistics of one RTP source, RFC 3550 appendix A.1, A.3 and A.8 */
+struct rx_stream {
+    uint32_t clock_rate;
+    bool started;
+    uint32_t ssrc;
+    uint16_t max_seq;
+    uint32_t cycles; // sequence number wraps, shifted by 16
+    uint32_t base_seq;
+    uint32_t received;
+    uint32_t duplicates;
+    uint32_t reordered;
+    uint64_t bytes;
+
+    uint32_t expected_prior; // state for the RR fraction lost
+    uint32_t received_prior;
+
+    int64_t transit;
+    double jitter; // RTP timestamp units
+
+    // last sender report, for LSR/DLSR and wallclock mapping
+    bool have_sr;
+    uint32_t sr_ntp_mid;
+    int64_t sr_arrival_us;
+    uint64_t sr_ntp;
+    uint32_t sr_rtp_ts;
+};
+
+void rx_stream_init(struct rx_stream* s, uint32_t clock_rate);
+
+/**
+ * Account for one packet.
+ *
+ * @return false for a duplicate, which the caller should drop
+ */
+bool rx_stream_update(struct rx_stream* s, uint32_t ssrc, uint16_t seq, uint32_t rtp_ts, int64_t arrival_us,
+                      size_t bytes);
+
+uint32_t rx_stream_extended_max(const struct rx_stream* s);
+uint32_t rx_stream_expected(const struct rx_stream* s);
+int32_t rx_stream_lost(const struct rx_stream* s);
+
+/** Fraction lost (of 256) since the previous call, as carried in a report block */
+uint8_t rx_stream_fraction_lost(struct rx_stream* s);
+
+/** Record a sender report: NTP timestamp (32.32) and its RTP timestamp */
+void rx_stream_on_sr(struct rx_stream* s, uint64_t ntp, uint32_t rtp_ts, int64_t arrival_us);
+
+/**
+ * Wallclock (Unix microseconds) at which the sender sampled rtp_ts, from the
+ * last sender report. False until one arrived.
+ */
+bool rx_stream_wallclock(const struct rx_stream* s, uint32_t rtp_ts, int64_t* unix_us);
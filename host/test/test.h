@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Minimal checks for the host tests: a failed CHECK reports and the test exits non-zero */
+
+static int test_failures;
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);                                   \
+            test_failures++;                                                                                           \
+        }                                                                                                              \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                                 \
+    do {                                                                                                               \
+        const long long a_ = (long long)(a);                                                                           \
+        const long long b_ = (long long)(b);                                                                           \
+        if (a_ != b_) {                                                                                                \
+            fprintf(stderr, "%s:%d: %s == %lld, expected %s == %lld\n", __FILE__, __LINE__, #a, a_, #b, b_);           \
+            test_failures++;                                                                                           \
+        }                                                                                                              \
+    } while (0)
+
+#define RUN(test)                                                                                                      \
+    do {                                                                                                               \
+        const int before_ = test_failures;                                                                             \
+        test();                                                                                                        \
+        printf("%s %s\n", test_failures == before_ ? "ok  " : "FAIL", #test);                                          \
+    } while (0)
+
+#define TEST_EXIT() (test_failures ? EXIT_FAILURE : EXIT_SUCCESS)
@@ -0,0 +1,136 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "audio_clock.h"
+
+#include "test.h"
+
+#define RATE 8000U
+#define FRAME 160U
+#define SECONDS 60U
+#define FRAMES (SECONDS * RATE / FRAME)
+#define START_US 123456789LL // any uptime, the clock only looks at differences
+
+struct run {
+    uint32_t gaps;   // frames whose timestamp is not where the last one ended
+    int32_t max_offset;
+    struct audio_clock_stats stats;
+};
+
+/**
+ * Capture FRAMES frames with the I2S clock ppm parts per million fast, every
+ * lose_every-th one lost (0: none), and send each with the step it asked for.
+ */
+static void capture(int32_t ppm, uint32_t lose_every, struct run* out) {
+    struct audio_clock c;
+    audio_clock_init(&c, RATE);
+
+    const double frame_us = FRAME * 1e6 / (RATE * (1.0 + ppm * 1e-6));
+    uint32_t next_ts = 0;
+    bool first = true;
+
+    out->gaps = 0;
+    out->max_offset = 0;
+    for (uint32_t seq = 0; seq < FRAMES; seq++) {
+        if (lose_every && seq % lose_every == lose_every - 1) {
+            next_ts += FRAME; // lost frames leave their samples' worth of timestamps
+            continue;
+        }
+
+        uint32_t ts;
+        const int step = audio_clock_update(&c, seq, FRAME, START_US + (int64_t)((seq + 1) * frame_us), &ts);
+        CHECK(step >= -1 && step <= 1);
+        audio_clock_commit(&c, step);
+
+        out->gaps += !first && ts != next_ts;
+        next_ts = ts + FRAME + step;
+        first = false;
+
+        struct audio_clock_stats stats;
+        audio_clock_get_stats(&c, &stats);
+        if (abs(stats.offset) > out->max_offset) {
+            out->max_offset = abs(stats.offset);
+        }
+    }
+
+    audio_clock_get_stats(&c, &out->stats);
+}
+
+/* A fast I2S clock is measured as positive drift and held back by dropping samples */
+static void test_fast_clock_drops(void) {
+    struct run r;
+    capture(500, 0, &r);
+
+    CHECK(abs(r.stats.drift_ppm - 500) <= 2);
+    CHECK_EQ(r.stats.inserted, 0);
+    CHECK(abs((int)r.stats.dropped - (int)(RATE * SECONDS * 500 / 1000000)) <= 2);
+    CHECK_EQ(r.gaps, 0);
+    CHECK(r.max_offset <= 2);
+}
+
+/* A slow one is negative drift and catches up by inserting them */
+static void test_slow_clock_inserts(void) {
+    struct run r;
+    capture(-300, 0, &r);
+
+    CHECK(abs(r.stats.drift_ppm + 300) <= 2);
+    CHECK_EQ(r.stats.dropped, 0);
+    CHECK(abs((int)r.stats.inserted - (int)(RATE * SECONDS * 300 / 1000000)) <= 2);
+    CHECK_EQ(r.gaps, 0);
+    CHECK(r.max_offset <= 2);
+}
+
+/* Crystals within the smoothing leave the samples alone */
+static void test_nominal_clock_untouched(void) {
+    struct run r;
+    capture(0, 0, &r);
+
+    CHECK(abs(r.stats.drift_ppm) <= 1);
+    CHECK_EQ(r.stats.inserted, 0);
+    CHECK_EQ(r.stats.dropped, 0);
+    CHECK_EQ(r.gaps, 0);
+}
+
+/* A lost frame is a gap of its samples, and the clock keeps adjusting around it */
+static void test_lost_frames_leave_gaps(void) {
+    struct run r;
+    capture(500, 7, &r);
+
+    CHECK(abs(r.stats.drift_ppm - 500) <= 2);
+    CHECK(abs((int)r.stats.dropped - (int)(RATE * SECONDS * 500 / 1000000)) <= 2);
+    CHECK_EQ(r.gaps, 0);
+    CHECK(r.max_offset <= 2);
+}
+
+/* A step the frame did not go out with is asked for again on the next one */
+static void test_uncommitted_step_repeats(void) {
+    struct audio_clock c;
+    audio_clock_init(&c, RATE);
+
+    const double frame_us = FRAME * 1e6 / (RATE * (1.0 + 5000 * 1e-6));
+    uint32_t ts;
+    int step = 0;
+    uint32_t seq = 0;
+    for (; seq < FRAMES && step == 0; seq++) {
+        step = audio_clock_update(&c, seq, FRAME, START_US + (int64_t)((seq + 1) * frame_us), &ts);
+        audio_clock_commit(&c, 0); // lost on the way out
+    }
+    CHECK_EQ(step, -1);
+
+    CHECK_EQ(audio_clock_update(&c, seq, FRAME, START_US + (int64_t)((seq + 1) * frame_us), &ts), -1);
+    audio_clock_commit(&c, -1);
+
+    struct audio_clock_stats stats;
+    audio_clock_get_stats(&c, &stats);
+    CHECK_EQ(stats.dropped, 1);
+}
+
+int main(void) {
+    RUN(test_fast_clock_drops);
+    RUN(test_slow_clock_inserts);
+    RUN(test_nominal_clock_untouched);
+    RUN(test_lost_frames_leave_gaps);
+    RUN(test_uncommitted_step_repeats);
+
+    return TEST_EXIT();
+}
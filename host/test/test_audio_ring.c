@@ -0,0 +1,152 @@
+#include <stdint.h>
+
+#include "audio_ring.h"
+
+#include "test.h"
+
+#define FRAME 160
+
+static int16_t s_dma[AUDIO_RING_SLOTS * 2][FRAME];
+
+static const int16_t* dma_buffer(uint32_t n) {
+    return s_dma[n % (AUDIO_RING_SLOTS * 2)];
+}
+
+/* Frames come out in order, across many turns of the slots and the 32-bit indices */
+static void test_wraparound(void) {
+    struct audio_ring r;
+    struct audio_ring_frame f;
+
+    audio_ring_init(&r, AUDIO_RING_SLOTS * 2);
+    // start just short of the index wrap
+    r.head = r.tail = UINT32_MAX - 5;
+    r.stats.produced = UINT32_MAX - 5;
+
+    uint32_t pushed = 0;
+    uint32_t popped = 0;
+    for (uint32_t round = 0; round < 100; round++) {
+        // alternate between a nearly full and a nearly empty ring
+        const uint32_t burst = round % 2 ? AUDIO_RING_SLOTS - 1 : 3;
+        for (uint32_t i = 0; i < burst; i++, pushed++) {
+            CHECK(audio_ring_push(&r, dma_buffer(pushed), FRAME, pushed));
+        }
+        while (audio_ring_peek(&r, &f)) {
+            CHECK(f.pcm == dma_buffer(popped));
+            CHECK_EQ(f.samples, FRAME);
+            CHECK_EQ(f.captured_us, popped);
+            CHECK(audio_ring_release(&r, &f));
+            popped++;
+        }
+    }
+
+    struct audio_ring_stats stats;
+    audio_ring_get_stats(&r, &stats);
+    CHECK_EQ(popped, pushed);
+    CHECK_EQ(stats.consumed, pushed);
+    CHECK_EQ(stats.overruns, 0);
+    CHECK_EQ(stats.late, 0);
+}
+
+/* A full ring drops the new frame and counts it, the queued ones stay intact */
+static void test_overrun(void) {
+    struct audio_ring r;
+    struct audio_ring_frame f;
+
+    audio_ring_init(&r, AUDIO_RING_SLOTS * 2);
+    for (uint32_t i = 0; i < AUDIO_RING_SLOTS; i++) {
+        CHECK(audio_ring_push(&r, dma_buffer(i), FRAME, i));
+    }
+    CHECK(!audio_ring_push(&r, dma_buffer(AUDIO_RING_SLOTS), FRAME, AUDIO_RING_SLOTS));
+    CHECK(!audio_ring_push(&r, dma_buffer(AUDIO_RING_SLOTS + 1), FRAME, AUDIO_RING_SLOTS + 1));
+
+    struct audio_ring_stats stats;
+    audio_ring_get_stats(&r, &stats);
+    CHECK_EQ(stats.produced, AUDIO_RING_SLOTS + 2);
+    CHECK_EQ(stats.overruns, 2);
+
+    for (uint32_t i = 0; i < AUDIO_RING_SLOTS; i++) {
+        CHECK(audio_ring_peek(&r, &f));
+        CHECK_EQ(f.captured_us, i);
+        CHECK_EQ(f.seq, i);
+        CHECK(audio_ring_release(&r, &f));
+    }
+    CHECK(!audio_ring_peek(&r, &f));
+
+    // room again
+    CHECK(audio_ring_push(&r, dma_buffer(0), FRAME, 100));
+    CHECK(audio_ring_peek(&r, &f));
+    CHECK_EQ(f.captured_us, 100);
+}
+
+/* Frames the DMA came back to before they were peeked are skipped and counted late */
+static void test_peek_skips_stale(void) {
+    struct audio_ring r;
+    struct audio_ring_frame f;
+
+    audio_ring_init(&r, 2);
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(audio_ring_push(&r, dma_buffer(i), FRAME, i));
+    }
+
+    // 4 buffers completed: the DMA is back in those of frames 0 and 1
+    CHECK(audio_ring_peek(&r, &f));
+    CHECK_EQ(f.seq, 2);
+
+    struct audio_ring_stats stats;
+    audio_ring_get_stats(&r, &stats);
+    CHECK_EQ(stats.late, 2);
+}
+
+/* A frame overwritten while it was being read fails its release, whatever was made of it is void */
+static void test_release_detects_stale(void) {
+    struct audio_ring r;
+    struct audio_ring_frame f;
+
+    audio_ring_init(&r, 2);
+    CHECK(audio_ring_push(&r, dma_buffer(0), FRAME, 0));
+    CHECK(audio_ring_peek(&r, &f));
+
+    // one more frame still leaves it intact
+    CHECK(audio_ring_push(&r, dma_buffer(1), FRAME, 1));
+    CHECK(audio_ring_release(&r, &f));
+
+    CHECK(audio_ring_peek(&r, &f));
+    CHECK_EQ(f.seq, 1);
+    CHECK(audio_ring_push(&r, dma_buffer(2), FRAME, 2));
+    CHECK(audio_ring_push(&r, dma_buffer(3), FRAME, 3));
+    CHECK(!audio_ring_release(&r, &f));
+
+    struct audio_ring_stats stats;
+    audio_ring_get_stats(&r, &stats);
+    CHECK_EQ(stats.consumed, 1);
+    CHECK_EQ(stats.late, 1);
+
+    // the slot was given up all the same, the next frame follows
+    CHECK(audio_ring_peek(&r, &f));
+    CHECK_EQ(f.seq, 2);
+}
+
+static void test_underrun(void) {
+    struct audio_ring r;
+    struct audio_ring_frame f;
+
+    audio_ring_init(&r, 2);
+    CHECK(!audio_ring_peek(&r, &f));
+    audio_ring_underrun(&r);
+    audio_ring_underrun(&r);
+
+    struct audio_ring_stats stats;
+    audio_ring_get_stats(&r, &stats);
+    CHECK_EQ(stats.underruns, 2);
+    CHECK_EQ(stats.late, 0);
+}
+
+int main(void) {
+    RUN(test_wraparound);
+    RUN(test_overrun);
+    RUN(test_peek_skips_stale);
+    RUN(test_release_detects_stale);
+    RUN(test_underrun);
+
+    return TEST_EXIT();
+}
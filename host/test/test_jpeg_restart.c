@@ -0,0 +1,315 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "jpeg.h"
+
+#include "host.h"
+#include "test.h"
+
+#define MAX_INTERVALS 20000
+#define MAX_PACKETS 4096
+#define LOSS_PCT 20.0
+
+/** A synthetic baseline frame with restart markers, and where each interval starts in its scan */
+struct frame {
+    uint8_t* buf;
+    size_t len;
+    size_t scan_start; // offset of the scan in buf
+    size_t intervals;
+    size_t start[MAX_INTERVALS]; // interval k begins at scan offset start[k]
+    size_t end[MAX_INTERVALS];   // and ends after its RST marker, or at the end of the scan
+};
+
+struct packet {
+    size_t offset;
+    size_t len; // scan bytes
+    bool first; // F
+    bool last;  // L
+    uint16_t count;
+};
+
+static uint32_t s_lcg = 1;
+
+static uint8_t scan_byte(void) {
+    s_lcg = s_lcg * 1664525U + 1013904223U;
+    return (s_lcg >> 24) % 0xFF; // never 0xFF, so only the RST markers are markers
+}
+
+static uint8_t* put_segment(uint8_t* p, uint8_t marker, const uint8_t* body, size_t len) {
+    *p++ = 0xFF;
+    *p++ = marker;
+    *p++ = (len + 2) >> 8;
+    *p++ = (len + 2) & 0xFF;
+    memcpy(p, body, len);
+    return p + len;
+}
+
+/** Build a 4:2:2 frame of intervals intervals of interval_len(k) scan bytes each */
+static void make_frame(struct frame* f, size_t intervals, size_t (*interval_len)(size_t k)) {
+    uint8_t dqt[2 * (1 + QUANT_TABLE_SIZE)];
+    memset(dqt, 1, sizeof(dqt)); // flat tables, no standard Q matches them
+    dqt[0] = 0;
+    dqt[1 + QUANT_TABLE_SIZE] = 1;
+    static const uint8_t sof[] = {8, 0x01, 0xE0, 0x02, 0x80, 3, 1, 0x21, 0, 2, 0x11, 1, 3, 0x11, 1}; // 640x480
+    static const uint8_t dri[] = {0, 1};
+    static const uint8_t sos[] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+
+    size_t scan_len = 0;
+    for (size_t k = 0; k < intervals; k++) {
+        scan_len += interval_len(k) + 2;
+    }
+
+    f->buf = malloc(scan_len + 256);
+    uint8_t* p = f->buf;
+    *p++ = 0xFF;
+    *p++ = JPEG_MARKER_SOI;
+    p = put_segment(p, JPEG_MARKER_DQT, dqt, sizeof(dqt));
+    p = put_segment(p, JPEG_MARKER_SOF0, sof, sizeof(sof));
+    p = put_segment(p, JPEG_MARKER_DRI, dri, sizeof(dri));
+    p = put_segment(p, JPEG_MARKER_SOS, sos, sizeof(sos));
+    f->scan_start = p - f->buf;
+
+    for (size_t k = 0; k < intervals; k++) {
+        f->start[k] = p - f->buf - f->scan_start;
+        for (size_t i = 0; i < interval_len(k); i++) {
+            *p++ = scan_byte();
+        }
+        if (k + 1 < intervals) {
+            *p++ = 0xFF;
+            *p++ = JPEG_MARKER_RST0 + (k & 7);
+        }
+        f->end[k] = p - f->buf - f->scan_start;
+    }
+    *p++ = 0xFF;
+    *p++ = JPEG_MARKER_EOI;
+
+    f->len = p - f->buf;
+    f->intervals = intervals;
+}
+
+/** Index of the interval starting at offset, or -1 */
+static long interval_at(const struct frame* f, size_t offset) {
+    size_t lo = 0;
+    size_t hi = f->intervals;
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (f->start[mid] < offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < f->intervals && f->start[lo] == offset ? (long)lo : -1;
+}
+
+static bool is_interval_end(const struct frame* f, size_t offset) {
+    const long k = interval_at(f, offset);
+    return k > 0 || offset == f->end[f->intervals - 1];
+}
+
+/** Interval ends in (from, to] */
+static size_t ends_within(const struct frame* f, size_t from, size_t to) {
+    size_t lo = 0;
+    size_t hi = f->intervals;
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (f->end[mid] <= from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    size_t n = 0;
+    for (size_t k = lo; k < f->intervals && f->end[k] <= to; k++) {
+        n++;
+    }
+    return n;
+}
+
+/** Send the frame through netsim to a socket on loopback, return what arrived */
+static size_t send_frame(const struct frame* f, struct packet* out, size_t* sent) {
+    static struct rtp_dest_table dests;
+    static struct rtp_session session;
+    static struct pacer pacer;
+    static uint8_t buf[RTP_PACKET_SIZE];
+    static uint8_t rx[RTP_PACKET_SIZE];
+
+    const int rx_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    const int tx_sock = socket(AF_INET, SOCK_DGRAM, 0);
+    const int rcvbuf = 16 * 1024 * 1024;
+    setsockopt(rx_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    const struct timeval timeout = {.tv_usec = 200000};
+    setsockopt(rx_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t addr_len = sizeof(addr);
+    CHECK(bind(rx_sock, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    getsockname(rx_sock, (struct sockaddr*)&addr, &addr_len);
+
+    rtp_session_init(&session, RTP_JPEG_SSRC, RTP_JPEG_PAYLOADTYPE, RTP_JPEG_CLOCK_RATE, 0, 0);
+    CHECK_EQ(rtp_dest_table_init(&dests, tx_sock, &session), ESP_OK);
+    CHECK_EQ(rtp_dest_add(&dests, &addr, 0), ESP_OK);
+    // a rate the loopback socket buffer keeps up with
+    CHECK_EQ(pacer_init(&pacer, 200000, 64 * 1024, 0), ESP_OK);
+
+    const camera_fb_t fb = {.buf = f->buf, .len = f->len, .format = PIXFORMAT_JPEG};
+    host_netsim_init(LOSS_PCT, 0);
+    rtp_send_jpeg_packets(&dests, buf, &fb, &session, &pacer, NULL, NULL);
+    host_netsim_init(0, 0);
+
+    *sent = session.seq; // lost ones used up their sequence number too
+
+    size_t count = 0;
+    ssize_t len;
+    while (count < MAX_PACKETS && (len = recv(rx_sock, rx, sizeof(rx), 0)) > 0) {
+        const uint8_t* p = rx + sizeof(struct rtp_header);
+        const struct rtp_jpeg_header* jh = (const struct rtp_jpeg_header*)p;
+        const struct rtp_jpeg_restart_header* rh = (const struct rtp_jpeg_restart_header*)(jh + 1);
+        const uint16_t count_field = ntohs(rh->count);
+        const size_t offset = (jh->fragment_offset[0] << 16) | (jh->fragment_offset[1] << 8) | jh->fragment_offset[2];
+
+        size_t header = sizeof(struct rtp_header) + sizeof(*jh) + sizeof(*rh);
+        if (offset == 0 && jh->q >= 128) {
+            const struct jpeg_quant_header* qh = (const struct jpeg_quant_header*)(rx + header);
+            header += sizeof(*qh) + ntohs(qh->length);
+        }
+
+        CHECK(jh->type & JPEG_TYPE_RESTART);
+        out[count++] = (struct packet){
+            .offset = offset,
+            .len = len - header,
+            .first = count_field & JPEG_RESTART_FIRST,
+            .last = count_field & JPEG_RESTART_LAST,
+            .count = count_field & JPEG_RESTART_COUNT_MASK,
+        };
+    }
+
+    pacer_deinit(&pacer);
+    close(rx_sock);
+    close(tx_sock);
+    return count;
+}
+
+/*
+ * What arrived carries enough to pick decoding up again after a loss: every
+ * F packet starts at the interval its count names, every L packet ends one,
+ * a packet without F carries the rest of one interval and nothing after it,
+ * and after a gap only continuations of the interval the gap hit are lost
+ * before the next F packet.
+ *
+ * @param arrived_fraction set to the fraction of the scan that arrived
+ * @return the fraction of the scan in intervals that arrived whole, what a receiver decodes
+ */
+static double check_recovery(const struct frame* f, const struct packet* packets, size_t count,
+                             double* arrived_fraction) {
+    const size_t scan_len = f->end[f->intervals - 1];
+    uint8_t* arrived = calloc(scan_len, 1);
+    size_t expected_offset = 0;
+    size_t arrived_bytes = 0;
+    size_t gaps = 0;
+    size_t skipped = 0; // arrived while out of sync, up to the next F packet
+
+    bool synced = true;
+    for (size_t i = 0; i < count; i++) {
+        const struct packet* pk = &packets[i];
+
+        if (pk->offset != expected_offset) {
+            CHECK(pk->offset > expected_offset); // loopback keeps the order
+            gaps++;
+            synced = false;
+        }
+        expected_offset = pk->offset + pk->len;
+        memset(arrived + pk->offset, 1, pk->len);
+        arrived_bytes += pk->len;
+
+        CHECK(pk->count != JPEG_RESTART_COUNT_WHOLE_FRAME); // reserved for whole frames
+        if (pk->first) {
+            const long k = interval_at(f, pk->offset);
+            CHECK(k >= 0);
+            CHECK_EQ(pk->count, (uint16_t)(k % JPEG_RESTART_COUNT_WHOLE_FRAME));
+            synced = true;
+        } else {
+            // a packet that starts an interval must say so, or the receiver skips a whole interval
+            CHECK(interval_at(f, pk->offset) < 0);
+            // and a tail carries no whole intervals, a receiver only takes it as the end of one
+            CHECK_EQ(ends_within(f, pk->offset, pk->offset + pk->len), pk->last ? 1 : 0);
+            skipped += !synced;
+        }
+
+        if (pk->last) {
+            CHECK(is_interval_end(f, pk->offset + pk->len));
+        }
+    }
+
+    size_t recovered = 0;
+    for (size_t k = 0; k < f->intervals; k++) {
+        const size_t len = f->end[k] - f->start[k];
+        recovered += memchr(arrived + f->start[k], 0, len) ? 0 : len;
+    }
+    free(arrived);
+
+    const double fraction = (double)recovered / scan_len;
+    *arrived_fraction = (double)arrived_bytes / scan_len;
+    CHECK(gaps > 0); // at 20% loss over dozens of packets
+    printf("  %zu packets arrived, %zu gaps, %zu continuations skipped; %.1f%% of the scan arrived, "
+           "%.1f%% recovered\n",
+           count, gaps, skipped, 100.0 * arrived_bytes / scan_len, 100.0 * fraction);
+    return fraction;
+}
+
+static size_t mixed_interval(size_t k) {
+    return (k % 17 == 5) ? 3000 : 40 + k % 90; // a few intervals larger than a packet
+}
+
+static size_t tiny_interval(size_t k) {
+    return 3;
+}
+
+static struct frame s_frame;
+static struct packet s_packets[MAX_PACKETS];
+
+/* Fragments lost on the way: the receiver resumes at the next restart interval */
+static void test_recovers_at_next_interval(void) {
+    size_t sent;
+
+    make_frame(&s_frame, 600, mixed_interval);
+    const size_t count = send_frame(&s_frame, s_packets, &sent);
+
+    CHECK(count < sent);
+    double arrived;
+    const double recovered = check_recovery(&s_frame, s_packets, count, &arrived);
+    // only a split interval loses bytes that arrived, a third of the scan is in intervals that fit a packet
+    CHECK(recovered >= 0.4 * arrived);
+    free(s_frame.buf);
+}
+
+/* More intervals than the 14-bit count holds: the count wraps to 0 before the reserved 0x3FFF */
+static void test_restart_count_wraps(void) {
+    size_t sent;
+
+    make_frame(&s_frame, MAX_INTERVALS, tiny_interval); // a score of packets past the wrap, some survive the loss
+    const size_t count = send_frame(&s_frame, s_packets, &sent);
+
+    bool wrapped = false;
+    for (size_t i = 0; i < count; i++) {
+        wrapped |= s_packets[i].first && s_packets[i].offset >= s_frame.start[JPEG_RESTART_COUNT_WHOLE_FRAME];
+    }
+    CHECK(wrapped);
+    double arrived;
+    const double recovered = check_recovery(&s_frame, s_packets, count, &arrived);
+    CHECK(recovered == arrived); // no interval is split, every byte that arrived decodes
+    free(s_frame.buf);
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_WARN);
+
+    RUN(test_recovers_at_next_interval);
+    RUN(test_restart_count_wraps);
+
+    return TEST_EXIT();
+}
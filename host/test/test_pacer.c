@@ -0,0 +1,122 @@
+#include <stdint.h>
+#include <time.h>
+
+#include "esp_timer.h"
+
+#include "pacer.h"
+
+#include "test.h"
+
+#define PACKET 1000U
+#define BURST 4096U
+
+/** Departures of packets sent the moment the pacer lets them go */
+static void schedule(struct pacer* p, int64_t start_us, size_t packets, int64_t* departures) {
+    int64_t now = start_us;
+
+    for (size_t i = 0; i < packets; i++) {
+        now = pacer_schedule(p, PACKET, now);
+        departures[i] = now;
+    }
+}
+
+/* A frame is spread over one frame interval: after the burst, packets leave evenly at frame_bytes * fps */
+static void test_spreads_frame_over_interval(void) {
+    struct pacer p;
+    int64_t departures[20];
+
+    CHECK_EQ(pacer_init(&p, 8000, BURST, 10), ESP_OK); // 1 MB/s ceiling
+    pacer_begin_frame(&p, 20 * PACKET);                // 200 kB/s
+
+    const int64_t start = p.last_us;
+    schedule(&p, start, 20, departures);
+
+    const size_t burst_packets = BURST / PACKET;
+    for (size_t i = 0; i < burst_packets; i++) {
+        CHECK_EQ(departures[i], start);
+    }
+    for (size_t i = burst_packets + 1; i < 20; i++) {
+        CHECK_EQ(departures[i] - departures[i - 1], 5000);
+    }
+
+    // the last packet leaves once the bytes past the burst have been paid for, within the 100 ms interval
+    CHECK_EQ(departures[19] - start, (20 * PACKET - BURST) * 1000000LL / 200000);
+
+    pacer_deinit(&p);
+}
+
+/* A frame larger than the ceiling allows is sent at the ceiling, it overruns its interval */
+static void test_caps_at_bitrate(void) {
+    struct pacer p;
+    int64_t departures[40];
+
+    CHECK_EQ(pacer_init(&p, 8000, BURST, 30), ESP_OK);
+    pacer_begin_frame(&p, 200 * PACKET); // would need 6 MB/s
+
+    schedule(&p, p.last_us, 40, departures);
+    for (size_t i = BURST / PACKET + 1; i < 40; i++) {
+        CHECK_EQ(departures[i] - departures[i - 1], 1000);
+    }
+
+    pacer_deinit(&p);
+}
+
+/* An idle link refills the bucket up to the burst, never beyond */
+static void test_refills_burst_only(void) {
+    struct pacer p;
+    int64_t departures[8];
+
+    CHECK_EQ(pacer_init(&p, 8000, BURST, 0), ESP_OK);
+    pacer_begin_frame(&p, 0); // fps 0: the ceiling
+
+    schedule(&p, p.last_us, 8, departures);
+    const int64_t idle = departures[7] + 1000000;
+    schedule(&p, idle, 8, departures);
+
+    CHECK_EQ(departures[0], idle);
+    CHECK_EQ(departures[BURST / PACKET - 1], idle);
+    CHECK(departures[BURST / PACKET] > idle);
+
+    pacer_deinit(&p);
+}
+
+static int64_t thread_cpu_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* pacer_wait sleeps until the scheduled departure instead of spinning on the clock */
+static void test_wait_sleeps(void) {
+    struct pacer p;
+
+    CHECK_EQ(pacer_init(&p, 8, 0, 0), ESP_OK); // 1 kB/s: 2 ms per 2-byte packet
+    pacer_begin_frame(&p, 0);
+
+    const int64_t wall = esp_timer_get_time();
+    const int64_t cpu = thread_cpu_us();
+    for (size_t i = 0; i < 10; i++) {
+        pacer_wait(&p, 2);
+    }
+    const int64_t elapsed = esp_timer_get_time() - wall;
+
+    CHECK(elapsed >= 20000);
+    CHECK(thread_cpu_us() - cpu < elapsed / 4);
+
+    struct pacer_stats stats;
+    pacer_get_stats(&p, &stats);
+    CHECK_EQ(stats.packets, 10);
+    CHECK_EQ(stats.bytes, 20);
+    CHECK(stats.wait_us >= 18000);
+
+    pacer_deinit(&p);
+}
+
+int main(void) {
+    RUN(test_spreads_frame_over_interval);
+    RUN(test_caps_at_bitrate);
+    RUN(test_refills_burst_only);
+    RUN(test_wait_sleeps);
+
+    return TEST_EXIT();
+}
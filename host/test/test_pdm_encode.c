@@ -0,0 +1,50 @@
+#include <stdint.h>
+
+#include "pdm_mic.h"
+
+#include "test.h"
+
+static int16_t s_pcm[65536];
+static uint8_t s_q15[65536];
+static uint8_t s_float[65536];
+
+/* Every input, saturating ones included, against the float path at gains exact in both */
+static void test_exhaustive(void) {
+    static const float gains[] = {0.0f, 0.5f, 1.0f, 1.25f, 2.5f, 3.0f, 3.75f};
+
+    for (size_t i = 0; i < 65536; i++) {
+        s_pcm[i] = (int16_t)(i - 32768);
+    }
+
+    for (size_t g = 0; g < sizeof(gains) / sizeof(gains[0]); g++) {
+        pdm_mic_encode(s_pcm, 65536, gains[g], s_q15);
+        pdm_mic_encode_float(s_pcm, 65536, gains[g], s_float);
+
+        size_t diff = 0;
+        for (size_t i = 0; i < 65536; i++) {
+            diff += s_q15[i] != s_float[i];
+        }
+        CHECK_EQ(diff, 0);
+    }
+}
+
+/* Loud input saturates to the top μ-law levels instead of wrapping */
+static void test_saturation(void) {
+    const int16_t loud[] = {32767, 20000, -20000, -32768};
+    uint8_t ulaw[4];
+
+    pdm_mic_encode(loud, 4, 2.5f, ulaw);
+    CHECK_EQ(ulaw[0], 0x80);
+    CHECK_EQ(ulaw[1], 0x80);
+    CHECK_EQ(ulaw[2], 0x00);
+    CHECK_EQ(ulaw[3], 0x00);
+}
+
+int main(void) {
+    pdm_mic_codec_init();
+
+    RUN(test_exhaustive);
+    RUN(test_saturation);
+
+    return TEST_EXIT();
+}
@@ -0,0 +1,36 @@
+#include <unistd.h>
+
+#include "esp_camera.h"
+
+#include "host.h"
+#include "pdm_mic.h"
+#include "rtp.h"
+
+#include "test.h"
+
+/* The starting step's fps cap reaches the pacer, the video task does not put the Kconfig rate back */
+static void test_starting_fps(void) {
+    // the ladder starts at the boot frame size, QQVGA runs at 10 fps, not CONFIG_ESPRTP_VIDEO_FPS
+    esp_camera_sensor_get()->status.framesize = FRAMESIZE_QQVGA;
+
+    rtp_init();
+    usleep(300000); // the video and quality tasks are running
+
+    struct pacer_stats pacer;
+    rtp_get_video_pacer_stats(&pacer);
+    CHECK_EQ(pacer.fps, 10);
+}
+
+int main(void) {
+    // no captures are replayed, the capture task would log every poll
+    host_log_set_level(ESP_LOG_NONE);
+
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+    ESP_ERROR_CHECK(host_mic_init(NULL, 0.0));
+    ESP_ERROR_CHECK(pdm_mic_init());
+#endif
+
+    RUN(test_starting_fps);
+
+    return TEST_EXIT();
+}
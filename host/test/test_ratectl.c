@@ -0,0 +1,128 @@
+#include <stdint.h>
+
+#include "ratectl.h"
+
+#include "test.h"
+
+/** Bitrate of each ladder level, best to worst, like the steps in quality.c */
+static const uint32_t s_ladder_kbps[] = {4000, 3000, 2200, 1600, 1200, 900, 700, 500, 400, 300};
+
+#define LADDER_SIZE (sizeof(s_ladder_kbps) / sizeof(s_ladder_kbps[0]))
+#define PACER_CAP_KBPS 8000U
+
+static const struct ratectl_config s_config = {
+    .loss_down = 13,
+    .loss_up = 3,
+    .drop_down_pct = 20,
+    .headroom_pct = 80,
+    .up_hold = 3,
+    .up_hold_max = 16,
+    .min_level = 0,
+    .max_level = LADDER_SIZE - 1,
+};
+
+/** One period of a link of capacity_kbps: whatever the level sends above it is lost */
+static struct ratectl_sample period(size_t level, uint32_t capacity_kbps) {
+    const uint32_t sent = s_ladder_kbps[level];
+    const uint32_t delivered = sent < capacity_kbps ? sent : capacity_kbps;
+
+    return (struct ratectl_sample){
+        .feedback = true,
+        .fraction_lost = (uint8_t)((sent - delivered) * 256U / sent),
+        .frames_queued = 15,
+        .achieved_bps = sent * 1000U,
+        .capacity_bps = PACER_CAP_KBPS * 1000U,
+    };
+}
+
+/** Best level a link of capacity_kbps carries */
+static size_t fitting_level(uint32_t capacity_kbps) {
+    size_t level = 0;
+    while (level < LADDER_SIZE - 1 && s_ladder_kbps[level] > capacity_kbps) {
+        level++;
+    }
+    return level;
+}
+
+struct phase {
+    uint32_t capacity_kbps;
+    uint32_t periods;
+};
+
+/*
+ * A link that drops from 5 to 0.9 Mbit/s and recovers to 3 Mbit/s: in the
+ * second half of each phase the controller sits on the best step that fits,
+ * with rare probes above it, and it climbs back after the recovery.
+ */
+static void test_follows_bandwidth_trace(void) {
+    static const struct phase trace[] = {{5000, 60}, {1800, 120}, {900, 120}, {3000, 180}};
+    struct ratectl rc;
+
+    ratectl_init(&rc, &s_config, LADDER_SIZE / 2);
+
+    for (size_t i = 0; i < sizeof(trace) / sizeof(trace[0]); i++) {
+        const struct phase* ph = &trace[i];
+        const size_t fit = fitting_level(ph->capacity_kbps);
+        uint32_t settled = 0;
+        uint32_t over = 0;
+
+        for (uint32_t t = 0; t < ph->periods; t++) {
+            const size_t level = rc.level;
+            const struct ratectl_sample s = period(level, ph->capacity_kbps);
+            ratectl_update(&rc, &s);
+
+            if (t >= ph->periods / 2) {
+                settled += level == fit;
+                over += level < fit;
+            }
+        }
+
+        printf("  %u kbit/s: %u/%u periods on the fitting step, %u above it\n", ph->capacity_kbps, settled,
+               ph->periods / 2, over);
+        CHECK(settled * 10 >= ph->periods / 2 * 7);
+        CHECK(over * 10 <= ph->periods / 2);
+    }
+}
+
+/* A receiver that stops reporting neither drives the quality up nor down */
+static void test_holds_without_feedback(void) {
+    struct ratectl rc;
+
+    ratectl_init(&rc, &s_config, 5);
+
+    const struct ratectl_sample silent = {
+        .feedback = false,
+        .frames_queued = 15,
+        .achieved_bps = 100000,
+        .capacity_bps = PACER_CAP_KBPS * 1000U,
+    };
+    for (size_t i = 0; i < 100; i++) {
+        CHECK_EQ(ratectl_update(&rc, &silent), 5);
+    }
+
+    // drops in the local queue still step down
+    struct ratectl_sample dropping = silent;
+    dropping.frames_dropped = 10;
+    CHECK_EQ(ratectl_update(&rc, &dropping), 6);
+}
+
+/* The start level is clamped to the best level the frame buffers allow */
+static void test_start_level_clamped(void) {
+    struct ratectl_config cfg = s_config;
+    struct ratectl rc;
+
+    cfg.min_level = 3;
+    ratectl_init(&rc, &cfg, 0);
+    CHECK_EQ(rc.level, 3);
+
+    ratectl_init(&rc, &cfg, LADDER_SIZE + 4);
+    CHECK_EQ(rc.level, LADDER_SIZE - 1);
+}
+
+int main(void) {
+    RUN(test_follows_bandwidth_trace);
+    RUN(test_holds_without_feedback);
+    RUN(test_start_level_clamped);
+
+    return TEST_EXIT();
+}
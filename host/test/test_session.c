@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "rtcp.h"
+#include "session.h"
+
+#include "../receiver/rx_stream.h"
+
+#include "host.h"
+#include "test.h"
+
+#define TEST_SSRC 0x12345678U
+#define CLOCK_RATE 90000U
+
+/* Sequence numbers and timestamps run through their wraps; the cycles carry the 16-bit overflow */
+static void test_wraparound(void) {
+    struct rtp_session s;
+    struct rtp_header h;
+    struct rx_stream rx;
+
+    rtp_session_init(&s, TEST_SSRC, 26, CLOCK_RATE, 0xFFFD, 0xFFFFFF00U);
+    rx_stream_init(&rx, CLOCK_RATE);
+
+    static const uint16_t seqs[] = {0xFFFD, 0xFFFE, 0xFFFF, 0x0000, 0x0001, 0x0002};
+    static const uint32_t extended[] = {0xFFFD, 0xFFFE, 0xFFFF, 0x10000, 0x10001, 0x10002};
+    for (size_t i = 0; i < sizeof(seqs) / sizeof(seqs[0]); i++) {
+        const uint32_t media_ts = i * 3000U;
+        rtp_session_write_header(&s, &h, media_ts, false);
+
+        CHECK_EQ(ntohs(h.seqNum), seqs[i]);
+        CHECK_EQ(ntohl(h.timestamp), (uint32_t)(0xFFFFFF00U + media_ts)); // wraps after the first packet
+        CHECK_EQ(rtp_session_extended_seq(&s), extended[i]);
+        CHECK_EQ(s.cycles, i < 2 ? 0 : 1U << 16); // counts for the next sequence number, 0 after 0xFFFF
+
+        rx_stream_update(&rx, ntohl(h.ssrc), ntohs(h.seqNum), ntohl(h.timestamp), i * 33333, 1000);
+        CHECK_EQ(rx_stream_extended_max(&rx), rtp_session_extended_seq(&s));
+    }
+    CHECK_EQ(rx_stream_lost(&rx), 0);
+
+    // two more full turns of the 16-bit counter
+    for (uint32_t i = 0; i < 2U << 16; i++) {
+        rtp_session_write_header(&s, &h, 0, false);
+    }
+    CHECK_EQ(s.cycles, 3U << 16);
+    CHECK_EQ(rtp_session_extended_seq(&s), (3U << 16) + 2U);
+}
+
+/* The wallclock mapping extrapolates across the 32-bit timestamp wrap */
+static void test_timestamp_at_wraps(void) {
+    struct rtp_session s;
+    uint32_t ts;
+
+    rtp_session_init(&s, TEST_SSRC, 26, CLOCK_RATE, 0, 0xFFFF0000U);
+    CHECK(!rtp_session_timestamp_at(&s, 0, &ts));
+
+    rtp_session_set_clock(&s, 0x8000, 1000000);
+    CHECK(rtp_session_timestamp_at(&s, 2000000, &ts));
+    CHECK_EQ(ts, (uint32_t)(0xFFFF0000U + 0x8000U + CLOCK_RATE));
+}
+
+/* A receiver report past the wrap hands back the extended highest sequence the session sent */
+static void test_rtcp_extended_highest_seq(void) {
+    static struct rtp_session s;
+    struct rtp_header h;
+    struct rx_stream rx;
+
+    rtp_session_init(&s, TEST_SSRC, 26, CLOCK_RATE, 0xFFF0, 0);
+    rx_stream_init(&rx, CLOCK_RATE);
+    for (size_t i = 0; i < 40; i++) {
+        rtp_session_write_header(&s, &h, i * 3000U, false);
+        rtp_session_on_sent(&s, 1000);
+        rx_stream_update(&rx, ntohl(h.ssrc), ntohs(h.seqNum), ntohl(h.timestamp), i * 33333, 1000);
+    }
+
+    const struct sockaddr_in to = {
+        .sin_family = AF_INET,
+        .sin_port = htons(47000),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    CHECK_EQ(rtcp_add_stream(&s, &to, 1000000), ESP_OK);
+    CHECK_EQ(rtcp_start(), ESP_OK);
+
+    struct {
+        struct rtcp_header h;
+        uint32_t ssrc;
+        struct rtcp_report_block block;
+    } __attribute__((packed)) rr;
+    memset(&rr, 0, sizeof(rr));
+    rr.h.version = RTCP_VERSION | 1;
+    rr.h.type = RTCP_RR;
+    rr.h.length = htons(sizeof(rr) / 4 - 1);
+    rr.ssrc = htonl(0xCAFEF00DU);
+    rr.block.ssrc = htonl(TEST_SSRC);
+    rr.block.highest_seq = htonl(rx_stream_extended_max(&rx));
+    rtcp_handle_packet((const uint8_t*)&rr, sizeof(rr));
+
+    struct rtcp_stream_stats stats;
+    CHECK_EQ(rtcp_get_stats(TEST_SSRC, &stats), ESP_OK);
+    CHECK_EQ(stats.reports, 1);
+    CHECK_EQ(stats.highest_seq, 0x10017);
+    CHECK_EQ(stats.highest_seq, rtp_session_extended_seq(&s));
+}
+
+int main(void) {
+    host_log_set_level(ESP_LOG_WARN);
+
+    RUN(test_wraparound);
+    RUN(test_timestamp_at_wraps);
+    RUN(test_rtcp_extended_highest_seq);
+
+    return TEST_EXIT();
+}
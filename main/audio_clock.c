@@ -0,0 +1,74 @@
+#include <string.h>
+
+#include "esp_compiler.h"
+
+#include "include/audio_clock.h"
+
+#define AUDIO_CLOCK_SMOOTHING 16           // frames the offset is averaged over, capture jitter stays out
+#define AUDIO_CLOCK_THRESHOLD_Q8 256       // one sample
+#define AUDIO_CLOCK_DRIFT_MIN_US 10000000LL // the drift is not reported before 10 s
+
+void audio_clock_init(struct audio_clock* c, uint32_t rate) {
+    memset(c, 0, sizeof(*c));
+    c->rate = rate;
+}
+
+/** Samples at rate in us microseconds, in 1/256 samples; exact for any uptime */
+static int64_t samples_q8(uint32_t rate, int64_t us) {
+    return (us / 1000000) * rate * 256 + (us % 1000000) * rate * 256 / 1000000;
+}
+
+int audio_clock_update(struct audio_clock* c, uint32_t seq, size_t samples, int64_t captured_us,
+                       uint32_t* timestamp) {
+    const uint64_t input_end = ((uint64_t)seq + 1) * samples;
+
+    if (unlikely(!c->started)) {
+        c->started = true;
+        c->first_us = captured_us;
+        c->first_input = input_end;
+    }
+
+    const int64_t elapsed_us = captured_us - c->first_us;
+    const int64_t ideal_q8 = (int64_t)c->first_input * 256 + samples_q8(c->rate, elapsed_us);
+    const int64_t output_q8 = ((int64_t)input_end + c->adjust) * 256;
+    c->error_q8 += (int32_t)(output_q8 - ideal_q8 - c->error_q8) / AUDIO_CLOCK_SMOOTHING;
+
+    *timestamp = (uint32_t)(input_end - samples + c->adjust);
+
+    __atomic_store_n(&c->stats.offset, c->error_q8 / 256, __ATOMIC_RELAXED);
+
+    if (elapsed_us >= AUDIO_CLOCK_DRIFT_MIN_US) {
+        const int64_t captured = (int64_t)(input_end - c->first_input) * 1000000 / c->rate;
+        __atomic_store_n(&c->stats.drift_ppm, (int32_t)((captured - elapsed_us) * 1000000 / elapsed_us),
+                         __ATOMIC_RELAXED);
+    }
+
+    if (c->error_q8 > AUDIO_CLOCK_THRESHOLD_Q8) {
+        return -1;
+    } else if (c->error_q8 < -AUDIO_CLOCK_THRESHOLD_Q8) {
+        return 1;
+    }
+    return 0;
+}
+
+void audio_clock_commit(struct audio_clock* c, int step) {
+    if (step == 0) {
+        return;
+    }
+
+    if (step < 0) {
+        __atomic_store_n(&c->stats.dropped, c->stats.dropped + 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(&c->stats.inserted, c->stats.inserted + 1, __ATOMIC_RELAXED);
+    }
+    c->adjust += step;
+    c->error_q8 += step * 256;
+    __atomic_store_n(&c->stats.offset, c->error_q8 / 256, __ATOMIC_RELAXED);
+}
+
+void audio_clock_get_stats(const struct audio_clock* c, struct audio_clock_stats* out) {
+    out->drift_ppm = __atomic_load_n(&c->stats.drift_ppm, __ATOMIC_RELAXED);
+    out->offset = __atomic_load_n(&c->stats.offset, __ATOMIC_RELAXED);
+    out->inserted = __atomic_load_n(&c->stats.inserted, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&c->stats.dropped, __ATOMIC_RELAXED);
+}
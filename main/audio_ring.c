@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "esp_attr.h"
+#include "esp_compiler.h"
+
+#include "include/audio_ring.h"
+
+void audio_ring_init(struct audio_ring* r, uint32_t depth) {
+    memset(r, 0, sizeof(*r));
+    r->depth = depth;
+}
+
+/** Enough frames completed after seq for the DMA to be back in its buffer */
+static inline bool is_stale(const struct audio_ring* r, uint32_t seq) {
+    return __atomic_load_n(&r->stats.produced, __ATOMIC_ACQUIRE) - 1U - seq >= r->depth;
+}
+
+bool IRAM_ATTR audio_ring_push(struct audio_ring* r, const int16_t* pcm, size_t samples, int64_t captured_us) {
+    const uint32_t seq = r->stats.produced;
+    __atomic_store_n(&r->stats.produced, seq + 1, __ATOMIC_RELEASE);
+
+    const uint32_t head = r->head;
+    if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) == AUDIO_RING_SLOTS) {
+        __atomic_add_fetch(&r->stats.overruns, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    r->slots[head % AUDIO_RING_SLOTS] = (struct audio_ring_frame){
+        .pcm = pcm,
+        .samples = samples,
+        .captured_us = captured_us,
+        .seq = seq,
+    };
+    __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+bool audio_ring_peek(struct audio_ring* r, struct audio_ring_frame* out) {
+    const uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+
+    for (uint32_t tail = r->tail; tail != head; tail++) {
+        const struct audio_ring_frame* f = &r->slots[tail % AUDIO_RING_SLOTS];
+        if (!is_stale(r, f->seq)) {
+            *out = *f;
+            return true;
+        }
+
+        __atomic_add_fetch(&r->stats.late, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&r->tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    return false;
+}
+
+bool audio_ring_release(struct audio_ring* r, const struct audio_ring_frame* frame) {
+    __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+
+    // the samples were read before the DMA is checked for having come back
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (unlikely(is_stale(r, frame->seq))) {
+        __atomic_add_fetch(&r->stats.late, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    __atomic_add_fetch(&r->stats.consumed, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+void audio_ring_underrun(struct audio_ring* r) {
+    __atomic_add_fetch(&r->stats.underruns, 1, __ATOMIC_RELAXED);
+}
+
+void audio_ring_get_stats(const struct audio_ring* r, struct audio_ring_stats* out) {
+    out->produced = __atomic_load_n(&r->stats.produced, __ATOMIC_RELAXED);
+    out->consumed = __atomic_load_n(&r->stats.consumed, __ATOMIC_RELAXED);
+    out->overruns = __atomic_load_n(&r->stats.overruns, __ATOMIC_RELAXED);
+    out->late = __atomic_load_n(&r->stats.late, __ATOMIC_RELAXED);
+    out->underruns = __atomic_load_n(&r->stats.underruns, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,496 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_cpu.h"
+#else
+#include <time.h>
+#endif
+
+#include "../include/pdm_mic.h"
+#include "../rtp/include/jpeg.h"
+
+#include "include/bench.h"
+
+#define BENCH_MIN_BATCH_US 20000
+#define BENCH_REPEATS 7
+#define BENCH_MAX_ITERATIONS (1U << 24)
+
+#define BENCH_VOLUME_GAIN 2.5f // pdm_mic_read default
+
+#if defined(CONFIG_ESPRTP_ULAW_TABLE_256)
+#define BENCH_ULAW "256 B table"
+#elif defined(CONFIG_ESPRTP_ULAW_CLZ)
+#define BENCH_ULAW "clz"
+#else
+#define BENCH_ULAW "16 KB table"
+#endif
+
+#ifdef ESP_PLATFORM
+#define BENCH_PLATFORM CONFIG_IDF_TARGET
+#else
+#define BENCH_PLATFORM "host"
+#endif
+
+static const char* const TAG = "bench";
+
+static volatile uintptr_t s_sink; // keeps results observable so calls are not elided
+
+struct bench_case {
+    const char* name;
+    const char* input;
+    size_t bytes; // processed per op, for mb_per_s
+    void (*fn)(void* ctx);
+    void* ctx;
+};
+
+static inline uint64_t now_ns(void) {
+#ifdef ESP_PLATFORM
+    return (uint64_t)esp_timer_get_time() * 1000U;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + ts.tv_nsec;
+#endif
+}
+
+static inline uint32_t now_cycles(void) {
+#ifdef ESP_PLATFORM
+    return esp_cpu_get_cycle_count();
+#else
+    return 0;
+#endif
+}
+
+static int compare_double(const void* a, const void* b) {
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void run_case(const struct bench_case* c) {
+    // warm caches and find a batch size that runs for at least BENCH_MIN_BATCH_US
+    uint32_t iterations = 1;
+    while (iterations < BENCH_MAX_ITERATIONS) {
+        const uint64_t start = now_ns();
+        for (uint32_t i = 0; i < iterations; i++) {
+            c->fn(c->ctx);
+        }
+        if (now_ns() - start >= BENCH_MIN_BATCH_US * 1000ULL) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    double ns[BENCH_REPEATS];
+    double cycles[BENCH_REPEATS];
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        const uint64_t start = now_ns();
+        const uint32_t start_cycles = now_cycles();
+        for (uint32_t i = 0; i < iterations; i++) {
+            c->fn(c->ctx);
+        }
+        // a batch is far shorter than the 32-bit cycle counter period
+        cycles[r] = (double)(uint32_t)(now_cycles() - start_cycles) / iterations;
+        ns[r] = (double)(now_ns() - start) / iterations;
+    }
+
+    qsort(ns, BENCH_REPEATS, sizeof(double), compare_double);
+    qsort(cycles, BENCH_REPEATS, sizeof(double), compare_double);
+    const double ns_per_op = ns[BENCH_REPEATS / 2];
+
+    printf("{\"bench\":\"%s\",\"input\":\"%s\",\"bytes\":%zu,\"iterations\":%u,\"ns_per_op\":%.1f,", c->name,
+           c->input, c->bytes, (unsigned)iterations, ns_per_op);
+#ifdef ESP_PLATFORM
+    printf("\"cycles_per_op\":%.0f,", cycles[BENCH_REPEATS / 2]);
+#endif
+    printf("\"mb_per_s\":%.2f,\"platform\":\"%s\"}\n", ns_per_op > 0 ? c->bytes * 1000.0 / ns_per_op : 0.0,
+           BENCH_PLATFORM);
+    fflush(stdout);
+}
+
+/*
+ * The two-pass scan the sender used before jpeg_frame_index, kept as the
+ * baseline: a byte search for SOS then EOI, and a second byte search for DQT.
+ */
+
+static const uint8_t* legacy_get_jpeg_data(const uint8_t* buf, size_t size, size_t* out_size) {
+    size_t pos = 0;
+    while (pos < size - 1 && !(buf[pos] == 0xFF && buf[pos + 1] == JPEG_MARKER_SOS)) {
+        pos++;
+    }
+    if (pos >= size - 1 || pos + 4 > size) {
+        *out_size = 0;
+        return NULL;
+    }
+
+    pos += 2;
+    const uint16_t sos_length = (buf[pos] << 8) | buf[pos + 1];
+    if (sos_length < 2 || pos + sos_length > size) {
+        *out_size = 0;
+        return NULL;
+    }
+    pos += sos_length;
+
+    const size_t data_start = pos;
+    while (pos < size - 1 && !(buf[pos] == 0xFF && buf[pos + 1] == JPEG_MARKER_EOI)) {
+        pos++;
+    }
+    if (pos >= size - 1) {
+        *out_size = 0;
+        return NULL;
+    }
+
+    *out_size = pos - data_start;
+    return buf + data_start;
+}
+
+static size_t legacy_extract_quant_tables_refs(const uint8_t* buf, size_t size, const uint8_t** tables) {
+    size_t pos = 0;
+    size_t count = 0;
+
+    while (pos + 4 <= size) {
+        if (buf[pos] == 0xFF && buf[pos + 1] == JPEG_MARKER_DQT) {
+            pos += 2;
+            const uint16_t seg_len = ((uint16_t)buf[pos] << 8) | (uint16_t)buf[pos + 1];
+            pos += 2;
+            if (seg_len < 2 || pos + seg_len - 2 > size) {
+                break;
+            }
+
+            const size_t seg_end = pos + (size_t)seg_len - 2;
+            while (pos < seg_end && count < MAX_QUANT_TABLES) {
+                const uint8_t table_info = buf[pos++];
+                const size_t table_size = (table_info >> 4) == 0 ? QUANT_TABLE_SIZE : QUANT_TABLE_SIZE * 2;
+                if (pos + table_size > seg_end) {
+                    break;
+                }
+                if ((table_info >> 4) == 0 && (table_info & 0x0F) < MAX_QUANT_TABLES) {
+                    tables[count++] = &buf[pos];
+                }
+                pos += table_size;
+            }
+            pos = seg_end;
+        } else {
+            pos++;
+        }
+    }
+
+    return count;
+}
+
+static void case_legacy_scan(void* ctx) {
+    const struct bench_frame* f = ctx;
+    const uint8_t* tables[MAX_QUANT_TABLES];
+    size_t size;
+
+    s_sink += (uintptr_t)legacy_get_jpeg_data(f->buf, f->len, &size) + size;
+    s_sink += legacy_extract_quant_tables_refs(f->buf, f->len, tables);
+}
+
+static void case_jpeg_frame_index(void* ctx) {
+    const struct bench_frame* f = ctx;
+    struct jpeg_frame frame;
+
+    s_sink += jpeg_frame_index(f->buf, f->len, &frame) + frame.scan_len;
+}
+
+struct quant_ctx {
+    struct jpeg_frame frame;
+    struct jpeg_quant_cache cache;
+};
+
+static void case_jpeg_quant_detect(void* ctx) {
+    struct quant_ctx* q = ctx;
+
+    s_sink += jpeg_quant_detect(&q->cache, q->frame.quant_tables, q->frame.quant_tables_count);
+}
+
+/*
+ * Socket stubs for the fragment loop. The bench binaries link with
+ * --wrap for sendmsg/sendto (lwip_sendmsg/lwip_sendto on the target), so
+ * rtp_send_jpeg_packets runs unmodified without touching the network stack.
+ */
+
+#ifdef ESP_PLATFORM
+#define BENCH_WRAP(fn) __wrap_lwip_##fn
+#define BENCH_REAL(fn) __real_lwip_##fn
+#else
+#define BENCH_WRAP(fn) __wrap_##fn
+#define BENCH_REAL(fn) __real_##fn
+#endif
+
+ssize_t BENCH_REAL(sendmsg)(int s, const struct msghdr* msg, int flags);
+ssize_t BENCH_REAL(sendto)(int s, const void* data, size_t size, int flags, const struct sockaddr* to,
+                           socklen_t tolen);
+
+ssize_t BENCH_WRAP(sendmsg)(int s, const struct msghdr* msg, int flags) {
+    size_t len = 0;
+    for (size_t i = 0; i < (size_t)msg->msg_iovlen; i++) {
+        len += msg->msg_iov[i].iov_len;
+    }
+    s_sink += len;
+
+    return len;
+}
+
+ssize_t BENCH_WRAP(sendto)(int s, const void* data, size_t size, int flags, const struct sockaddr* to,
+                           socklen_t tolen) {
+    s_sink += size;
+
+    return size;
+}
+
+/*
+ * Both fragment send paths through the real stack to a socket on loopback,
+ * whatever CONFIG_ESPRTP_JPEG_ZERO_COPY selects for the sender: the copy
+ * path stages each fragment behind its header and calls sendto, the zero
+ * copy path hands sendmsg the header and a reference into the frame.
+ */
+struct loopback_ctx {
+    const struct bench_frame* frame;
+    int sock;
+    struct sockaddr_in to;
+    size_t max_payload;
+    uint8_t packet[RTP_PACKET_SIZE];
+};
+
+#define BENCH_LOOPBACK_HEADER (sizeof(struct rtp_header) + sizeof(struct rtp_jpeg_header))
+
+static void case_loopback_copy(void* ctx) {
+    struct loopback_ctx* l = ctx;
+
+    for (size_t off = 0; off < l->frame->len; off += l->max_payload) {
+        const size_t chunk = l->frame->len - off < l->max_payload ? l->frame->len - off : l->max_payload;
+        memcpy(l->packet + BENCH_LOOPBACK_HEADER, l->frame->buf + off, chunk);
+        s_sink += BENCH_REAL(sendto)(l->sock, l->packet, BENCH_LOOPBACK_HEADER + chunk, MSG_DONTWAIT,
+                                     (const struct sockaddr*)&l->to, sizeof(l->to));
+    }
+}
+
+static void case_loopback_zero_copy(void* ctx) {
+    struct loopback_ctx* l = ctx;
+
+    for (size_t off = 0; off < l->frame->len; off += l->max_payload) {
+        const size_t chunk = l->frame->len - off < l->max_payload ? l->frame->len - off : l->max_payload;
+        struct iovec iov[2] = {
+            {.iov_base = l->packet, .iov_len = BENCH_LOOPBACK_HEADER},
+            {.iov_base = (void*)(l->frame->buf + off), .iov_len = chunk},
+        };
+        const struct msghdr msg = {
+            .msg_name = &l->to,
+            .msg_namelen = sizeof(l->to),
+            .msg_iov = iov,
+            .msg_iovlen = 2,
+        };
+        s_sink += BENCH_REAL(sendmsg)(l->sock, &msg, MSG_DONTWAIT);
+    }
+}
+
+static void run_loopback_cases(const struct bench_frame* f) {
+    static struct loopback_ctx l; // the packet buffer is too big for a task stack
+
+    // nobody reads the sink: a full receive buffer drops, the sender does the same work
+    const int sink = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    l.sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    l.to = (struct sockaddr_in){.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t len = sizeof(l.to);
+    if (sink < 0 || l.sock < 0 || bind(sink, (struct sockaddr*)&l.to, sizeof(l.to)) < 0 ||
+        getsockname(sink, (struct sockaddr*)&l.to, &len) < 0) {
+        ESP_LOGW(TAG, "no loopback socket: %d (%s), loopback cases skipped", errno, strerror(errno));
+    } else {
+        l.frame = f;
+        l.max_payload = rtp_jpeg_get_max_packet_size() - BENCH_LOOPBACK_HEADER;
+
+        const struct bench_case cases[] = {
+            {"loopback_copy", f->name, f->len, case_loopback_copy, &l},
+            {"loopback_zero_copy", f->name, f->len, case_loopback_zero_copy, &l},
+        };
+        for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+            run_case(&cases[i]);
+        }
+    }
+
+    if (sink >= 0) {
+        closesocket(sink);
+    }
+    if (l.sock >= 0) {
+        closesocket(l.sock);
+    }
+}
+
+struct send_ctx {
+    camera_fb_t fb;
+    struct rtp_session session;
+    struct pacer pacer;
+    uint8_t packet[RTP_PACKET_SIZE];
+};
+
+/** Receivers the fan-out cases send to, created once since the table owns a mutex */
+static struct rtp_dest_table s_dests;
+
+static void case_rtp_send_jpeg_packets(void* ctx) {
+    struct send_ctx* s = ctx;
+
+    s->pacer.tokens = s->pacer.burst; // refill, pacer_wait must never sleep here
+    rtp_send_jpeg_packets(&s_dests, s->packet, &s->fb, &s->session, &s->pacer, NULL, NULL);
+}
+
+/** Leave the first count receivers, 127.0.0.1:5000, 5002, ..., in the table */
+static void set_destinations(size_t count) {
+    for (size_t i = 0; i < RTP_DEST_MAX; i++) {
+        struct sockaddr_in to = {
+            .sin_family = AF_INET,
+            .sin_port = htons(5000 + 2 * i),
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        };
+        if (i < count) {
+            rtp_dest_add(&s_dests, &to, 0);
+        } else {
+            rtp_dest_remove(&s_dests, &to);
+        }
+    }
+}
+
+/**
+ * The fragment loop against 1, 2, 4 and 8 receivers (up to RTP_DEST_MAX): the
+ * difference between the results is the cost of one more viewer.
+ */
+static void run_fanout_cases(const struct bench_frame* f, struct send_ctx* send) {
+    static const char* const names[] = {"rtp_send_jpeg_packets", "rtp_send_jpeg_fanout_2", "rtp_send_jpeg_fanout_4",
+                                        "rtp_send_jpeg_fanout_8"};
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]) && (1U << i) <= RTP_DEST_MAX; i++) {
+        set_destinations(1U << i);
+
+        const struct bench_case c = {names[i], f->name, f->len, case_rtp_send_jpeg_packets, send};
+        run_case(&c);
+    }
+
+    set_destinations(1);
+}
+
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+static int16_t s_pcm[FRAME_8K];
+static int16_t s_pcm_loud[FRAME_8K];
+static uint8_t s_ulaw[FRAME_8K];
+
+#ifdef CONFIG_ESPRTP_ULAW_TABLE_16K
+static void case_build_xlaw_table(void* ctx) {
+    pdm_mic_codec_init();
+}
+#endif
+
+static void case_pdm_encode(void* ctx) {
+    pdm_mic_encode(s_pcm, FRAME_8K, BENCH_VOLUME_GAIN, s_ulaw);
+    s_sink += s_ulaw[0];
+}
+
+static void case_pdm_encode_clipping(void* ctx) {
+    pdm_mic_encode(s_pcm_loud, FRAME_8K, BENCH_VOLUME_GAIN, s_ulaw);
+    s_sink += s_ulaw[0];
+}
+
+static void case_pdm_encode_float(void* ctx) {
+    pdm_mic_encode_float(s_pcm, FRAME_8K, BENCH_VOLUME_GAIN, s_ulaw);
+    s_sink += s_ulaw[0];
+}
+
+static void case_pdm_encode_float_clipping(void* ctx) {
+    pdm_mic_encode_float(s_pcm_loud, FRAME_8K, BENCH_VOLUME_GAIN, s_ulaw);
+    s_sink += s_ulaw[0];
+}
+
+static void case_pdm_encode_noise_gate(void* ctx) {
+    const float gain = pdm_mic_noise_gate(s_pcm, FRAME_8K) * BENCH_VOLUME_GAIN;
+    pdm_mic_encode(s_pcm, FRAME_8K, gain, s_ulaw);
+    s_sink += s_ulaw[0];
+}
+
+static void run_audio_cases(void) {
+    // speech-level noise so the gate stays open and every table segment is hit
+    uint32_t lcg = 1;
+    for (size_t i = 0; i < FRAME_8K; i++) {
+        lcg = lcg * 1664525U + 1013904223U;
+        s_pcm[i] = (int16_t)(lcg >> 16) / 4;
+        s_pcm_loud[i] = (int16_t)(lcg >> 16); // most of it saturates at VOLUME_GAIN
+    }
+
+    const struct bench_case cases[] = {
+#ifdef CONFIG_ESPRTP_ULAW_TABLE_16K
+        {"build_xlaw_table", "ulaw", 16384, case_build_xlaw_table, NULL},
+#endif
+        {"pdm_encode", "frame_8k", sizeof(s_pcm), case_pdm_encode, NULL},
+        {"pdm_encode", "frame_8k_clipping", sizeof(s_pcm_loud), case_pdm_encode_clipping, NULL},
+        {"pdm_encode_float", "frame_8k", sizeof(s_pcm), case_pdm_encode_float, NULL},
+        {"pdm_encode_float", "frame_8k_clipping", sizeof(s_pcm_loud), case_pdm_encode_float_clipping, NULL},
+        {"pdm_encode_noise_gate", "frame_8k", sizeof(s_pcm), case_pdm_encode_noise_gate, NULL},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        run_case(&cases[i]);
+    }
+}
+#endif
+
+static void run_frame_cases(const struct bench_frame* f) {
+    static struct send_ctx send; // the packet buffer is too big for a task stack
+    struct quant_ctx quant = {0};
+
+    if (jpeg_frame_index(f->buf, f->len, &quant.frame) != ESP_OK) {
+        ESP_LOGW(TAG, "%s is not a baseline JPEG, skipped", f->name);
+        return;
+    }
+
+    memset(&send, 0, sizeof(send));
+    send.fb.buf = (uint8_t*)f->buf;
+    send.fb.len = f->len;
+    send.fb.width = quant.frame.width;
+    send.fb.height = quant.frame.height;
+    send.fb.format = PIXFORMAT_JPEG;
+    rtp_session_init(&send.session, RTP_JPEG_SSRC, RTP_JPEG_PAYLOADTYPE, RTP_JPEG_CLOCK_RATE, 0, 0);
+    // a bucket deeper than any frame, only the pacer bookkeeping is measured
+    ESP_ERROR_CHECK(pacer_init(&send.pacer, UINT32_MAX / 1000U, UINT32_MAX, 0));
+
+    const struct bench_case cases[] = {
+        {"legacy_scan", f->name, f->len, case_legacy_scan, (void*)f},
+        {"jpeg_frame_index", f->name, f->len, case_jpeg_frame_index, (void*)f},
+        {"jpeg_quant_detect", f->name, quant.frame.quant_tables_count * QUANT_TABLE_SIZE, case_jpeg_quant_detect,
+         &quant},
+    };
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        run_case(&cases[i]);
+    }
+
+    run_fanout_cases(f, &send);
+    pacer_deinit(&send.pacer);
+
+    run_loopback_cases(f);
+}
+
+void bench_run(const struct bench_frame* frames, size_t count) {
+    ESP_LOGI(TAG, "%zu frames, zero copy %s, u-law encoder %s", count,
+#ifdef CONFIG_ESPRTP_JPEG_ZERO_COPY
+             "on",
+#else
+             "off",
+#endif
+             BENCH_ULAW);
+
+    static struct rtp_session dest_session; // SSRC the destinations share
+    rtp_session_init(&dest_session, RTP_JPEG_SSRC, RTP_JPEG_PAYLOADTYPE, RTP_JPEG_CLOCK_RATE, 0, 0);
+    if (s_dests.lock == NULL) {
+        ESP_ERROR_CHECK(rtp_dest_table_init(&s_dests, -1, &dest_session));
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        run_frame_cases(&frames[i]);
+    }
+
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+    run_audio_cases();
+#endif
+}
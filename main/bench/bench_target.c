@@ -0,0 +1,82 @@
+#include <string.h>
+
+#include "esp_camera.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "include/bench.h"
+
+#define BENCH_SETTLE_FRAMES 5 // let exposure settle after a frame size change
+
+static const char* const TAG = "bench_target";
+
+static const struct {
+    framesize_t size;
+    const char* name;
+} s_sizes[] = {
+    {FRAMESIZE_QVGA, "qvga"},
+    {FRAMESIZE_SVGA, "svga"},
+    {FRAMESIZE_UXGA, "uxga"},
+};
+
+#define BENCH_FRAMES (sizeof(s_sizes) / sizeof(s_sizes[0]))
+
+/**
+ * Grab one frame at the given size and keep a copy in PSRAM, so every case
+ * reads the same bytes and the driver gets its buffer back.
+ */
+static esp_err_t capture(framesize_t size, struct bench_frame* frame) {
+    sensor_t* sensor = esp_camera_sensor_get();
+    if (unlikely(sensor == NULL || sensor->set_framesize(sensor, size) != 0)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    camera_fb_t* fb = NULL;
+    for (int i = 0; i <= BENCH_SETTLE_FRAMES; i++) {
+        if (fb) {
+            esp_camera_fb_return(fb);
+        }
+        fb = esp_camera_fb_get();
+        if (unlikely(fb == NULL)) {
+            return ESP_FAIL;
+        }
+    }
+
+    uint8_t* copy = heap_caps_malloc(fb->len, MALLOC_CAP_SPIRAM);
+    if (unlikely(copy == NULL)) {
+        esp_camera_fb_return(fb);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, fb->buf, fb->len);
+    frame->buf = copy;
+    frame->len = fb->len;
+    esp_camera_fb_return(fb);
+
+    return ESP_OK;
+}
+
+void bench_target_run(void) {
+    struct bench_frame frames[BENCH_FRAMES];
+    size_t count = 0;
+
+    for (size_t i = 0; i < BENCH_FRAMES; i++) {
+        frames[count].name = s_sizes[i].name;
+        esp_err_t err = capture(s_sizes[i].size, &frames[count]);
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "%s: %zu bytes", frames[count].name, frames[count].len);
+            count++;
+        } else {
+            ESP_LOGW(TAG, "%s capture failed: %s", s_sizes[i].name, esp_err_to_name(err));
+        }
+    }
+
+    bench_run(frames, count);
+
+    for (size_t i = 0; i < count; i++) {
+        heap_caps_free((void*)frames[i].buf);
+    }
+    ESP_LOGI(TAG, "done");
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** A JPEG frame the per-frame cases run on */
+struct bench_frame {
+    const char* name;
+    const uint8_t* buf;
+    size_t len;
+};
+
+/**
+ * Run every case on every frame and print one JSON object per line:
+ *
+ *   {"bench":"jpeg_frame_index","input":"qvga","bytes":9213,"iterations":4096,
+ *    "ns_per_op":812.4,"cycles_per_op":194976,"mb_per_s":11.34,"platform":"esp32s3"}
+ *
+ * Each result is the median of BENCH_REPEATS batches of at least
+ * BENCH_MIN_BATCH_US. cycles_per_op is only reported on the target.
+ */
+void bench_run(const struct bench_frame* frames, size_t count);
+
+#ifdef ESP_PLATFORM
+/** Capture a QVGA, SVGA and UXGA frame from the camera and run bench_run on them */
+void bench_target_run(void);
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct audio_clock_stats {
+    int32_t drift_ppm; // I2S sample clock against esp_timer, averaged since capture started
+    int32_t offset;    // output samples ahead of esp_timer (negative: behind)
+    uint32_t inserted; // samples added to catch up with a slow I2S clock
+    uint32_t dropped;  // samples removed to hold back a fast one
+};
+
+/**
+ * The audio media clock. Timestamps count captured samples, lost frames
+ * included, so a gap in the audio is a gap in the timestamps. The video
+ * timestamps come from esp_timer, and the I2S clock is a different crystal:
+ * the offset between the two is measured on every frame and a sample is
+ * inserted or dropped when it drifts past one sample, which keeps both
+ * streams on the esp_timer clock. Only the audio task updates it, the
+ * stats may be read from any task.
+ */
+struct audio_clock {
+    uint32_t rate;
+    bool started;
+    int64_t first_us;     // captured_us of the first frame
+    uint64_t first_input; // input samples up to the end of the first frame
+    int64_t adjust;       // output minus input samples
+    int32_t error_q8;     // smoothed output offset, 1/256 samples
+    struct audio_clock_stats stats;
+};
+
+void audio_clock_init(struct audio_clock* c, uint32_t rate);
+
+/**
+ * A frame of samples, the seq-th since capture started, ended at captured_us.
+ * The step is only taken by audio_clock_commit, once the frame went out with it.
+ *
+ * @param timestamp set to the media timestamp of its first sample
+ * @return the samples to add to it: 1 to insert one, -1 to drop one, or 0
+ */
+int audio_clock_update(struct audio_clock* c, uint32_t seq, size_t samples, int64_t captured_us,
+                       uint32_t* timestamp);
+
+/**
+ * The frame of the last audio_clock_update was sent with step samples added,
+ * 0 if it was lost or too short to adjust; a step not taken is asked for again.
+ */
+void audio_clock_commit(struct audio_clock* c, int step);
+
+void audio_clock_get_stats(const struct audio_clock* c, struct audio_clock_stats* out);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AUDIO_RING_SLOTS 8 // power of two
+
+/** A captured frame, still in the DMA buffer it was received into */
+struct audio_ring_frame {
+    const int16_t* pcm;
+    size_t samples;
+    int64_t captured_us; // when its last sample arrived
+    uint32_t seq;        // DMA buffers completed before it
+};
+
+struct audio_ring_stats {
+    uint32_t produced;  // DMA buffers completed
+    uint32_t consumed;  // frames handed to the reader intact
+    uint32_t overruns;  // frames lost because the ring was full
+    uint32_t late;      // frames overwritten by the DMA before they were read
+    uint32_t underruns; // reads that gave up waiting for a frame
+};
+
+/**
+ * Single producer, single consumer ring of captured frames, lock-free. The
+ * producer is the I2S receive callback: it pushes the DMA buffer that just
+ * completed, so nothing is copied until the reader encodes it. The DMA
+ * writes into the same buffers again after depth more frames, which makes a
+ * frame the reader is too slow for stale: it is skipped, and counted late.
+ *
+ * Only the producer writes head, produced and overruns; only the consumer
+ * writes tail, consumed, late and underruns.
+ */
+struct audio_ring {
+    struct audio_ring_frame slots[AUDIO_RING_SLOTS];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t depth; // later frames a DMA buffer survives
+    struct audio_ring_stats stats;
+};
+
+/** Start empty; depth is the DMA descriptor count less a frame of margin for the one being filled */
+void audio_ring_init(struct audio_ring* r, uint32_t depth);
+
+/**
+ * Producer: a DMA buffer completed. Safe from an ISR.
+ *
+ * @return false if the ring is full and the frame was dropped
+ */
+bool audio_ring_push(struct audio_ring* r, const int16_t* pcm, size_t samples, int64_t captured_us);
+
+/**
+ * Consumer: the oldest frame that is still intact, stale ones are dropped.
+ *
+ * @return false if there is none yet
+ */
+bool audio_ring_peek(struct audio_ring* r, struct audio_ring_frame* out);
+
+/**
+ * Consumer: done with the frame from audio_ring_peek.
+ *
+ * @return false if the DMA may have overwritten it meanwhile, so whatever
+ *         was made of it must be thrown away
+ */
+bool audio_ring_release(struct audio_ring* r, const struct audio_ring_frame* frame);
+
+/** Consumer: no frame came in time */
+void audio_ring_underrun(struct audio_ring* r);
+
+void audio_ring_get_stats(const struct audio_ring* r, struct audio_ring_stats* out);
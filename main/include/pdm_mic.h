@@ -1,9 +1,64 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "esp_err.h"
 
+#include "audio_clock.h"
+#include "audio_ring.h"
+
 #define FRAME_16K 320 // 20 ms @ 16 kHz
 #define FRAME_8K 160  // 160 @ 8 kHz
 
 esp_err_t pdm_mic_init();
-esp_err_t pdm_mic_read(uint8_t* ulaw_buffer, size_t* ulaw_size);
\ No newline at end of file
+
+#define PDM_MIC_FRAME_MAX (FRAME_8K + 1) // μ-law bytes of a frame with a sample inserted
+
+struct pdm_mic_frame {
+    size_t samples;      // μ-law bytes, FRAME_8K give or take the one the media clock needs
+    uint32_t timestamp;  // of the first sample, in 8 kHz ticks since capture started, lost frames counted
+    int64_t captured_us; // when the last sample arrived
+};
+
+/**
+ * Encode the oldest captured 20 ms frame, waiting for one if need be. The
+ * I2S receive callback queues each DMA buffer as it completes, so the caller
+ * is paced by the microphone. A NULL ulaw_buffer drops the frame unencoded
+ * but still advances the timestamps. ulaw_buffer takes PDM_MIC_FRAME_MAX
+ * bytes: a sample is inserted or dropped now and then to keep the audio on
+ * the esp_timer clock the video uses.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_TIMEOUT if no frame came (an underrun),
+ *         ESP_ERR_INVALID_STATE if the frame was overwritten while encoding.
+ */
+esp_err_t pdm_mic_read(uint8_t* ulaw_buffer, struct pdm_mic_frame* out);
+
+/** Capture ring counters: overruns, frames overwritten before they were read, underruns */
+void pdm_mic_get_stats(struct audio_ring_stats* out);
+
+/** Media clock: I2S drift against esp_timer and the samples inserted or dropped for it */
+void pdm_mic_get_clock_stats(struct audio_clock_stats* out);
+
+/** Build the linear to μ-law table if the encoder uses one, pdm_mic_init does this */
+void pdm_mic_codec_init(void);
+
+/**
+ * Update the noise gate with one frame and return its gain, 0.0 (closed) to
+ * 1.0 (open). The gate keeps state between calls.
+ */
+float pdm_mic_noise_gate(const int16_t* pcm, size_t samples);
+
+/**
+ * Scale samples by gain and encode them to μ-law. The gain is taken to Q15
+ * once per call, below 4.0; the scaled samples saturate at the int16_t range.
+ */
+void pdm_mic_encode(const int16_t* pcm, size_t samples, float gain, uint8_t* ulaw);
+
+/**
+ * The per-sample float path pdm_mic_encode replaced, clamped instead of
+ * wrapping, as its reference in the bench and tests. Both give the same
+ * μ-law when the gain is a multiple of 2^-15 and pcm * gain is exact in float.
+ */
+void pdm_mic_encode_float(const int16_t* pcm, size_t samples, float gain, uint8_t* ulaw);
@@ -6,6 +6,7 @@
 #include "nvs_flash.h"
 
 #include "include/camera_pins.h"
+#include "bench/include/bench.h"
 #include "include/pdm_mic.h"
 #include "rtp/include/rtp.h"
 #include "wifi/include/wifi.h"
@@ -57,8 +58,17 @@ __attribute__((cold)) static esp_err_t camera_init() {
     if (likely(config.pixel_format == PIXFORMAT_JPEG)) {
         if (likely(esp_psram_is_initialized())) {
             config.jpeg_quality = 10;
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
+            // one buffer being sent, the queued ones and one the driver keeps filling
+            config.fb_count = CONFIG_ESPRTP_VIDEO_QUEUE_LEN + 2;
+#else
             config.fb_count = 2;
+#endif
             config.grab_mode = CAMERA_GRAB_LATEST;
+#ifdef CONFIG_ESPRTP_BENCHMARK
+            // buffers are sized at init, the benchmark captures up to UXGA
+            config.frame_size = FRAMESIZE_UXGA;
+#endif
         } else {
             // Limit the frame size when PSRAM is not available
             config.frame_size = FRAMESIZE_SVGA;
@@ -97,6 +107,11 @@ __attribute__((cold)) static esp_err_t app_logic() {
     ESP_RETURN_ON_ERROR(pdm_mic_init(), TAG, "pdm_mic_init");
 #endif
 
+#ifdef CONFIG_ESPRTP_BENCHMARK
+    bench_target_run();
+    return ESP_OK;
+#endif
+
     ESP_RETURN_ON_ERROR(wifi_connect(), TAG, "wifi_connect");
 
     rtp_init();
@@ -1,12 +1,18 @@
+#include <inttypes.h>
+
 #include "esp_check.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "driver/i2s_pdm.h"
 #include "driver/i2s_std.h"
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
+#include "include/audio_clock.h"
+#include "include/audio_ring.h"
 #include "include/pdm_mic.h"
 
 #define SAMPLE_RATE 8000
@@ -15,6 +21,8 @@
 #define PDM_CLK GPIO_NUM_42
 
 #define READ_TIMEOUT_MS 100
+#define DMA_DESC_NUM 8 // 160 ms of 20 ms buffers, the ring reads them in place
+#define DRIFT_LOG_INTERVAL_US (60 * 1000000LL)
 
 static const char* TAG = "pdm_mic";
 
@@ -27,10 +35,23 @@ static const char* TAG = "pdm_mic";
 #define BIAS (0x84)      /* Bias for linear code. */
 
 #ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+#ifdef CONFIG_ESPRTP_ULAW_TABLE_16K
 static DRAM_ATTR uint8_t linear_to_ulaw[16384];
+#elif defined(CONFIG_ESPRTP_ULAW_TABLE_256)
+// floor(log2(i)), the segment of a biased magnitude in 32-step buckets
+static DRAM_ATTR const uint8_t ulaw_segment[256] = {
+    [1] = 0,         [2 ... 3] = 1,    [4 ... 7] = 2,     [8 ... 15] = 3,
+    [16 ... 31] = 4, [32 ... 63] = 5,  [64 ... 127] = 6,  [128 ... 255] = 7,
+};
+#endif
 static i2s_chan_handle_t rx_chan;
+static struct audio_ring s_ring;
+static SemaphoreHandle_t s_frame_ready;
+static struct audio_clock s_clock;
+static int64_t s_drift_logged_us;
 #endif
 
+#ifdef CONFIG_ESPRTP_ULAW_TABLE_16K
 static
     __attribute__((cold)) void build_xlaw_table(uint8_t* linear_to_xlaw, int (*xlaw2linear)(unsigned char), int mask) {
     int i, j, v, v1, v2;
@@ -73,11 +94,70 @@ static void pcm_ulaw_tableinit(void) {
     build_xlaw_table(linear_to_ulaw, ulaw2linear, 0xff);
 }
 
-esp_err_t __attribute__((cold)) pdm_mic_init() {
+static inline uint8_t ulaw_encode(int32_t x) {
+    return linear_to_ulaw[(x + 32768) >> 2];
+}
+#else
+/**
+ * The FFmpeg table computed per sample. It rounds to the nearest μ-law level:
+ * with m the table's 14-bit magnitude plus 33, level q + 1 of segment s starts
+ * at (q + 17) << (s + 1), except that segment s itself starts a quarter step
+ * late, at (32 << s) + ceil((1 << s) / 4).
+ */
+static inline uint8_t ulaw_encode(int32_t x) {
+    const int32_t j = x >> 2;
+    const int32_t sign = j >> 31;
+    uint32_t m = (uint32_t)((j ^ sign) - sign) + 33;
+    m = m < 8191 ? m : 8191; // all of the top level
+
+#ifdef CONFIG_ESPRTP_ULAW_CLZ
+    const uint32_t seg = 26 - __builtin_clz(m);
+#else
+    const uint32_t seg = ulaw_segment[m >> 5];
+#endif
+    const uint32_t late = m < (32U << seg) + (((1U << seg) + 3) >> 2);
+    const uint32_t code = (seg << 4) + (m >> (seg + 1)) - 16 - late;
 
+    return code ^ (0xFF ^ (sign & 0x80));
+}
+#endif
+
+void pdm_mic_codec_init(void) {
+#ifdef CONFIG_ESPRTP_ULAW_TABLE_16K
     pcm_ulaw_tableinit();
+#endif
+}
+
+/** A DMA buffer, exactly one frame, has been received */
+static bool IRAM_ATTR on_recv(i2s_chan_handle_t handle, i2s_event_data_t* event, void* user_ctx) {
+    const int16_t* pcm = *(int16_t* const*)event->data;
+    BaseType_t woken = pdFALSE;
+
+    if (likely(audio_ring_push(&s_ring, pcm, event->size / sizeof(int16_t), esp_timer_get_time()))) {
+        xSemaphoreGiveFromISR(s_frame_ready, &woken);
+    }
+
+    return woken == pdTRUE;
+}
+
+esp_err_t __attribute__((cold)) pdm_mic_init() {
+
+    pdm_mic_codec_init();
+
+    s_frame_ready = xSemaphoreCreateBinary();
+    if (unlikely(s_frame_ready == NULL)) {
+        ESP_LOGE(TAG, "xSemaphoreCreateBinary");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // one buffer is being filled, keep another as margin
+    audio_ring_init(&s_ring, DMA_DESC_NUM - 2);
+    audio_clock_init(&s_clock, SAMPLE_RATE);
+    s_drift_logged_us = esp_timer_get_time();
 
     i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_PORT, I2S_ROLE_MASTER);
+    chan_cfg.dma_desc_num = DMA_DESC_NUM;
+    chan_cfg.dma_frame_num = FRAME_8K;
 
     ESP_RETURN_ON_ERROR(i2s_new_channel(&chan_cfg, NULL, &rx_chan), TAG, "i2s_new_channel");
 
@@ -96,6 +176,11 @@ esp_err_t __attribute__((cold)) pdm_mic_init() {
     };
 
     ESP_RETURN_ON_ERROR(i2s_channel_init_pdm_rx_mode(rx_chan, &pdm_cfg), TAG, "i2s_channel_init_pdm_rx_mode");
+
+    const i2s_event_callbacks_t callbacks = {.on_recv = on_recv};
+    ESP_RETURN_ON_ERROR(i2s_channel_register_event_callback(rx_chan, &callbacks, NULL), TAG,
+                        "i2s_channel_register_event_callback");
+
     return i2s_channel_enable(rx_chan);
 }
 
@@ -104,30 +189,22 @@ esp_err_t __attribute__((cold)) pdm_mic_init() {
 #define RELEASE_FACTOR 0.05f  // скорость закрытия noise gate
 
 // плавная регулировка громкости (0.0 = тихо, 1.0 = обычная, 2.0 = +100%)
-#define VOLUME_GAIN 2.5f;
+#define VOLUME_GAIN 2.5f
 
 static inline int16_t abs16(int16_t x) {
     int16_t mask = x >> 15;
     return (x + mask) ^ mask;
 }
 
-esp_err_t pdm_mic_read(uint8_t* ulaw_buffer, size_t* ulaw_size) {
-    size_t bytes_read = 0;
-    int16_t pcm8k[FRAME_8K];
-
-    ESP_RETURN_ON_ERROR(i2s_channel_read(rx_chan, pcm8k, sizeof(pcm8k), &bytes_read, pdMS_TO_TICKS(READ_TIMEOUT_MS)),
-                        TAG, "i2s_channel_read");
-
-    size_t samples_read = bytes_read / sizeof(int16_t);
+float pdm_mic_noise_gate(const int16_t* pcm, size_t samples) {
+    static float gate_gain = 0.0f; // плавный gain noise gate
 
-#ifdef NOISE_GATE
     // --- RMS через среднее абсолютное значение ---
-    static float gate_gain = 0.0f; // плавный gain noise gate
     uint32_t sum_abs = 0;
-    for (size_t i = 0; i < samples_read; i++) {
-        sum_abs += abs16(pcm8k[i]);
+    for (size_t i = 0; i < samples; i++) {
+        sum_abs += abs16(pcm[i]);
     }
-    const float rms = sum_abs / (float)samples_read;
+    const float rms = sum_abs / (float)samples;
 
     // --- плавный noise gate ---
     const bool open = __builtin_expect(rms > NOISE_RMS_THRESH, 0);
@@ -137,18 +214,145 @@ esp_err_t pdm_mic_read(uint8_t* ulaw_buffer, size_t* ulaw_size) {
         gate_gain = 0.0f;
     if (gate_gain > 1.0f)
         gate_gain = 1.0f;
-#endif
 
-    for (size_t i = 0; i < samples_read; i++) {
+    return gate_gain;
+}
+
+#define GAIN_Q15_MAX 0x1FFFFU // just under 4.0, so |x| * gain fits 32 bits
+
+static inline uint32_t gain_to_q15(float gain) {
+    if (!(gain > 0.0f)) {
+        return 0;
+    }
+    return gain >= GAIN_Q15_MAX / 32768.0f ? GAIN_Q15_MAX : (uint32_t)(gain * 32768.0f + 0.5f);
+}
+
+/**
+ * x * gain in Q15 on the magnitude, so the shift truncates toward zero like
+ * the float to int16_t cast did, then saturated to -32768..32767 instead of
+ * wrapping. Branchless: sign is 0 or -1.
+ */
+static inline int32_t apply_gain(int16_t x, uint32_t gain) {
+    const int32_t sign = x >> 15;
+    const uint32_t mag = (uint32_t)((x ^ sign) - sign);
+    const uint32_t limit = 32767 - sign;
+
+    uint32_t y = (mag * gain) >> 15;
+    y = y < limit ? y : limit;
+
+    return (int32_t)(y ^ sign) - sign;
+}
+
+void pdm_mic_encode(const int16_t* pcm, size_t samples, float gain, uint8_t* ulaw) {
+    const uint32_t g = gain_to_q15(gain);
+    size_t i = 0;
+
+    // four independent multiplies per pass keep the encoder's loads back to back
+    for (; i + 4 <= samples; i += 4) {
+        const int32_t y0 = apply_gain(pcm[i], g);
+        const int32_t y1 = apply_gain(pcm[i + 1], g);
+        const int32_t y2 = apply_gain(pcm[i + 2], g);
+        const int32_t y3 = apply_gain(pcm[i + 3], g);
+        ulaw[i] = ulaw_encode(y0);
+        ulaw[i + 1] = ulaw_encode(y1);
+        ulaw[i + 2] = ulaw_encode(y2);
+        ulaw[i + 3] = ulaw_encode(y3);
+    }
+    for (; i < samples; i++) {
+        ulaw[i] = ulaw_encode(apply_gain(pcm[i], g));
+    }
+}
+
+void pdm_mic_encode_float(const int16_t* pcm, size_t samples, float gain, uint8_t* ulaw) {
+    for (size_t i = 0; i < samples; i++) {
+        float sample = pcm[i] * gain;
+        sample = sample < 32767.0f ? sample : 32767.0f;
+        sample = sample > -32768.0f ? sample : -32768.0f;
+        ulaw[i] = ulaw_encode((int16_t)sample);
+    }
+}
+
+/**
+ * Encode a frame with one sample more (step 1) or less (step -1) for the
+ * media clock. The two samples in the middle are averaged into the inserted
+ * one, or merged into one: no click, and the DMA buffer is read in place.
+ *
+ * @return the μ-law bytes written
+ */
+static size_t encode_adjusted(const int16_t* pcm, size_t samples, float gain, int step, uint8_t* ulaw) {
+    const size_t mid = samples / 2;
+    if (step == 0 || mid == 0) { // too short to split, the step waits for the next frame
+        pdm_mic_encode(pcm, samples, gain, ulaw);
+        return samples;
+    }
+
+    const int16_t joint = (int16_t)((pcm[mid - 1] + pcm[mid]) / 2);
+    if (step > 0) {
+        pdm_mic_encode(pcm, mid, gain, ulaw);
+        pdm_mic_encode(&joint, 1, gain, ulaw + mid);
+        pdm_mic_encode(pcm + mid, samples - mid, gain, ulaw + mid + 1);
+        return samples + 1;
+    }
+
+    pdm_mic_encode(pcm, mid - 1, gain, ulaw);
+    pdm_mic_encode(&joint, 1, gain, ulaw + mid - 1);
+    pdm_mic_encode(pcm + mid + 1, samples - mid - 1, gain, ulaw + mid);
+    return samples - 1;
+}
+
+static void log_drift(int64_t now_us) {
+    if (now_us - s_drift_logged_us < DRIFT_LOG_INTERVAL_US) {
+        return;
+    }
+    s_drift_logged_us = now_us;
+
+    struct audio_clock_stats clock;
+    audio_clock_get_stats(&s_clock, &clock);
+    ESP_LOGI(TAG,
+             "I2S clock %+" PRId32 " ppm against esp_timer, offset %" PRId32 " samples, %" PRIu32 " inserted, %" PRIu32
+             " dropped",
+             clock.drift_ppm, clock.offset, clock.inserted, clock.dropped);
+}
+
+esp_err_t pdm_mic_read(uint8_t* ulaw_buffer, struct pdm_mic_frame* out) {
+    struct audio_ring_frame frame;
+
+    while (!audio_ring_peek(&s_ring, &frame)) {
+        if (xSemaphoreTake(s_frame_ready, pdMS_TO_TICKS(READ_TIMEOUT_MS)) != pdPASS) {
+            audio_ring_underrun(&s_ring);
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+
+    const size_t samples = frame.samples < FRAME_8K ? frame.samples : FRAME_8K;
+    const int step = audio_clock_update(&s_clock, frame.seq, samples, frame.captured_us, &out->timestamp);
+    size_t encoded = samples / 2 ? samples + step : samples; // as encode_adjusted would
+    if (ulaw_buffer) {
 #ifdef NOISE_GATE
-        float sample = pcm8k[i] * gate_gain * VOLUME_GAIN;
+        const float gain = pdm_mic_noise_gate(frame.pcm, samples) * VOLUME_GAIN;
 #else
-        float sample = pcm8k[i] * VOLUME_GAIN;
+        const float gain = VOLUME_GAIN;
 #endif
-        ulaw_buffer[i] = linear_to_ulaw[((int16_t)sample + 32768) >> 2];
+        // straight from the DMA buffer
+        encoded = encode_adjusted(frame.pcm, samples, gain, step, ulaw_buffer);
+    }
+
+    if (unlikely(!audio_ring_release(&s_ring, &frame))) {
+        return ESP_ERR_INVALID_STATE; // the DMA came round while it was encoded, the clock keeps its step
     }
 
-    *ulaw_size = samples_read;
+    audio_clock_commit(&s_clock, (int)encoded - (int)samples);
+    out->samples = encoded;
+    out->captured_us = frame.captured_us;
+    log_drift(frame.captured_us);
 
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+void pdm_mic_get_stats(struct audio_ring_stats* out) {
+    audio_ring_get_stats(&s_ring, out);
+}
+
+void pdm_mic_get_clock_stats(struct audio_clock_stats* out) {
+    audio_clock_get_stats(&s_clock, out);
+}
@@ -0,0 +1,382 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "include/dest.h"
+
+static const char* const TAG = "rtp_dest";
+
+static inline bool same_addr(const struct sockaddr_in* a, const struct sockaddr_in* b) {
+    return a->sin_addr.s_addr == b->sin_addr.s_addr && a->sin_port == b->sin_port;
+}
+
+static struct rtp_dest* find_dest(struct rtp_dest_table* t, const struct sockaddr_in* addr) {
+    for (size_t i = 0; i < RTP_DEST_MAX; i++) {
+        if (t->dests[i].active && same_addr(&t->dests[i].addr, addr)) {
+            return &t->dests[i];
+        }
+    }
+
+    return NULL;
+}
+
+esp_err_t rtp_dest_table_init(struct rtp_dest_table* t, int sock, const struct rtp_session* session) {
+    memset(t, 0, sizeof(*t));
+    t->sock = sock;
+    t->session = session;
+
+    t->lock = xSemaphoreCreateMutex();
+    if (unlikely(t->lock == NULL)) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t add(struct rtp_dest_table* t, const struct sockaddr_in* addr, uint32_t own_ssrc,
+                     struct rtp_tcp_link* link, uint8_t channel) {
+    esp_err_t err = ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+
+    if (find_dest(t, addr)) {
+        err = ESP_ERR_INVALID_STATE;
+        goto out;
+    }
+
+    for (size_t i = 0; i < RTP_DEST_MAX; i++) {
+        struct rtp_dest* d = &t->dests[i];
+        if (d->active) {
+            continue;
+        }
+
+        memset(d, 0, sizeof(*d));
+        d->addr = *addr;
+        d->link = link;
+        d->channel = channel;
+        d->rewrite = own_ssrc != 0;
+        d->ssrc = own_ssrc ? own_ssrc : t->session->ssrc;
+        // a fresh random sequence that starts with the next packet (RFC 3550 5.1)
+        d->seq_delta = own_ssrc ? (uint16_t)(esp_random() - __atomic_load_n(&t->session->seq, __ATOMIC_RELAXED)) : 0;
+        d->active = true;
+        err = ESP_OK;
+        break;
+    }
+
+out:
+    xSemaphoreGive(t->lock);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "+ %s:%d%s SSRC %08" PRIx32, inet_ntoa(addr->sin_addr), ntohs(addr->sin_port),
+                 link ? " (TCP)" : "", own_ssrc ? own_ssrc : t->session->ssrc);
+    }
+    return err;
+}
+
+esp_err_t rtp_dest_add(struct rtp_dest_table* t, const struct sockaddr_in* addr, uint32_t own_ssrc) {
+    return add(t, addr, own_ssrc, NULL, 0);
+}
+
+esp_err_t rtp_dest_add_interleaved(struct rtp_dest_table* t, const struct sockaddr_in* addr,
+                                   struct rtp_tcp_link* link, uint8_t channel) {
+    return add(t, addr, 0, link, channel);
+}
+
+esp_err_t rtp_dest_remove(struct rtp_dest_table* t, const struct sockaddr_in* addr) {
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+
+    struct rtp_dest* d = find_dest(t, addr);
+    if (d) {
+        d->active = false;
+    }
+
+    xSemaphoreGive(t->lock);
+
+    if (d == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    ESP_LOGI(TAG, "- %s:%d", inet_ntoa(addr->sin_addr), ntohs(addr->sin_port));
+    return ESP_OK;
+}
+
+esp_err_t rtp_dest_replace(struct rtp_dest_table* t, const struct sockaddr_in* from, const struct sockaddr_in* to) {
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+
+    struct rtp_dest* d = find_dest(t, from);
+    if (d == NULL) {
+        err = ESP_ERR_NOT_FOUND;
+    } else if (find_dest(t, to)) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        d->addr = *to;
+        d->consecutive_errors = 0;
+        d->resume_us = 0;
+        memset(&d->stats, 0, sizeof(d->stats));
+    }
+
+    xSemaphoreGive(t->lock);
+
+    if (err == ESP_OK) {
+        char from_ip[16]; // inet_ntoa returns a static buffer
+        snprintf(from_ip, sizeof(from_ip), "%s", inet_ntoa(from->sin_addr));
+        ESP_LOGI(TAG, "%s:%d -> %s:%d", from_ip, ntohs(from->sin_port), inet_ntoa(to->sin_addr), ntohs(to->sin_port));
+    }
+    return err;
+}
+
+static int send_to(int sock, const struct sockaddr_in* to, uint8_t* head, size_t head_len, const uint8_t* data,
+                   size_t data_len) {
+    if (data == NULL) {
+        return sendto(sock, head, head_len, MSG_DONTWAIT, (const struct sockaddr*)to, sizeof(*to));
+    }
+
+    // lwIP builds the datagram from the iovec before sendmsg returns
+    struct iovec iov[2] = {
+        {.iov_base = head, .iov_len = head_len},
+        {.iov_base = (void*)data, .iov_len = data_len},
+    };
+    struct msghdr msg = {
+        .msg_name = (void*)to,
+        .msg_namelen = sizeof(*to),
+        .msg_iov = iov,
+        .msg_iovlen = 2,
+    };
+
+    return sendmsg(sock, &msg, MSG_DONTWAIT);
+}
+
+/** What send_all needs of a destination, copied out so the sends run without the table lock */
+struct target {
+    size_t index;
+    struct sockaddr_in addr;
+    struct rtp_tcp_link* link; // links outlive their table entries, see rtsp.c
+    uint8_t channel;
+    bool rewrite;
+    uint32_t ssrc;
+    uint16_t seq_delta;
+    esp_err_t err; // ESP_ERR_NO_MEM: dropped by a backed up TCP link
+    int sent_errno;
+};
+
+static size_t snapshot(struct rtp_dest_table* t, struct target* out, bool repair) {
+    size_t count = 0;
+    int64_t now = 0;
+
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+
+    for (size_t i = 0; i < RTP_DEST_MAX; i++) {
+        struct rtp_dest* d = &t->dests[i];
+        if (!d->active) {
+            continue;
+        }
+
+        // TCP cannot lose packets, and a destination with its own SSRC never got the stream's
+        // sequence numbers the retransmission or the parity refers to
+        if (repair && (d->link || d->rewrite)) {
+            continue;
+        }
+
+        if (unlikely(d->resume_us)) {
+            now = now ? now : esp_timer_get_time();
+            if (now < d->resume_us) {
+                d->stats.skipped++;
+                continue;
+            }
+            d->resume_us = 0;
+        }
+
+        out[count++] = (struct target){
+            .index = i,
+            .addr = d->addr,
+            .link = d->link,
+            .channel = d->channel,
+            .rewrite = d->rewrite,
+            .ssrc = d->ssrc,
+            .seq_delta = d->seq_delta,
+        };
+    }
+
+    xSemaphoreGive(t->lock);
+
+    return count;
+}
+
+/** Charge the outcome of the sends to the destinations that are still the same ones */
+static void account(struct rtp_dest_table* t, const struct target* targets, size_t count, size_t len) {
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+
+    for (size_t i = 0; i < count; i++) {
+        const struct target* tg = &targets[i];
+        struct rtp_dest* d = &t->dests[tg->index];
+        if (!d->active || d->link != tg->link || !same_addr(&d->addr, &tg->addr)) {
+            continue; // removed or replaced while sending
+        }
+
+        if (likely(tg->err == ESP_OK)) {
+            d->consecutive_errors = 0;
+            d->stats.packets++;
+            d->stats.bytes += len;
+            continue;
+        }
+
+        // a full queue is the link's way of dropping, not a failure of the destination
+        if (tg->err == ESP_ERR_NO_MEM) {
+            d->stats.skipped++;
+            continue;
+        }
+
+        d->stats.errors++;
+        d->stats.last_errno = tg->sent_errno;
+        if (tg->link == NULL && ++d->consecutive_errors == RTP_DEST_ERROR_LIMIT) {
+            d->resume_us = esp_timer_get_time() + RTP_DEST_BACKOFF_US;
+            d->consecutive_errors = 0;
+            ESP_LOGW(TAG, "%s:%d: %d (%s), backing off", inet_ntoa(d->addr.sin_addr), ntohs(d->addr.sin_port),
+                     tg->sent_errno, strerror(tg->sent_errno));
+        }
+    }
+
+    xSemaphoreGive(t->lock);
+}
+
+static size_t send_all(struct rtp_dest_table* t, uint8_t* head, size_t head_len, const uint8_t* data, size_t data_len,
+                       bool repair) {
+    struct rtp_header* h = (struct rtp_header*)head;
+    const uint16_t seq = h->seqNum;
+    const uint32_t ssrc = h->ssrc;
+    const bool media = ssrc == htonl(t->session->ssrc); // FEC packets keep their own SSRC
+    const bool in_frame = __atomic_load_n(&t->in_frame, __ATOMIC_RELAXED);
+    struct target targets[RTP_DEST_MAX];
+    bool patched = false;
+    size_t sent = 0;
+
+    const size_t count = snapshot(t, targets, repair);
+
+    for (size_t i = 0; i < count; i++) {
+        struct target* tg = &targets[i];
+
+        if (tg->rewrite && media) {
+            h->seqNum = htons(ntohs(seq) + tg->seq_delta);
+            h->ssrc = htonl(tg->ssrc);
+            patched = true;
+        } else if (patched) {
+            h->seqNum = seq;
+            h->ssrc = ssrc;
+            patched = false;
+        }
+
+        if (tg->link) {
+            tg->err = rtp_tcp_link_put(tg->link, tg->channel, head, head_len, data, data_len, in_frame);
+        } else {
+            tg->err = send_to(t->sock, &tg->addr, head, head_len, data, data_len) < 0 ? ESP_FAIL : ESP_OK;
+        }
+
+        if (unlikely(tg->err != ESP_OK)) {
+            tg->sent_errno = errno;
+        } else {
+            sent++;
+        }
+    }
+
+    if (patched) {
+        h->seqNum = seq;
+        h->ssrc = ssrc;
+    }
+
+    if (count) {
+        account(t, targets, count, head_len + data_len);
+    }
+
+    return sent;
+}
+
+size_t rtp_dest_send(struct rtp_dest_table* t, uint8_t* head, size_t head_len, const uint8_t* data, size_t data_len) {
+    return send_all(t, head, head_len, data, data_len, false);
+}
+
+size_t rtp_dest_send_repair(struct rtp_dest_table* t, uint8_t* head, size_t head_len) {
+    return send_all(t, head, head_len, NULL, 0, true);
+}
+
+void rtp_dest_begin_frame(struct rtp_dest_table* t, size_t bytes, size_t packets) {
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+    __atomic_store_n(&t->in_frame, true, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < RTP_DEST_MAX; i++) {
+        if (t->dests[i].active && t->dests[i].link) {
+            rtp_tcp_link_begin_frame(t->dests[i].link, bytes, packets);
+        }
+    }
+    xSemaphoreGive(t->lock);
+}
+
+void rtp_dest_end_frame(struct rtp_dest_table* t) {
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+    __atomic_store_n(&t->in_frame, false, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < RTP_DEST_MAX; i++) {
+        if (t->dests[i].active && t->dests[i].link) {
+            rtp_tcp_link_end_frame(t->dests[i].link);
+        }
+    }
+    xSemaphoreGive(t->lock);
+}
+
+size_t rtp_dest_count(struct rtp_dest_table* t) {
+    size_t count = 0;
+
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+    for (size_t i = 0; i < RTP_DEST_MAX; i++) {
+        count += t->dests[i].active;
+    }
+    xSemaphoreGive(t->lock);
+
+    return count;
+}
+
+size_t rtp_dest_fanout(struct rtp_dest_table* t) {
+    size_t count = 0;
+
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+    for (size_t i = 0; i < RTP_DEST_MAX; i++) {
+        count += t->dests[i].active && t->dests[i].resume_us == 0;
+    }
+    xSemaphoreGive(t->lock);
+
+    return count ? count : 1;
+}
+
+size_t rtp_dest_list(struct rtp_dest_table* t, struct rtp_dest_addr* out, size_t max) {
+    size_t count = 0;
+
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+    for (size_t i = 0; i < RTP_DEST_MAX && count < max; i++) {
+        if (t->dests[i].active) {
+            out[count].addr = t->dests[i].addr;
+            out[count].link = t->dests[i].link;
+            out[count].channel = t->dests[i].channel;
+            out[count].ssrc = t->dests[i].ssrc;
+            count++;
+        }
+    }
+    xSemaphoreGive(t->lock);
+
+    return count;
+}
+
+esp_err_t rtp_dest_get_stats(struct rtp_dest_table* t, const struct sockaddr_in* addr, struct rtp_dest_stats* out) {
+    xSemaphoreTake(t->lock, portMAX_DELAY);
+
+    struct rtp_dest* d = find_dest(t, addr);
+    if (d) {
+        *out = d->stats;
+    }
+
+    xSemaphoreGive(t->lock);
+
+    return d ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_compiler.h"
+
+#include "include/fec.h"
+
+#define FEC_ROW_READY 1U
+
+static void parity_reset(struct fec_parity* p) {
+    p->mask = 0;
+    p->count = 0;
+    p->bits[0] = 0;
+    p->bits[1] = 0;
+    p->ts = 0;
+    p->length = 0;
+    p->protection_length = 0;
+}
+
+static void xor_bytes(uint8_t* dst, const uint8_t* src, size_t len) {
+    size_t i = 0;
+
+    // word at a time when both sides allow it, the payload buffer always does
+    if ((((uintptr_t)dst | (uintptr_t)src) & 3U) == 0) {
+        for (; i + 4 <= len; i += 4) {
+            *(uint32_t*)(dst + i) ^= *(const uint32_t*)(src + i);
+        }
+    }
+    for (; i < len; i++) {
+        dst[i] ^= src[i];
+    }
+}
+
+static void parity_add(struct fec_parity* p, uint16_t seq, const uint8_t* head, size_t head_len, const uint8_t* data,
+                       size_t data_len) {
+    const size_t payload_len = head_len + data_len - sizeof(struct rtp_header);
+
+    if (p->count == 0) {
+        p->sn_base = seq;
+        memset(p->payload, 0, sizeof(p->payload));
+    }
+
+    const uint16_t offset = seq - p->sn_base;
+    p->mask |= 1ULL << (FEC_MAX_SPAN - 1 - offset);
+    p->count++;
+
+    const struct rtp_header* h = (const struct rtp_header*)head;
+    p->bits[0] ^= h->version;
+    p->bits[1] ^= h->payloadtype;
+    p->ts ^= ntohl(h->timestamp);
+    p->length ^= payload_len;
+    if (payload_len > p->protection_length) {
+        p->protection_length = payload_len;
+    }
+
+    const size_t head_payload = head_len - sizeof(struct rtp_header);
+    xor_bytes(p->payload, head + sizeof(struct rtp_header), head_payload);
+    xor_bytes(p->payload + head_payload, data, data_len);
+}
+
+esp_err_t fec_encoder_init(struct fec_encoder* e, struct rtp_session* session, uint8_t row_length, uint8_t depth) {
+    if (unlikely(row_length < 2 || row_length > FEC_MAX_ROW_LENGTH || depth == 1 ||
+                 (depth && (size_t)row_length * (depth - 1) + 1 > FEC_MAX_SPAN))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(e, 0, sizeof(*e));
+    e->session = session;
+    e->row_length = row_length;
+    e->depth = depth;
+
+    e->row = calloc(1, sizeof(struct fec_parity));
+    e->columns = depth ? calloc(row_length, sizeof(struct fec_parity)) : NULL;
+    if (unlikely(e->row == NULL || (depth && e->columns == NULL))) {
+        free(e->row);
+        free(e->columns);
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+static void close_row(struct fec_encoder* e) {
+    if (e->row->count) {
+        e->ready |= FEC_ROW_READY;
+    }
+    e->row_index = 0;
+}
+
+static void close_block(struct fec_encoder* e) {
+    for (uint8_t i = 0; i < e->row_length; i++) {
+        if (e->columns[i].count) {
+            e->ready |= 2U << i;
+        }
+    }
+    e->block_index = 0;
+}
+
+void fec_encoder_add(struct fec_encoder* e, const uint8_t* head, size_t head_len, const uint8_t* data,
+                     size_t data_len) {
+    const struct rtp_header* h = (const struct rtp_header*)head;
+    const uint16_t seq = ntohs(h->seqNum);
+    const bool frame_end = h->payloadtype & RTP_MARKER_MASK;
+
+    parity_add(e->row, seq, head, head_len, data, data_len);
+    if (++e->row_index == e->row_length || frame_end) {
+        close_row(e);
+    }
+
+    if (e->depth) {
+        parity_add(&e->columns[e->block_index % e->row_length], seq, head, head_len, data, data_len);
+        if (++e->block_index == e->row_length * e->depth || frame_end) {
+            close_block(e);
+        }
+    }
+}
+
+size_t fec_encoder_next(struct fec_encoder* e, uint32_t media_ts, uint8_t** packet) {
+    if (e->ready == 0) {
+        return 0;
+    }
+
+    const unsigned bit = __builtin_ctz(e->ready);
+    e->ready &= ~(1U << bit);
+    struct fec_parity* p = bit == 0 ? e->row : &e->columns[bit - 1];
+
+    const bool long_mask = (p->mask & 0xFFFFFFFFULL) != 0; // something beyond the first 16 packets
+    uint8_t* out = e->packet;
+
+    rtp_session_write_header(e->session, (struct rtp_header*)out, media_ts, false);
+    out += sizeof(struct rtp_header);
+
+    struct fec_header* fh = (struct fec_header*)out;
+    fh->flags = (long_mask ? FEC_FLAG_LONG_MASK : 0U) | (p->bits[0] & 0x3F);
+    fh->pt_recovery = p->bits[1];
+    fh->sn_base = htons(p->sn_base);
+    fh->ts_recovery = htonl(p->ts);
+    fh->length_recovery = htons(p->length);
+    out += sizeof(*fh);
+
+    // ULP level 0 header: protection length and mask, MSB is sn_base
+    *out++ = p->protection_length >> 8;
+    *out++ = p->protection_length & 0xFF;
+    const size_t mask_size = long_mask ? FEC_MASK_SIZE_LONG : FEC_MASK_SIZE_SHORT;
+    for (size_t i = 0; i < mask_size; i++) {
+        *out++ = (p->mask >> (40 - 8 * i)) & 0xFF;
+    }
+
+    memcpy(out, p->payload, p->protection_length);
+    out += p->protection_length;
+
+    parity_reset(p);
+    e->parity_packets++;
+
+    *packet = e->packet;
+    return out - e->packet;
+}
+
+size_t fec_encoder_overhead(const struct fec_encoder* e, size_t frame_bytes) {
+    // one parity packet per row plus, per block, one per column: about 1/L + 1/D of the media
+    size_t bytes = frame_bytes / e->row_length;
+    if (e->depth) {
+        bytes += frame_bytes / e->depth;
+    }
+
+    return bytes;
+}
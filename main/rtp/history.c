@@ -0,0 +1,150 @@
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "include/history.h"
+
+static const char* const TAG = "rtp_history";
+
+static inline size_t slot_index(const struct rtp_history* h, uint16_t seq) {
+    return seq & (h->size - 1);
+}
+
+esp_err_t rtp_history_init(struct rtp_history* h, size_t size) {
+    if (unlikely(size == 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // a power of two, so a slot is a mask and the slots stay in order across the seq wrap
+    size_t rounded = 1;
+    while (rounded < size) {
+        rounded <<= 1;
+    }
+    size = rounded;
+
+    memset(h, 0, sizeof(*h));
+    h->size = size;
+
+    // the copies are only read back on a NACK, PSRAM bandwidth is plenty
+    h->slab = heap_caps_malloc(size * RTP_PACKET_SIZE, MALLOC_CAP_SPIRAM);
+    if (h->slab == NULL) {
+        h->slab = heap_caps_malloc(size * RTP_PACKET_SIZE, MALLOC_CAP_DEFAULT);
+    }
+    h->entries = heap_caps_calloc(size, sizeof(struct rtp_history_entry), MALLOC_CAP_DEFAULT);
+    h->lock = xSemaphoreCreateMutex();
+
+    if (unlikely(h->slab == NULL || h->entries == NULL || h->lock == NULL)) {
+        heap_caps_free(h->slab);
+        heap_caps_free(h->entries);
+        if (h->lock) {
+            vSemaphoreDelete(h->lock);
+        }
+        memset(h, 0, sizeof(*h));
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "%zu packets, %zu bytes", size, size * (RTP_PACKET_SIZE + sizeof(struct rtp_history_entry)));
+
+    return ESP_OK;
+}
+
+void rtp_history_put(struct rtp_history* h, const uint8_t* head, size_t head_len, const uint8_t* data,
+                     size_t data_len) {
+    const struct rtp_header* header = (const struct rtp_header*)head;
+    const uint16_t seq = ntohs(header->seqNum);
+    const size_t index = slot_index(h, seq);
+    uint8_t* slot = h->slab + index * RTP_PACKET_SIZE;
+
+    if (unlikely(head_len + data_len > RTP_PACKET_SIZE)) {
+        return;
+    }
+
+    xSemaphoreTake(h->lock, portMAX_DELAY);
+
+    memcpy(slot, head, head_len);
+    memcpy(slot + head_len, data, data_len);
+
+    struct rtp_history_entry* e = &h->entries[index];
+    e->valid = true;
+    e->queued = false;
+    e->seq = seq;
+    e->len = head_len + data_len;
+    e->resent_us = 0;
+
+    xSemaphoreGive(h->lock);
+}
+
+static void request_one(struct rtp_history* h, uint16_t seq, int64_t now) {
+    struct rtp_history_entry* e = &h->entries[slot_index(h, seq)];
+
+    h->stats.requested++;
+
+    if (!e->valid || e->seq != seq) {
+        h->stats.too_late++;
+        return;
+    }
+    if (e->queued || (e->resent_us && now - e->resent_us < RTP_HISTORY_RESEND_GAP_US)) {
+        h->stats.deduplicated++;
+        return;
+    }
+    if (unlikely(h->pending_count == RTP_HISTORY_PENDING)) {
+        h->stats.dropped++;
+        return;
+    }
+
+    h->pending[(h->pending_head + h->pending_count++) % RTP_HISTORY_PENDING] = seq;
+    e->queued = true;
+}
+
+void rtp_history_request(struct rtp_history* h, uint16_t pid, uint16_t blp) {
+    const int64_t now = esp_timer_get_time();
+
+    xSemaphoreTake(h->lock, portMAX_DELAY);
+
+    h->stats.nacks++;
+    request_one(h, pid, now);
+    for (unsigned bit = 0; bit < 16; bit++) {
+        if (blp & (1U << bit)) {
+            request_one(h, pid + bit + 1, now);
+        }
+    }
+
+    xSemaphoreGive(h->lock);
+}
+
+size_t rtp_history_next(struct rtp_history* h, uint8_t* out) {
+    size_t len = 0;
+
+    xSemaphoreTake(h->lock, portMAX_DELAY);
+
+    while (h->pending_count > 0 && len == 0) {
+        const uint16_t seq = h->pending[h->pending_head];
+        h->pending_head = (h->pending_head + 1) % RTP_HISTORY_PENDING;
+        h->pending_count--;
+
+        const size_t index = slot_index(h, seq);
+        struct rtp_history_entry* e = &h->entries[index];
+        if (!e->valid || e->seq != seq || !e->queued) {
+            h->stats.too_late++; // overwritten while it waited
+            continue;
+        }
+
+        memcpy(out, h->slab + index * RTP_PACKET_SIZE, e->len);
+        len = e->len;
+        e->queued = false;
+        e->resent_us = esp_timer_get_time();
+        h->stats.resent++;
+    }
+
+    xSemaphoreGive(h->lock);
+
+    return len;
+}
+
+void rtp_history_get_stats(struct rtp_history* h, struct rtp_history_stats* out) {
+    xSemaphoreTake(h->lock, portMAX_DELAY);
+    *out = h->stats;
+    xSemaphoreGive(h->lock);
+}
@@ -7,18 +7,27 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
-/** RTP packet/payload size */
+/** RTP packet buffer size */
 #define RTP_PACKET_SIZE 1500
-#define RTP_PAYLOAD_SIZE 1024
+
+/** Path MTU and the IPv4 + UDP headers that come out of it */
+#define RTP_PATH_MTU CONFIG_ESPRTP_PATH_MTU
+#define RTP_MIN_MTU 576
+#define RTP_MAX_MTU 1500
+#define RTP_IP_UDP_OVERHEAD (20 + 8)
 
 /** RTP header constants */
 #define RTP_VERSION 0x80
 
 #define RTP_JPEG_SSRC 0xDEADBEEF
 #define RTP_JPEG_PAYLOADTYPE 26
+#define RTP_JPEG_CLOCK_RATE 90000
+
+#define RTP_JPEG_FEC_SSRC 0xFEC0BEEF
 
 #define RTP_PCMU_SSRC 0xABADBABE
 #define RTP_PCMU_PAYLOADTYPE 0
+#define RTP_PCMU_CLOCK_RATE 8000
 
 #define RTP_MARKER_MASK 0x80
 
@@ -30,8 +39,13 @@
 #define AUDIO_SUPPORT CONFIG_ESPRTP_AUDIO_SUPPORT
 #define VIDEO_SUPPORT CONFIG_ESPRTP_VIDEO_SUPPORT
 
-/** RTP send delay - in milliseconds */
-#define RTP_SEND_DELAY 10
+/** Frames waiting between the capture and the transmit task */
+#define RTP_VIDEO_QUEUE_LEN CONFIG_ESPRTP_VIDEO_QUEUE_LEN
+
+/** Video pacing */
+#define RTP_VIDEO_BITRATE_KBPS CONFIG_ESPRTP_VIDEO_BITRATE_KBPS
+#define RTP_VIDEO_BURST_BYTES CONFIG_ESPRTP_VIDEO_BURST_BYTES
+#define RTP_VIDEO_FPS CONFIG_ESPRTP_VIDEO_FPS
 
 struct rtp_header {
     uint8_t version;
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "common.h"
+#include "session.h"
+#include "tcp.h"
+
+#define RTP_DEST_MAX CONFIG_ESPRTP_MAX_DESTINATIONS
+
+/** Consecutive send errors after which a destination is skipped for RTP_DEST_BACKOFF_US */
+#define RTP_DEST_ERROR_LIMIT 8
+#define RTP_DEST_BACKOFF_US 1000000LL
+
+struct rtp_dest_stats {
+    uint32_t packets;
+    uint64_t bytes;
+    uint32_t errors;
+    uint32_t skipped; // packets not sent while backing off, or dropped by a backed up TCP link
+    int last_errno;
+};
+
+struct rtp_dest {
+    bool active;
+    struct sockaddr_in addr;
+    struct rtp_tcp_link* link; // interleaved on this TCP connection instead of UDP to addr
+    uint8_t channel;           // RTP channel on link, RTCP uses channel + 1
+    bool rewrite;              // own SSRC and sequence numbers
+    uint32_t ssrc;      // sent SSRC, the stream's unless rewrite
+    uint16_t seq_delta; // added to the stream's sequence number when rewrite
+    uint32_t consecutive_errors;
+    int64_t resume_us; // skipped until then after too many errors
+    struct rtp_dest_stats stats;
+};
+
+/** Address and SSRC of an active destination, for RTCP */
+struct rtp_dest_addr {
+    struct sockaddr_in addr;
+    struct rtp_tcp_link* link;
+    uint8_t channel;
+    uint32_t ssrc;
+};
+
+/**
+ * Receivers of one RTP stream. A packet is built once and sent to every
+ * active destination from the same socket; destinations that asked for
+ * their own SSRC get the SSRC and sequence number patched per send. A
+ * destination that keeps failing is skipped for a while, so an unreachable
+ * viewer costs one failed send per packet at most and never blocks the
+ * others. Destinations can be added and removed from any task; the lock is
+ * held only to copy the table, never across a send.
+ */
+struct rtp_dest_table {
+    SemaphoreHandle_t lock;
+    int sock;
+    const struct rtp_session* session;
+    bool in_frame; // between rtp_dest_begin_frame and rtp_dest_end_frame
+    struct rtp_dest dests[RTP_DEST_MAX];
+};
+
+esp_err_t rtp_dest_table_init(struct rtp_dest_table* t, int sock, const struct rtp_session* session);
+
+/**
+ * @param own_ssrc give this destination its own SSRC and sequence numbers, e.g.
+ *                 for a viewer that joins a running stream and must not see a
+ *                 sequence jump; 0 shares the stream's
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_STATE if the address is already in the table,
+ *         ESP_ERR_NO_MEM if all RTP_DEST_MAX entries are taken.
+ */
+esp_err_t rtp_dest_add(struct rtp_dest_table* t, const struct sockaddr_in* addr, uint32_t own_ssrc);
+
+/**
+ * Add a destination that gets the packets interleaved on an RTSP connection
+ * (RFC 2326 10.12) under the stream's SSRC. addr only identifies it, e.g.
+ * the peer of the connection.
+ *
+ * @return as rtp_dest_add
+ */
+esp_err_t rtp_dest_add_interleaved(struct rtp_dest_table* t, const struct sockaddr_in* addr,
+                                   struct rtp_tcp_link* link, uint8_t channel);
+
+/**
+ * @return ESP_OK on success,
+ *         ESP_ERR_NOT_FOUND if the address is not in the table.
+ */
+esp_err_t rtp_dest_remove(struct rtp_dest_table* t, const struct sockaddr_in* addr);
+
+/**
+ * Point a destination at another address in one step, so no packet falls
+ * between a remove and an add. SSRC and sequence numbers stay, the counters
+ * start over.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_NOT_FOUND if from is not in the table,
+ *         ESP_ERR_INVALID_STATE if to already is.
+ */
+esp_err_t rtp_dest_replace(struct rtp_dest_table* t, const struct sockaddr_in* from, const struct sockaddr_in* to);
+
+/**
+ * Send one RTP packet, given as the header block (starting with the RTP
+ * header) and the data that follows it, to every destination. data may be
+ * NULL when head holds the whole packet. Only packets of the table's own
+ * session are rewritten for destinations with their own SSRC; the RTP
+ * header is restored before returning.
+ *
+ * @return destinations the packet was handed to
+ */
+size_t rtp_dest_send(struct rtp_dest_table* t, uint8_t* head, size_t head_len, const uint8_t* data, size_t data_len);
+
+/**
+ * Send a repair packet (a retransmission or FEC parity) like rtp_dest_send,
+ * skipping the TCP destinations, which cannot lose packets, and the ones
+ * with their own SSRC, which never saw the sequence numbers it refers to.
+ */
+size_t rtp_dest_send_repair(struct rtp_dest_table* t, uint8_t* head, size_t head_len);
+
+/**
+ * A frame of about bytes payload in packets packets follows. TCP
+ * destinations decide here whether they take it whole or skip it whole,
+ * see rtp_tcp_link_begin_frame.
+ */
+void rtp_dest_begin_frame(struct rtp_dest_table* t, size_t bytes, size_t packets);
+
+void rtp_dest_end_frame(struct rtp_dest_table* t);
+
+/** Active destinations, including the ones backing off; 0 means nobody is watching */
+size_t rtp_dest_count(struct rtp_dest_table* t);
+
+/** Destinations currently sent to, at least 1 for pacing purposes */
+size_t rtp_dest_fanout(struct rtp_dest_table* t);
+
+/** Copy out the active destinations, returns how many */
+size_t rtp_dest_list(struct rtp_dest_table* t, struct rtp_dest_addr* out, size_t max);
+
+/**
+ * @return ESP_OK on success,
+ *         ESP_ERR_NOT_FOUND if the address is not in the table.
+ */
+esp_err_t rtp_dest_get_stats(struct rtp_dest_table* t, const struct sockaddr_in* addr, struct rtp_dest_stats* out);
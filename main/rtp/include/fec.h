@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "common.h"
+#include "session.h"
+
+/** RFC 5109 FEC header */
+struct fec_header {
+    uint8_t flags;     // E, L and the P, X, CC recovery bits
+    uint8_t pt_recovery; // M and PT recovery
+    uint16_t sn_base;
+    uint32_t ts_recovery;
+    uint16_t length_recovery;
+} __attribute__((packed));
+
+#define FEC_ULP_HEADER_SIZE 2 // protection length, followed by the mask
+#define FEC_MASK_SIZE_SHORT 2
+#define FEC_MASK_SIZE_LONG 6
+#define FEC_FLAG_LONG_MASK 0x40
+
+#define FEC_MAX_ROW_LENGTH 16
+#define FEC_MAX_SPAN 48 // packets covered by the long mask
+
+/** Extra bytes a parity packet carries over the largest packet it protects */
+#define FEC_OVERHEAD (sizeof(struct fec_header) + FEC_ULP_HEADER_SIZE + FEC_MASK_SIZE_LONG)
+
+/** Running XOR of the packets one parity packet protects */
+struct fec_parity {
+    uint16_t sn_base;
+    uint64_t mask; // bit 47 is sn_base
+    uint8_t count;
+    uint8_t bits[2]; // first two RTP header octets
+    uint32_t ts;
+    uint16_t length;
+    uint16_t protection_length;
+    uint8_t payload[RTP_PACKET_SIZE];
+};
+
+/**
+ * ULPFEC (RFC 5109) encoder for one media stream, level 0 only. Parity is
+ * built over a matrix of row_length x depth packets (SMPTE 2022-1 layout):
+ * one packet per row of row_length consecutive packets and, with depth > 0,
+ * one per column of depth packets spaced row_length apart. Groups are closed
+ * at the end of each frame so a frame never waits for the next one.
+ */
+struct fec_encoder {
+    struct rtp_session* session; // FEC stream, own SSRC and payload type
+    uint8_t row_length;
+    uint8_t depth;
+
+    uint8_t row_index;
+    uint8_t block_index; // packets in the current row_length x depth block
+    uint32_t ready;      // bit 0: row, bit 1 + n: column n
+
+    struct fec_parity* row;
+    struct fec_parity* columns; // row_length entries when depth > 0
+    uint8_t packet[RTP_PACKET_SIZE + FEC_OVERHEAD];
+
+    uint32_t parity_packets;
+};
+
+/**
+ * @param session RTP session the parity packets are numbered in
+ * @param row_length 2..FEC_MAX_ROW_LENGTH
+ * @param depth 0 for row parity only, else 2.. such that the column span fits FEC_MAX_SPAN
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_ARG for an unsupported matrix,
+ *         ESP_ERR_NO_MEM if the accumulators cannot be allocated.
+ */
+esp_err_t fec_encoder_init(struct fec_encoder* e, struct rtp_session* session, uint8_t row_length, uint8_t depth);
+
+/**
+ * Account for a media packet that was just sent. The packet is passed as
+ * the header block (starting with the RTP header) and the data that follows
+ * it, as handed to the socket. Every packet of the stream goes through here,
+ * whether its send succeeded or not, so the protected sequence numbers are
+ * consecutive; a group closed by this packet must be taken out with
+ * fec_encoder_next before the next one is added.
+ */
+void fec_encoder_add(struct fec_encoder* e, const uint8_t* head, size_t head_len, const uint8_t* data,
+                     size_t data_len);
+
+/** Estimated parity bytes for a frame of frame_bytes, used to size the pacing rate */
+size_t fec_encoder_overhead(const struct fec_encoder* e, size_t frame_bytes);
+
+/**
+ * Build the next parity packet that is due, if any.
+ *
+ * @param media_ts media timestamp of the protected frame
+ * @return packet length, 0 when nothing is due; the packet is valid until the next call
+ */
+size_t fec_encoder_next(struct fec_encoder* e, uint32_t media_ts, uint8_t** packet);
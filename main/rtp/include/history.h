@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "common.h"
+
+/** Retransmissions waiting for the sending task */
+#define RTP_HISTORY_PENDING 64
+
+/** A packet is resent at most once per this interval, repeated NACKs within it are ignored */
+#define RTP_HISTORY_RESEND_GAP_US 20000LL
+
+struct rtp_history_stats {
+    uint32_t nacks;        // Generic NACK FCI entries received
+    uint32_t requested;    // sequence numbers asked for
+    uint32_t resent;       // packets retransmitted
+    uint32_t too_late;     // asked for after they left the ring
+    uint32_t deduplicated; // already queued or resent within RTP_HISTORY_RESEND_GAP_US
+    uint32_t dropped;      // pending queue full
+};
+
+struct rtp_history_entry {
+    bool valid;
+    bool queued;
+    uint16_t seq;
+    uint16_t len;
+    int64_t resent_us;
+};
+
+/**
+ * Copies of the last sent packets of one stream for RFC 4585 Generic NACK.
+ * The sending task stores every packet and drains the retransmission queue
+ * between fragments, so retransmissions go through its pacer; the RTCP task
+ * only queues sequence numbers. Packet copies live in one slab of
+ * size * RTP_PACKET_SIZE bytes, in PSRAM when the board has it.
+ */
+struct rtp_history {
+    SemaphoreHandle_t lock;
+    struct rtp_history_entry* entries;
+    uint8_t* slab;
+    size_t size; // a power of two
+
+    uint16_t pending[RTP_HISTORY_PENDING];
+    size_t pending_head;
+    size_t pending_count;
+
+    struct rtp_history_stats stats;
+};
+
+/**
+ * @param size packets kept, rounded up to a power of two; the memory footprint
+ *             is size * (RTP_PACKET_SIZE + 16) bytes after rounding
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_ARG if size is 0,
+ *         ESP_ERR_NO_MEM if the ring cannot be allocated.
+ */
+esp_err_t rtp_history_init(struct rtp_history* h, size_t size);
+
+/**
+ * Store a packet that was just sent, given as the header block (starting with
+ * the RTP header) and the data that follows it. Sending task only.
+ */
+void rtp_history_put(struct rtp_history* h, const uint8_t* head, size_t head_len, const uint8_t* data,
+                     size_t data_len);
+
+/**
+ * Queue a NACKed packet for retransmission: pid plus the bitmask of the
+ * following 16 sequence numbers (RFC 4585 6.2.1). Called by the RTCP task.
+ */
+void rtp_history_request(struct rtp_history* h, uint16_t pid, uint16_t blp);
+
+/**
+ * Copy the next packet to retransmit into out (RTP_PACKET_SIZE bytes).
+ * Sending task only.
+ *
+ * @return packet length, 0 when nothing is queued
+ */
+size_t rtp_history_next(struct rtp_history* h, uint8_t* out);
+
+void rtp_history_get_stats(struct rtp_history* h, struct rtp_history_stats* out);
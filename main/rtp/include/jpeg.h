@@ -4,13 +4,28 @@
 #include "esp_log.h"
 
 #include "common.h"
-
-#define MAX_QUANT_TABLES 4
-#define QUANT_TABLE_SIZE 64
+#include "dest.h"
+#include "fec.h"
+#include "history.h"
+#include "jpeg_frame.h"
+#include "jpeg_quant.h"
+#include "pacer.h"
+#include "session.h"
 
 #define JPEG_TYPE_YUV422 0U
+#define JPEG_TYPE_YUV420 1U
+#define JPEG_TYPE_RESTART 64U // added to the type when a restart marker header follows
 #define JPEG_Q_DEFAULT 255U
 
+/** Width and height travel as 8-pixel blocks in one byte each */
+#define JPEG_MAX_DIMENSION (255U * 8U)
+
+#define JPEG_RESTART_FIRST 0x8000U
+#define JPEG_RESTART_LAST 0x4000U
+#define JPEG_RESTART_COUNT_MASK 0x3FFFU
+/** Count value that asks for the whole frame, only with F and L set; interval counts wrap before it */
+#define JPEG_RESTART_COUNT_WHOLE_FRAME 0x3FFFU
+
 struct rtp_jpeg_header {
     uint8_t type_specific;
     uint8_t fragment_offset[3];
@@ -20,10 +35,41 @@ struct rtp_jpeg_header {
     uint8_t height;
 } __attribute__((packed));
 
+struct rtp_jpeg_restart_header {
+    uint16_t interval;
+    uint16_t count; // F, L and Restart Count
+} __attribute__((packed));
+
 struct jpeg_quant_header {
     uint8_t mbz;
     uint8_t precision;
     uint16_t length;
 } __attribute__((packed));
 
-void rtp_send_jpeg_packets(int sock, const struct sockaddr_in* to, uint8_t* buf, const camera_fb_t* fb);
\ No newline at end of file
+/**
+ * Fragment and send one frame to every destination in dests. buf holds the RTP/JPEG headers (and the payload
+ * copy when CONFIG_ESPRTP_JPEG_ZERO_COPY is off); fb must not be returned to
+ * the camera driver before this function returns. Sequence numbers continue
+ * from the session, fragments are released through the pacer. With fec set,
+ * fragments are shortened to leave room for the FEC headers and the parity
+ * packets are sent to the same destinations as soon as their group is complete.
+ * With history set, every fragment is kept for retransmission and NACKed
+ * packets are resent between fragments.
+ */
+void rtp_send_jpeg_packets(struct rtp_dest_table* dests, uint8_t* buf, const camera_fb_t* fb,
+                           struct rtp_session* session, struct pacer* pacer, struct fec_encoder* fec,
+                           struct rtp_history* history);
+
+/** Send the retransmissions queued in history through the pacer, for the idle time between frames */
+void rtp_jpeg_resend(struct rtp_dest_table* dests, struct rtp_history* history, struct pacer* pacer);
+
+/**
+ * Change the path MTU used to size JPEG fragments. Takes effect from the next frame.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_ARG if mtu is outside RTP_MIN_MTU..RTP_MAX_MTU.
+ */
+esp_err_t rtp_jpeg_set_mtu(size_t mtu);
+
+/** Largest UDP payload (RTP packet) a fragment may occupy with the current MTU */
+size_t rtp_jpeg_get_max_packet_size(void);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define MAX_QUANT_TABLES 4
+#define QUANT_TABLE_SIZE 64
+
+#define JPEG_MAX_COMPONENTS 3
+
+/** JPEG markers used by the indexer */
+#define JPEG_MARKER_SOF0 0xC0
+#define JPEG_MARKER_SOF1 0xC1
+#define JPEG_MARKER_DHT 0xC4
+#define JPEG_MARKER_RST0 0xD0
+#define JPEG_MARKER_RST7 0xD7
+#define JPEG_MARKER_SOI 0xD8
+#define JPEG_MARKER_EOI 0xD9
+#define JPEG_MARKER_SOS 0xDA
+#define JPEG_MARKER_DQT 0xDB
+#define JPEG_MARKER_DRI 0xDD
+
+struct jpeg_component {
+    uint8_t id;
+    uint8_t h; // horizontal sampling factor
+    uint8_t v; // vertical sampling factor
+    uint8_t tq;
+};
+
+/**
+ * Frame descriptor produced by jpeg_frame_index().
+ * All pointers reference the indexed buffer, nothing is copied.
+ */
+struct jpeg_frame {
+    uint16_t width;
+    uint16_t height;
+    uint8_t components;
+    struct jpeg_component component[JPEG_MAX_COMPONENTS];
+
+    const uint8_t* quant_tables[MAX_QUANT_TABLES]; // 8-bit tables in order of appearance
+    size_t quant_tables_count;
+
+    uint16_t restart_interval; // DRI, 0 if absent
+
+    const uint8_t* scan; // entropy-coded data right after the SOS header
+    size_t scan_len;     // up to (not including) EOI
+};
+
+/**
+ * Index a baseline JFIF frame in a single pass.
+ *
+ * Header segments are skipped by their length fields, the EOI marker is
+ * located by scanning backward from the end of the buffer, so the
+ * entropy-coded data is never touched.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_ARG if buf or frame is NULL,
+ *         ESP_ERR_INVALID_SIZE if a segment runs past the end of the buffer,
+ *         ESP_ERR_INVALID_STATE if the marker structure is broken,
+ *         ESP_ERR_NOT_SUPPORTED for non-baseline frames,
+ *         ESP_ERR_NOT_FOUND if SOS or EOI is missing.
+ */
+esp_err_t jpeg_frame_index(const uint8_t* buf, size_t len, struct jpeg_frame* frame);
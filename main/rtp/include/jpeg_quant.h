@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jpeg_frame.h"
+
+/** RFC 2435 Q values 1..99 select the scaled IJG tables, 128..255 mean in-band tables */
+#define JPEG_Q_STANDARD_MIN 1U
+#define JPEG_Q_STANDARD_MAX 99U
+
+/**
+ * Remembers the outcome of the last comparison so frames with unchanged
+ * tables cost one compare instead of a search over all Q values.
+ */
+struct jpeg_quant_cache {
+    uint8_t tables[2][QUANT_TABLE_SIZE]; // luma and chroma last searched
+    uint8_t q;                           // 0 if the tables are not standard
+    bool valid;
+};
+
+/**
+ * Build the RFC 2435 tables for Q 1..99, in zigzag order as stored in DQT.
+ */
+void jpeg_quant_make_tables(uint8_t q, uint8_t luma[QUANT_TABLE_SIZE], uint8_t chroma[QUANT_TABLE_SIZE]);
+
+/**
+ * Return the Q 1..99 whose RFC 2435 tables equal the given luma/chroma pair,
+ * or 0 if they do not match any of them.
+ */
+uint8_t jpeg_quant_detect(struct jpeg_quant_cache* cache, const uint8_t* const* tables, size_t count);
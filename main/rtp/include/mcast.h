@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#include "common.h"
+
+#define RTP_MULTICAST_ADDRESS CONFIG_ESPRTP_MULTICAST_ADDR
+#define RTP_MULTICAST_TTL CONFIG_ESPRTP_MULTICAST_TTL
+
+/**
+ * Set IP_MULTICAST_TTL, IP_MULTICAST_IF and IP_MULTICAST_LOOP on a sending
+ * socket from the Kconfig options. Unicast sends are not affected, so every
+ * RTP and RTCP socket gets them and the mode can change at runtime.
+ *
+ * @return ESP_OK on success,
+ *         ESP_FAIL if the stack rejects an option (lwIP without IGMP).
+ */
+esp_err_t rtp_multicast_socket_init(int sock);
+
+/**
+ * Parse CONFIG_ESPRTP_MULTICAST_ADDR.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_ARG if it is not an IPv4 multicast address.
+ */
+esp_err_t rtp_multicast_group(struct in_addr* out);
+
+/** Address multicast leaves from, INADDR_ANY when it is not known yet */
+struct in_addr rtp_multicast_interface(void);
+
+static inline bool rtp_is_multicast(const struct in_addr* addr) {
+    return IN_MULTICAST(ntohl(addr->s_addr));
+}
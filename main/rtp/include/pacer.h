@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+struct pacer_stats {
+    uint32_t packets;
+    uint64_t bytes;
+    uint64_t wait_us;  // total time spent waiting for tokens
+    uint32_t rate_bps; // achieved rate since pacer_init
+    uint32_t fps;      // frame rate frames are spread over now
+};
+
+/**
+ * Token-bucket pacer. Tokens are kept in micro-bytes (bytes * 1e6) so the
+ * refill is exact at microsecond resolution.
+ */
+struct pacer {
+    uint32_t max_rate; // bytes per second
+    uint32_t rate;     // bytes per second for the current frame
+    uint32_t fps;
+    int64_t burst;  // micro-bytes
+    int64_t tokens; // micro-bytes
+    int64_t last_us;
+    int64_t start_us;
+    esp_timer_handle_t timer; // one-shot that ends a wait
+    SemaphoreHandle_t wake;   // given by timer
+    struct pacer_stats stats;
+};
+
+/**
+ * @param bitrate_kbps upper bound for the sending rate
+ * @param burst_bytes bucket depth, sent back to back when the link was idle
+ * @param fps frame rate used to spread each frame over one frame interval, 0 disables spreading
+ * @return ESP_OK on success,
+ *         ESP_ERR_NO_MEM if the wait timer or its semaphore cannot be allocated.
+ */
+esp_err_t pacer_init(struct pacer* p, uint32_t bitrate_kbps, size_t burst_bytes, uint32_t fps);
+
+/** Free the wait timer, no pacer_wait may be running */
+void pacer_deinit(struct pacer* p);
+
+/**
+ * Set the rate for the next frame so its fragments are spread evenly over one
+ * frame interval, never faster than the configured bitrate. frame_bytes is
+ * what pacer_wait will be charged for the frame, headers included.
+ */
+void pacer_begin_frame(struct pacer* p, size_t frame_bytes);
+
+/** Change the frame rate used for spreading, safe to call from another task */
+void pacer_set_fps(struct pacer* p, uint32_t fps);
+
+/**
+ * Take tokens for a packet of the given size and return the time (esp_timer
+ * microseconds) at which it may leave. Does not sleep.
+ */
+int64_t pacer_schedule(struct pacer* p, size_t bytes, int64_t now_us);
+
+/**
+ * Block until a packet of the given size may be sent. The task sleeps on an
+ * esp_timer one-shot, so waits shorter than a tick leave the CPU to the
+ * other tasks too.
+ */
+void pacer_wait(struct pacer* p, size_t bytes);
+
+void pacer_get_stats(const struct pacer* p, struct pacer_stats* out);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "esp_err.h"
+
+/**
+ * Start the quality ladder task. Every period it feeds receiver loss, frame
+ * queue drops and pacer throughput to the rate controller and applies the
+ * resulting (frame size, JPEG quality, fps cap) step to the sensor.
+ *
+ * The camera must be initialized; the ladder never goes above the frame
+ * size the frame buffers were allocated for.
+ */
+esp_err_t quality_start(void);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** One measurement period of the video stream */
+struct ratectl_sample {
+    bool feedback;           // a receiver report arrived during the period
+    uint8_t fraction_lost;   // from it, x/256
+    uint32_t frames_queued;  // frames handed to the sender during the period
+    uint32_t frames_dropped; // frames replaced in the queue during the period
+    uint32_t achieved_bps;   // pacer output during the period
+    uint32_t capacity_bps;   // pacer bitrate cap
+};
+
+struct ratectl_config {
+    uint8_t loss_down;      // step down above this fraction lost (x/256)
+    uint8_t loss_up;        // allow stepping up at or below this fraction lost
+    uint8_t drop_down_pct;  // step down when this share of frames is dropped in the queue
+    uint8_t headroom_pct;   // step up only while the pacer uses less than this share of its cap
+    uint32_t up_hold;       // clean periods required before stepping up
+    uint32_t up_hold_max;   // cap for the backoff after a failed step up
+    size_t min_level;       // best level the stream may use
+    size_t max_level;       // worst level
+};
+
+/**
+ * Quality ladder controller. Level 0 is the best step of the ladder, the
+ * caller maps levels to (frame size, quality, fps) and applies them.
+ *
+ * Congestion steps down immediately. Stepping up needs up_hold clean periods;
+ * a step up that is followed by congestion within the next hold doubles the
+ * hold, one that survives it halves the hold again. The controller settles
+ * below a link it cannot sustain and still follows a link that recovers.
+ * A period without receiver feedback holds the level: nothing tells whether
+ * the receiver still gets the stream, so it never counts as clean.
+ */
+struct ratectl {
+    struct ratectl_config cfg;
+    size_t level;
+    uint32_t hold;          // current clean periods required to step up
+    uint32_t clean_periods;
+    uint32_t since_up;      // periods since a step up still on probation, UINT32_MAX if none
+};
+
+void ratectl_init(struct ratectl* rc, const struct ratectl_config* cfg, size_t start_level);
+
+/** Feed one period and return the level to use next */
+size_t ratectl_update(struct ratectl* rc, const struct ratectl_sample* sample);
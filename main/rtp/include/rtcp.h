@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "common.h"
+#include "dest.h"
+#include "history.h"
+#include "session.h"
+
+#define RTCP_VERSION 0x80
+
+/** RTCP packet types */
+#define RTCP_SR 200
+#define RTCP_RR 201
+#define RTCP_SDES 202
+#define RTCP_BYE 203
+#define RTCP_RTPFB 205 // transport layer feedback (RFC 4585)
+
+/** RTPFB feedback message types, carried in the RC field */
+#define RTCP_FB_NACK 1
+
+#define RTCP_SDES_END 0
+#define RTCP_SDES_CNAME 1
+
+#define RTCP_MAX_STREAMS 2
+#define RTCP_PACKET_SIZE 256
+
+/** Offset between the NTP (1900) and Unix (1970) epochs, seconds */
+#define RTCP_NTP_UNIX_OFFSET 2208988800UL
+
+struct rtcp_header {
+    uint8_t version; // V, P and RC/SC
+    uint8_t type;
+    uint16_t length; // in 32-bit words minus one
+} __attribute__((packed));
+
+struct rtcp_sender_info {
+    uint32_t ssrc;
+    uint32_t ntp_sec;
+    uint32_t ntp_frac;
+    uint32_t rtp_ts;
+    uint32_t packets;
+    uint32_t octets;
+} __attribute__((packed));
+
+/** Generic NACK FCI entry: lost packet id plus a bitmask of the next 16 */
+struct rtcp_nack {
+    uint16_t pid;
+    uint16_t blp;
+} __attribute__((packed));
+
+struct rtcp_report_block {
+    uint32_t ssrc;
+    uint32_t lost;         // fraction lost (8 bits) and cumulative lost (24 bits)
+    uint32_t highest_seq;  // extended highest sequence number received
+    uint32_t jitter;
+    uint32_t lsr;          // last SR timestamp
+    uint32_t dlsr;         // delay since last SR, 1/65536 s
+} __attribute__((packed));
+
+/** Reception quality of one of our streams as reported by the far end */
+struct rtcp_stream_stats {
+    uint32_t reporter_ssrc;
+    uint8_t fraction_lost; // fraction of 256 lost since the previous report
+    int32_t cumulative_lost;
+    uint32_t highest_seq;
+    uint32_t jitter;  // RTP timestamp units
+    uint32_t rtt_us;  // 0 until a report echoes one of our SRs
+    uint32_t reports; // receiver reports processed
+    uint32_t sender_reports; // sender reports we sent
+    int64_t last_report_us;
+};
+
+/**
+ * Register an RTP stream. Sender reports go to rtp_to's port + 1, receiver
+ * reports are accepted on local port rtp_port + 1, or on an ephemeral port
+ * when that one is taken (sender and receiver on one host).
+ *
+ * @param session_bw_bps session bandwidth used for the RFC 3550 report interval
+ * @return ESP_OK on success,
+ *         ESP_ERR_NO_MEM if all RTCP_MAX_STREAMS slots are taken,
+ *         ESP_FAIL if the socket cannot be created or bound.
+ */
+esp_err_t rtcp_add_stream(const struct rtp_session* session, const struct sockaddr_in* rtp_to,
+                          uint32_t session_bw_bps);
+
+/**
+ * Answer Generic NACKs for a registered stream from history. Call before rtcp_start.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_NOT_FOUND if no stream has this SSRC.
+ */
+esp_err_t rtcp_set_history(uint32_t ssrc, struct rtp_history* history);
+
+/**
+ * Send the sender reports of a registered stream to port + 1 of every
+ * destination in dests instead of the address given to rtcp_add_stream,
+ * under the SSRC each destination sees. Call before rtcp_start.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_NOT_FOUND if no stream has this SSRC.
+ */
+esp_err_t rtcp_set_destinations(uint32_t ssrc, struct rtp_dest_table* dests);
+
+/**
+ * Process a compound packet that did not arrive on an RTCP socket, e.g.
+ * interleaved on an RTSP connection. Safe to call from another task.
+ */
+void rtcp_handle_packet(const uint8_t* buf, size_t len);
+
+/** Source address of a packet with a sender or receiver report */
+typedef void (*rtcp_report_cb)(const struct sockaddr_in* from);
+
+/**
+ * Have the RTCP task call cb for every report that arrives on an RTCP socket,
+ * e.g. to keep the session of the client that sent it alive. Can be set at
+ * any time, NULL turns it off; cb runs on the RTCP task and must not block.
+ */
+void rtcp_set_report_callback(rtcp_report_cb cb);
+
+/** Start the RTCP task for the registered streams */
+esp_err_t rtcp_start(void);
+
+/**
+ * @return ESP_OK on success,
+ *         ESP_ERR_NOT_FOUND if no stream has this SSRC.
+ */
+esp_err_t rtcp_get_stats(uint32_t ssrc, struct rtcp_stream_stats* out);
@@ -1,3 +1,106 @@
 #pragma once
 
-void rtp_init(void);
\ No newline at end of file
+#include "esp_err.h"
+
+#include "dest.h"
+#include "history.h"
+#include "pacer.h"
+#include "sdp.h"
+
+/** Where both streams and their sender reports go */
+enum rtp_transport {
+    RTP_TRANSPORT_UNICAST,   // CONFIG_ESPRTP_IPV4_ADDR
+    RTP_TRANSPORT_MULTICAST, // CONFIG_ESPRTP_MULTICAST_ADDR
+};
+
+/** Frame counters of the capture -> transmit queue */
+struct rtp_video_stats {
+    uint32_t queued;  // frames handed over by the capture task
+    uint32_t dropped; // queued frames replaced by a newer one before they were sent
+    uint32_t sent;
+};
+
+void rtp_init(void);
+
+void rtp_get_video_stats(struct rtp_video_stats* out);
+
+/** Limit the capture rate (and pacer spreading) to fps, 0 removes the limit */
+void rtp_set_video_fps_cap(uint32_t fps);
+
+/**
+ * Move the configured destination of the audio and video streams between
+ * the unicast address and the multicast group. Receivers added with
+ * rtp_video_add_destination() are kept. Logs the new SDP.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_ARG if CONFIG_ESPRTP_MULTICAST_ADDR is not a multicast group.
+ */
+esp_err_t rtp_set_transport(enum rtp_transport transport);
+
+enum rtp_transport rtp_get_transport(void);
+
+/**
+ * SDP describing the streams for the current transport, e.g. for a player
+ * or a DESCRIBE. The o= version changes with every switch.
+ *
+ * @return length of the full description, like snprintf
+ */
+int rtp_get_sdp(char* buf, size_t size);
+
+/** The live configuration as an SDP description, for rtp_get_sdp() and RTSP DESCRIBE */
+void rtp_get_sdp_desc(struct sdp_desc* out);
+
+/**
+ * Send the video to one more receiver. Every fragment is still built once.
+ *
+ * @param own_ssrc give the receiver its own SSRC and sequence numbers; it then gets
+ *                 sender reports under that SSRC but no NACK or FEC repair
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_STATE if the address is already a destination,
+ *         ESP_ERR_NO_MEM if CONFIG_ESPRTP_MAX_DESTINATIONS are in use.
+ */
+esp_err_t rtp_video_add_destination(const struct sockaddr_in* addr, bool own_ssrc);
+
+/**
+ * @return ESP_OK on success,
+ *         ESP_ERR_NOT_FOUND if the address is not a destination.
+ */
+esp_err_t rtp_video_remove_destination(const struct sockaddr_in* addr);
+
+/**
+ * Send the audio to one more receiver, always under the stream's SSRC.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_STATE if the address is already a destination,
+ *         ESP_ERR_NO_MEM if CONFIG_ESPRTP_MAX_DESTINATIONS are in use.
+ */
+esp_err_t rtp_audio_add_destination(const struct sockaddr_in* addr);
+
+/**
+ * @return ESP_OK on success,
+ *         ESP_ERR_NOT_FOUND if the address is not a destination.
+ */
+esp_err_t rtp_audio_remove_destination(const struct sockaddr_in* addr);
+
+/**
+ * Send the video or the audio interleaved on an RTSP connection, under the
+ * stream's SSRC; addr identifies the destination for the remove functions.
+ *
+ * @return as rtp_video_add_destination
+ */
+esp_err_t rtp_video_add_interleaved(const struct sockaddr_in* addr, struct rtp_tcp_link* link, uint8_t channel);
+esp_err_t rtp_audio_add_interleaved(const struct sockaddr_in* addr, struct rtp_tcp_link* link, uint8_t channel);
+
+/** Packets, bytes and send errors of one video destination */
+esp_err_t rtp_get_video_destination_stats(const struct sockaddr_in* addr, struct rtp_dest_stats* out);
+
+/**
+ * NACK and retransmission counters of the video stream.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_INVALID_STATE if CONFIG_ESPRTP_NACK is off or the history could not be allocated.
+ */
+esp_err_t rtp_get_video_history_stats(struct rtp_history_stats* out);
+
+/** Achieved rate and wait counters of the video pacer */
+void rtp_get_video_pacer_stats(struct pacer_stats* out);
\ No newline at end of file
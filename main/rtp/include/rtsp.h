@@ -0,0 +1,31 @@
+#pragma once
+
+#include "esp_err.h"
+
+#include "common.h"
+#include "tcp.h"
+
+#define RTSP_PORT CONFIG_ESPRTP_RTSP_PORT
+#define RTSP_MAX_SESSIONS CONFIG_ESPRTP_RTSP_MAX_SESSIONS
+#define RTSP_TIMEOUT_S CONFIG_ESPRTP_RTSP_TIMEOUT
+
+/**
+ * Listen for RTSP/1.0 clients (RFC 2326) and serve the running streams:
+ * DESCRIBE returns the live SDP, SETUP takes UDP unicast client ports or,
+ * with CONFIG_ESPRTP_RTSP_TCP, interleaved channels on the RTSP connection
+ * itself, and PLAY adds the client to the stream destinations until TEARDOWN, the
+ * connection closing or RTSP_TIMEOUT_S without a request or an RTCP report
+ * from the client. A session lives on the connection that created it.
+ *
+ * @return ESP_OK on success,
+ *         ESP_FAIL if the listening socket cannot be set up,
+ *         ESP_ERR_NO_MEM if the task cannot be created.
+ */
+esp_err_t rtsp_start(void);
+
+/**
+ * Interleaved (RTP over TCP) counters since start, summed over the
+ * connections: depth is what the queues hold right now, max_depth the
+ * deepest any of them got.
+ */
+void rtsp_get_tcp_stats(struct rtp_tcp_stats* out);
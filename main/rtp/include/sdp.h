@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/** RTSP control URLs of the media, relative to the DESCRIBE URL */
+#define SDP_VIDEO_TRACK 0
+#define SDP_AUDIO_TRACK 1
+
+/** What an SDP session description (RFC 4566) announces about the streams */
+struct sdp_desc {
+    uint32_t session_id;
+    uint32_t version;         // bumped whenever the description changes
+    struct in_addr origin;    // the sender's own address
+    struct in_addr connection;
+    uint8_t ttl;              // carried with a multicast connection address
+    in_port_t video_port;     // 0 when there is no video
+    in_port_t audio_port;     // 0 when there is no audio
+    uint8_t fec_pt;           // ULPFEC payload type, 0 without FEC
+    bool nack;                // RTP/AVPF with Generic NACK feedback
+    bool control;             // a=control:trackID=N lines for RTSP
+};
+
+/**
+ * Write the description of the JPEG and PCMU streams, as in stream.sdp.
+ *
+ * @return length of the full description, like snprintf; the output was
+ *         truncated if it is not below size
+ */
+int sdp_write(char* buf, size_t size, const struct sdp_desc* d);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/**
+ * Per-stream RTP sender state (RFC 3550 section 5.1), kept for the life of
+ * the stream so sequence numbers stay continuous across frames.
+ */
+struct rtp_session {
+    uint32_t ssrc;
+    uint8_t payload_type;
+    uint32_t clock_rate;
+
+    uint16_t seq;    // next sequence number
+    uint32_t cycles; // sequence number wraparounds, shifted left by 16
+    uint32_t ts_base;
+    uint32_t last_ts; // RTP timestamp of the last packet
+
+    uint32_t packets; // sender's packet count
+    uint32_t octets;  // sender's payload octet count
+
+    // media timestamp <-> esp_timer pair used to place sender reports, guarded by clock_seq
+    uint32_t clock_seq;
+    uint32_t ref_ts;
+    int64_t ref_time_us;
+};
+
+/**
+ * @param initial_seq random initial sequence number
+ * @param ts_base random offset added to every media timestamp
+ */
+void rtp_session_init(struct rtp_session* s, uint32_t ssrc, uint8_t payload_type, uint32_t clock_rate,
+                      uint16_t initial_seq, uint32_t ts_base);
+
+/**
+ * Fill an RTP header for the next packet and advance the sequence number.
+ *
+ * @param media_ts timestamp in clock_rate units, ts_base is added here
+ */
+void rtp_session_write_header(struct rtp_session* s, struct rtp_header* h, uint32_t media_ts, bool marker);
+
+/** Account a packet that left the socket, payload_bytes excludes the RTP header */
+void rtp_session_on_sent(struct rtp_session* s, size_t payload_bytes);
+
+/** Extended highest sequence number sent so far (cycles + seq) */
+uint32_t rtp_session_extended_seq(const struct rtp_session* s);
+
+/**
+ * Record that media_ts was sampled at time_us (esp_timer clock). Called by
+ * the sending task, may be read concurrently by rtp_session_timestamp_at.
+ */
+void rtp_session_set_clock(struct rtp_session* s, uint32_t media_ts, int64_t time_us);
+
+/**
+ * RTP timestamp (including ts_base) that corresponds to time_us, extrapolated
+ * from the last rtp_session_set_clock call at clock_rate.
+ *
+ * @return false if no reference has been recorded yet
+ */
+bool rtp_session_timestamp_at(const struct rtp_session* s, int64_t time_us, uint32_t* rtp_ts);
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "common.h"
+
+#define RTP_TCP_QUEUE_SIZE CONFIG_ESPRTP_RTSP_TCP_QUEUE_SIZE
+
+/** '$', channel and a 16-bit length in front of every packet (RFC 2326 10.12) */
+#define RTP_TCP_FRAMING 4
+
+/** Audio, RTCP and RTSP writes queued between the packets of one frame that a take-back keeps */
+#define RTP_TCP_MAX_INTERLEAVED 16
+
+struct rtp_tcp_stats {
+    uint32_t packets;         // framed packets queued
+    uint64_t bytes;           // bytes the socket accepted
+    uint32_t frames;          // video frames queued whole
+    uint32_t frames_dropped;  // video frames skipped whole because the queue was backed up
+    uint32_t frames_cut;      // frames that outgrew their admission and could not be taken back
+    uint32_t packets_dropped; // audio and RTCP packets that did not fit
+    size_t depth;             // bytes waiting for the socket right now
+    size_t max_depth;
+};
+
+/**
+ * RTP and RTCP interleaved on a TCP connection, with a bounded send queue in
+ * front of the socket. Senders never block on it: a video frame is either
+ * queued whole or skipped whole, decided when the frame starts, so a slow
+ * connection costs frames, never a frame with holes. RTSP responses on the
+ * same connection go through the queue too, so they never land in the
+ * middle of a packet.
+ */
+struct rtp_tcp_link {
+    SemaphoreHandle_t lock;
+    int sock; // -1 while closed
+    uint8_t* buf;
+    size_t size;
+    size_t head; // next byte for the socket
+    size_t len;  // queued bytes
+    bool in_frame;
+    bool dropping;        // the rest of the current frame is skipped
+    size_t reserved;      // room held for the rest of the current frame
+    uint64_t frame_start; // queued_total when the current frame was admitted
+    size_t interleaved;   // other writes queued since, RTP_TCP_MAX_INTERLEAVED + 1 once they no longer fit
+    struct {
+        uint64_t at; // queued_total before the write
+        size_t len;
+    } interleaved_at[RTP_TCP_MAX_INTERLEAVED];
+    uint64_t queued_total;
+    uint64_t sent_total;
+    struct rtp_tcp_stats stats;
+};
+
+/**
+ * Allocate the queue, in PSRAM when there is some. The link starts closed.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_NO_MEM if the queue or its lock cannot be allocated.
+ */
+esp_err_t rtp_tcp_link_init(struct rtp_tcp_link* l, size_t size);
+
+/** Start carrying packets on a connected socket, with TCP_NODELAY set and the counters reset */
+void rtp_tcp_link_open(struct rtp_tcp_link* l, int sock);
+
+/** Forget the queued bytes and stop taking packets; the socket is not closed */
+void rtp_tcp_link_close(struct rtp_tcp_link* l);
+
+bool rtp_tcp_link_is_open(struct rtp_tcp_link* l);
+
+/**
+ * A video frame of at most bytes, in at most packets packets, starts. It is
+ * admitted if the queue has room for all of it now; otherwise every packet
+ * of it is dropped until rtp_tcp_link_end_frame. The room stays held for
+ * the frame, so an upper bound here guarantees the frame goes out whole.
+ * Should the frame outgrow it anyway before any of it was sent, its packets
+ * are taken back out of the queue, keeping whatever else was written
+ * between them.
+ */
+void rtp_tcp_link_begin_frame(struct rtp_tcp_link* l, size_t bytes, size_t packets);
+
+void rtp_tcp_link_end_frame(struct rtp_tcp_link* l);
+
+/**
+ * Queue one packet on channel and send what the socket takes. Packets of the
+ * current frame (frame set) use the room admitted for it, the others only
+ * what is left over.
+ *
+ * @return ESP_OK on success,
+ *         ESP_ERR_NO_MEM if the packet was dropped for lack of room,
+ *         ESP_ERR_INVALID_STATE if the link is closed,
+ *         ESP_FAIL if the socket failed.
+ */
+esp_err_t rtp_tcp_link_put(struct rtp_tcp_link* l, uint8_t channel, const uint8_t* head, size_t head_len,
+                           const uint8_t* data, size_t data_len, bool frame);
+
+/**
+ * Queue bytes that are not a packet, e.g. an RTSP response.
+ *
+ * @return as rtp_tcp_link_put
+ */
+esp_err_t rtp_tcp_link_write(struct rtp_tcp_link* l, const void* data, size_t len);
+
+/**
+ * Send queued bytes until the socket would block.
+ *
+ * @return ESP_OK on success, even if bytes are left,
+ *         ESP_FAIL if the socket failed.
+ */
+esp_err_t rtp_tcp_link_flush(struct rtp_tcp_link* l);
+
+/** Queued bytes, 0 for a closed link */
+size_t rtp_tcp_link_pending(struct rtp_tcp_link* l);
+
+void rtp_tcp_link_get_stats(struct rtp_tcp_link* l, struct rtp_tcp_stats* out);
@@ -2,6 +2,27 @@
 
 static const char* const TAG = "rtp_jpeg_sender";
 
+static struct jpeg_quant_cache s_quant_cache;
+
+static size_t s_max_packet_size = RTP_PATH_MTU - RTP_IP_UDP_OVERHEAD;
+
+DRAM_ATTR static uint8_t s_resend_packet[RTP_PACKET_SIZE];
+
+esp_err_t rtp_jpeg_set_mtu(size_t mtu) {
+    if (unlikely(mtu < RTP_MIN_MTU || mtu > RTP_MAX_MTU)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    __atomic_store_n(&s_max_packet_size, mtu - RTP_IP_UDP_OVERHEAD, __ATOMIC_RELAXED);
+    ESP_LOGI(TAG, "path MTU %zu, max RTP packet %zu", mtu, mtu - RTP_IP_UDP_OVERHEAD);
+
+    return ESP_OK;
+}
+
+size_t rtp_jpeg_get_max_packet_size(void) {
+    return __atomic_load_n(&s_max_packet_size, __ATOMIC_RELAXED);
+}
+
 static inline void set_fragment_offset(uint8_t* buf, const size_t offset) {
     buf[0] = (offset >> 16) & 0xFF;
     buf[1] = (offset >> 8) & 0xFF;
@@ -12,163 +33,208 @@ static inline size_t min(size_t a, size_t b) {
     return (a < b) ? a : b;
 }
 
-static const uint8_t* get_jpeg_data(const uint8_t* buf, size_t size, size_t* out_size) {
-    if (unlikely(!buf || !out_size || size < 4)) {
-        if (out_size)
-            *out_size = 0;
-        return NULL;
-    }
-
-    // Найти FF DA (SOS)
-    size_t pos = 0;
-    while (pos < size - 1) {
-        if (buf[pos] == 0xFF && buf[pos + 1] == 0xDA) {
-            break;
-        }
-        pos++;
-    }
-    if (pos >= size - 1) {
-        *out_size = 0;
-        return NULL; // SOS не найден
-    }
-
-    // Пропустить FF DA
-    pos += 2;
-
-    // Прочитать длину SOS-сегмента (2 байта, big-endian)
-    if (pos + 2 > size) {
-        *out_size = 0;
-        return NULL;
+/**
+ * Map SOF sampling factors to the RFC 2435 type: Y 2x1 / 2x2 with 1x1 chroma.
+ */
+static esp_err_t jpeg_type_from_frame(const struct jpeg_frame* frame, uint8_t* type) {
+    if (unlikely(frame->components != 3)) {
+        return ESP_ERR_NOT_SUPPORTED;
     }
-    uint16_t sos_length = (buf[pos] << 8) | buf[pos + 1];
-    pos += 2;
 
-    // Пропустить параметры SOS (sos_length - 2, поскольку длина включает себя)
-    if (sos_length < 2 || pos + (sos_length - 2) > size) {
-        *out_size = 0;
-        return NULL;
+    const struct jpeg_component* c = frame->component;
+    if (unlikely(c[1].h != 1 || c[1].v != 1 || c[2].h != 1 || c[2].v != 1 || c[0].h != 2)) {
+        return ESP_ERR_NOT_SUPPORTED;
     }
-    pos += (sos_length - 2);
-
-    // Теперь pos указывает на начало сжатых данных
-    size_t data_start = pos;
 
-    // Найти FF D9 (EOI)
-    while (pos < size - 1) {
-        if (buf[pos] == 0xFF && buf[pos + 1] == 0xD9) {
-            break;
-        }
-        pos++;
-    }
-    if (pos >= size - 1) {
-        *out_size = 0;
-        return NULL; // EOI не найден
+    switch (c[0].v) {
+    case 1:
+        *type = JPEG_TYPE_YUV422;
+        return ESP_OK;
+    case 2:
+        *type = JPEG_TYPE_YUV420;
+        return ESP_OK;
+    default:
+        return ESP_ERR_NOT_SUPPORTED;
     }
-
-    *out_size = pos - data_start;
-    return buf + data_start;
 }
 
-static size_t extract_quant_tables_refs(const uint8_t* buf, size_t size, const uint8_t** tables) {
-    if (unlikely((buf == NULL) || (tables == NULL))) {
-        return 0;
-    }
-
-    size_t pos = 0;
-    size_t count = 0;
-
-    while ((pos + 4) <= size) {
-        if ((buf[pos] == 0xFF) && (buf[pos + 1] == 0xDB)) {
-            pos += 2;
-
-            /* Read DQT segment length */
-            if ((pos + 2) > size) {
+/**
+ * Find the last restart interval boundary (the byte after an RSTn marker) in
+ * data[start, limit), or the first one when first_only. Returns the chunk
+ * length up to that boundary, or 0 if the window holds no marker, and the
+ * number of intervals it completes.
+ */
+static size_t restart_aligned_chunk(const uint8_t* data, size_t start, size_t limit, bool first_only,
+                                    uint32_t* intervals) {
+    size_t cut = start;
+    uint32_t count = 0;
+
+    for (size_t pos = start; pos + 1 < limit; pos++) {
+        // stuffed 0xFF bytes are followed by 0x00, so FF Dx is always a marker
+        if (unlikely(data[pos] == 0xFF && (data[pos + 1] & 0xF8) == 0xD0)) {
+            pos++;
+            cut = pos + 1;
+            count++;
+            if (first_only) {
                 break;
             }
+        }
+    }
 
-            uint16_t seg_len = ((uint16_t)buf[pos] << 8) | (uint16_t)buf[pos + 1];
-            pos += 2;
-
-            if ((seg_len < 2) || ((pos + seg_len - 2) > size)) {
-                break; /* invalid segment */
-            }
-
-            size_t seg_end = pos + (size_t)seg_len - 2;
+    *intervals = count;
+    return cut - start;
+}
 
-            /* Parse all tables inside this DQT segment */
-            while ((pos < seg_end) && (count < MAX_QUANT_TABLES)) {
-                uint8_t table_info = buf[pos++];
-                uint8_t table_id = table_info & 0x0F;
-                uint8_t precision = (table_info >> 4) & 0x0F;
+/**
+ * Upper bound of the fragments for bytes of payload when no fragment may
+ * carry more than window bytes. Cut on restart boundaries, a fragment can
+ * be short: one that starts an interval ends on the last boundary of its
+ * window and the next one reaches past that window, the tail of a split
+ * interval follows a full fragment. Any three fragments in a row carry more
+ * than window bytes.
+ */
+static inline size_t max_fragments(size_t bytes, size_t window, bool restart_aligned) {
+    const size_t full = bytes / window + 1;
+    return restart_aligned ? 3 * full : full;
+}
 
-                size_t table_size = (precision == 0) ? 64 : 128;
+/** Restart count intervals later, 0x3FFF is reserved and never names an interval (RFC 2435 3.1.7) */
+static inline uint32_t restart_count_add(uint32_t count, uint32_t intervals) {
+    return (count + intervals) % JPEG_RESTART_COUNT_WHOLE_FRAME;
+}
 
-                if ((pos + table_size) > seg_end) {
-                    break;
-                }
+#ifdef CONFIG_ESPRTP_JPEG_ZERO_COPY
+/**
+ * Hand the stack the header block and a reference into the frame buffer.
+ * lwIP builds the datagram from the iovec before sendmsg returns, so the
+ * frame only has to stay checked out for the duration of the call.
+ */
+static inline size_t send_fragment(struct rtp_dest_table* dests, uint8_t* header, size_t header_size,
+                                   const uint8_t* data, size_t data_size) {
+    return rtp_dest_send(dests, header, header_size, data, data_size);
+}
+#else
+static inline size_t send_fragment(struct rtp_dest_table* dests, uint8_t* header, size_t header_size,
+                                   const uint8_t* data, size_t data_size) {
+    memcpy(header + header_size, data, data_size); // once, whatever the number of destinations
+    return rtp_dest_send(dests, header, header_size + data_size, NULL, 0);
+}
+#endif
 
-                if ((precision == 0) && (table_id < MAX_QUANT_TABLES)) {
-                    tables[count++] = &buf[pos];
-                }
+/**
+ * Send the parity packets the last fragment completed. They share the pacer
+ * with the media so the frame spreading accounts for them.
+ */
+static void send_parity(struct rtp_dest_table* dests, size_t fanout, struct fec_encoder* fec, uint32_t rtp_ts,
+                        struct pacer* pacer) {
+    uint8_t* packet;
+    size_t len;
 
-                pos += table_size;
-            }
+    while ((len = fec_encoder_next(fec, rtp_ts, &packet)) > 0) {
+        pacer_wait(pacer, len * fanout);
 
-            /* Jump to end of DQT segment */
-            pos = seg_end;
-        } else {
-            pos++;
+        if (likely(rtp_dest_send_repair(dests, packet, len) > 0)) {
+            rtp_session_on_sent(fec->session, len - sizeof(struct rtp_header));
         }
     }
+}
 
-    return count;
+void rtp_jpeg_resend(struct rtp_dest_table* dests, struct rtp_history* history, struct pacer* pacer) {
+    size_t len;
+
+    while ((len = rtp_history_next(history, s_resend_packet)) > 0) {
+        pacer_wait(pacer, len * rtp_dest_fanout(dests));
+        rtp_dest_send_repair(dests, s_resend_packet, len);
+    }
 }
 
 /**
  * RTP send packets (fragmented for full JPEG)
  */
-void rtp_send_jpeg_packets(int sock, const struct sockaddr_in* to, uint8_t* buf, const camera_fb_t* fb) {
+void rtp_send_jpeg_packets(struct rtp_dest_table* dests, uint8_t* buf, const camera_fb_t* fb,
+                           struct rtp_session* session, struct pacer* pacer, struct fec_encoder* fec,
+                           struct rtp_history* history) {
+
+    struct jpeg_frame frame;
+    esp_err_t err = jpeg_frame_index(fb->buf, fb->len, &frame);
+    if (unlikely(err != ESP_OK || frame.scan_len == 0)) {
+        ESP_LOGE(TAG, "jpeg_frame_index: %s", esp_err_to_name(err));
+        return;
+    }
+
+    uint8_t type;
+    if (unlikely(jpeg_type_from_frame(&frame, &type) != ESP_OK)) {
+        ESP_LOGE(TAG, "unsupported sampling: %u components, Y %ux%u", frame.components, frame.component[0].h,
+                 frame.component[0].v);
+        return;
+    }
 
-    size_t jpeg_size;
-    const uint8_t* jpeg_data = get_jpeg_data(fb->buf, fb->len, &jpeg_size);
-    if (unlikely(jpeg_data == NULL)) {
-        ESP_LOGE(TAG, "empty jpeg payload");
+    if (unlikely(frame.width > JPEG_MAX_DIMENSION || frame.height > JPEG_MAX_DIMENSION)) {
+        ESP_LOGE(TAG, "frame %ux%u exceeds the RFC 2435 limit of %u pixels", frame.width, frame.height,
+                 JPEG_MAX_DIMENSION);
         return;
     }
 
-    const uint8_t* quant_tables[MAX_QUANT_TABLES];
-    size_t quant_tables_count = extract_quant_tables_refs(fb->buf, fb->len, quant_tables);
-    configASSERT(quant_tables_count <= MAX_QUANT_TABLES);
+    const uint8_t* jpeg_data = frame.scan;
+    const size_t jpeg_size = frame.scan_len;
+    const uint8_t* const* quant_tables = frame.quant_tables;
+    // Standard tables are signalled by Q alone, the receiver rebuilds them (RFC 2435 4.2)
+    const uint8_t standard_q = jpeg_quant_detect(&s_quant_cache, frame.quant_tables, frame.quant_tables_count);
+    const size_t quant_tables_count = standard_q ? 0 : frame.quant_tables_count;
 
     struct rtp_header* header;
     struct rtp_jpeg_header* jpeg_header;
     uint8_t* payload;
     size_t data_index = 0;
 
-    // Prepare common headers
     header = (struct rtp_header*)buf;
-    header->version = RTP_VERSION;
-    header->ssrc = htonl(RTP_JPEG_SSRC);
     // Use camera timestamp converted to RTP units (90kHz)
     uint32_t rtp_ts = (uint32_t)(fb->timestamp.tv_sec * 90000ULL + fb->timestamp.tv_usec * 90ULL / 1000ULL);
-    header->timestamp = htonl(rtp_ts);
-
-    uint16_t seq = esp_random() & 0xFFFF;
+    rtp_session_set_clock(session, rtp_ts, fb->timestamp.tv_sec * 1000000LL + fb->timestamp.tv_usec);
 
     jpeg_header = (struct rtp_jpeg_header*)(buf + sizeof(struct rtp_header));
     jpeg_header->type_specific = 0;
-    jpeg_header->type = JPEG_TYPE_YUV422; // YUV 4:2:2
-    jpeg_header->q = JPEG_Q_DEFAULT;      // Default quantization table
-    jpeg_header->width = fb->width / 8;
-    jpeg_header->height = fb->height / 8;
+    jpeg_header->type = type;
+    jpeg_header->q = standard_q ? standard_q : JPEG_Q_DEFAULT;
+    jpeg_header->width = (frame.width + 7) / 8;
+    jpeg_header->height = (frame.height + 7) / 8;
+
+    // With a DRI segment every packet carries whole restart intervals where possible, an interval
+    // larger than a packet is split and its last fragment carries nothing else (RFC 2435 3.1.7)
+    struct rtp_jpeg_restart_header* restart_header = NULL;
+    uint32_t restart_count = 0;
+    bool interval_start = true;
+    if (frame.restart_interval) {
+        jpeg_header->type |= JPEG_TYPE_RESTART;
+        restart_header = (struct rtp_jpeg_restart_header*)(jpeg_header + 1);
+        restart_header->interval = htons(frame.restart_interval);
+    }
+    const size_t main_header_size = sizeof(struct rtp_header) + sizeof(struct rtp_jpeg_header) +
+                                    (restart_header ? sizeof(struct rtp_jpeg_restart_header) : 0);
+
+    // Sample once so a concurrent MTU change never splits a frame across two sizes
+    // Parity packets are as long as the longest fragment plus the FEC headers
+    const size_t max_packet_size = rtp_jpeg_get_max_packet_size() - (fec ? FEC_OVERHEAD : 0);
+
+    const size_t tables_bytes =
+        standard_q ? 0 : quant_tables_count * QUANT_TABLE_SIZE + sizeof(struct jpeg_quant_header);
+    const size_t packets = max_fragments(jpeg_size + tables_bytes, max_packet_size - main_header_size - tables_bytes,
+                                         restart_header != NULL);
+    const size_t frame_bytes = jpeg_size + tables_bytes + packets * main_header_size;
+
+    // every destination takes its own share of the link, and pacer_wait is charged the headers too
+    const size_t fanout = rtp_dest_fanout(dests);
+    pacer_begin_frame(pacer, (fec ? frame_bytes + fec_encoder_overhead(fec, frame_bytes) : frame_bytes) * fanout);
+
+    // TCP destinations queue the frame whole or skip it, tell them at most how large it gets
+    rtp_dest_begin_frame(dests, frame_bytes, packets);
 
     // Fragment and send
     while (data_index < jpeg_size) {
-        header->seqNum = htons(seq++); // RFC 3550
-
-        size_t tables_size =
-            (data_index == 0) ? (quant_tables_count * QUANT_TABLE_SIZE) + sizeof(struct jpeg_quant_header) : 0;
-        payload = buf + sizeof(struct rtp_header) + sizeof(struct rtp_jpeg_header);
+        size_t tables_size = (data_index == 0 && standard_q == 0)
+                                 ? (quant_tables_count * QUANT_TABLE_SIZE) + sizeof(struct jpeg_quant_header)
+                                 : 0;
+        payload = buf + main_header_size;
 
         if (tables_size > 0) {
 
@@ -184,28 +250,71 @@ void rtp_send_jpeg_packets(int sock, const struct sockaddr_in* to, uint8_t* buf,
             }
         }
 
-        size_t chunk_size = min(RTP_PAYLOAD_SIZE - tables_size, jpeg_size - data_index);
+        size_t header_size = payload - buf;
+        size_t chunk_size = min(max_packet_size - header_size, jpeg_size - data_index);
+
+        if (restart_header) {
+            bool interval_end = true;
+            uint32_t intervals = 0;
+
+            // the tail of a split interval ends at its own marker, even in the last packet
+            const bool more = data_index + chunk_size < jpeg_size;
+            if (more || !interval_start) {
+                size_t aligned = restart_aligned_chunk(jpeg_data, data_index, data_index + chunk_size,
+                                                       !interval_start, &intervals);
+                if (likely(aligned > 0)) {
+                    chunk_size = aligned;
+                } else if (more) {
+                    interval_end = false; // interval larger than a packet, split it
+                }
+            }
 
-        set_fragment_offset(jpeg_header->fragment_offset, data_index);
-        memcpy(payload, jpeg_data + data_index, chunk_size);
+            uint16_t count = restart_count;
+            if (interval_start) {
+                count |= JPEG_RESTART_FIRST;
+            }
+            if (interval_end) {
+                count |= JPEG_RESTART_LAST;
+            }
+            restart_header->count = htons(count);
 
-        uint8_t marker = ((data_index + chunk_size) >= jpeg_size) ? RTP_MARKER_MASK : 0U;
-        header->payloadtype = (uint8_t)(RTP_JPEG_PAYLOADTYPE | marker);
+            restart_count = restart_count_add(restart_count, intervals);
+            interval_start = interval_end;
+        }
 
-        size_t packet_size = sizeof(struct rtp_header) + sizeof(struct rtp_jpeg_header) + tables_size + chunk_size;
-        if (unlikely(packet_size > RTP_PACKET_SIZE)) {
-            ESP_LOGE(TAG, "Packet size %zu exceeds RTP_PACKET_SIZE %d", packet_size, RTP_PACKET_SIZE);
+        set_fragment_offset(jpeg_header->fragment_offset, data_index);
+
+        if (unlikely(header_size + chunk_size > RTP_PACKET_SIZE)) {
+            ESP_LOGE(TAG, "Packet size %zu exceeds RTP_PACKET_SIZE %d", header_size + chunk_size, RTP_PACKET_SIZE);
             break;
         }
 
-        int res = sendto(sock, buf, packet_size, 0, (struct sockaddr*)to, sizeof(struct sockaddr));
-        if (unlikely(res < 0)) {
-            ESP_LOGE(TAG, "sendto error: %d (%s), skipping this packet", errno, strerror(errno));
-            break; // TODO: я чет не уверен что надо весь кадр скипать
+        const bool marker = (data_index + chunk_size) >= jpeg_size;
+        rtp_session_write_header(session, header, rtp_ts, marker);
+
+        pacer_wait(pacer, (header_size + chunk_size) * fanout);
+
+        // a destination that failed is accounted in the table, the others still get the frame
+        if (likely(send_fragment(dests, buf, header_size, jpeg_data + data_index, chunk_size) > 0)) {
+            rtp_session_on_sent(session, header_size - sizeof(struct rtp_header) + chunk_size);
+        }
+
+        if (history) {
+            rtp_history_put(history, buf, header_size, jpeg_data + data_index, chunk_size);
+        }
+
+        if (fec) {
+            fec_encoder_add(fec, buf, header_size, jpeg_data + data_index, chunk_size);
+            send_parity(dests, fanout, fec, rtp_ts, pacer);
+        }
+
+        // repairs of the previous fragments go out between this frame's fragments
+        if (history) {
+            rtp_jpeg_resend(dests, history, pacer);
         }
 
-        /* Throttle RTP packets to avoid network congestion */
-        vTaskDelay(pdMS_TO_TICKS(RTP_SEND_DELAY));
         data_index += chunk_size;
     }
+
+    rtp_dest_end_frame(dests);
 }
\ No newline at end of file
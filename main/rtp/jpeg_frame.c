@@ -0,0 +1,169 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "include/jpeg_frame.h"
+
+static inline uint16_t read_be16(const uint8_t* p) {
+    return ((uint16_t)p[0] << 8) | (uint16_t)p[1];
+}
+
+static inline bool is_standalone_marker(uint8_t marker) {
+    return marker == 0x01 || (marker >= JPEG_MARKER_RST0 && marker <= JPEG_MARKER_RST7);
+}
+
+static inline bool is_unsupported_sof(uint8_t marker) {
+    // SOF2..SOF15 except DHT (C4), JPG (C8) and DAC (CC)
+    return marker >= 0xC2 && marker <= 0xCF && marker != JPEG_MARKER_DHT && marker != 0xC8 && marker != 0xCC;
+}
+
+static esp_err_t parse_sof(const uint8_t* seg, size_t size, struct jpeg_frame* frame) {
+    if (unlikely(size < 6)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    if (unlikely(seg[0] != 8)) {
+        return ESP_ERR_NOT_SUPPORTED; // 12-bit samples
+    }
+
+    frame->height = read_be16(seg + 1);
+    frame->width = read_be16(seg + 3);
+
+    const uint8_t count = seg[5];
+    if (unlikely(count == 0 || count > JPEG_MAX_COMPONENTS)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (unlikely(size < 6 + (size_t)count * 3)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const uint8_t* p = seg + 6;
+    for (uint8_t i = 0; i < count; i++, p += 3) {
+        frame->component[i].id = p[0];
+        frame->component[i].h = p[1] >> 4;
+        frame->component[i].v = p[1] & 0x0F;
+        frame->component[i].tq = p[2];
+    }
+    frame->components = count;
+
+    return ESP_OK;
+}
+
+static esp_err_t parse_dqt(const uint8_t* seg, size_t size, struct jpeg_frame* frame) {
+    size_t pos = 0;
+
+    /* Parse all tables inside this DQT segment */
+    while (pos < size) {
+        const uint8_t precision = seg[pos] >> 4;
+        const uint8_t table_id = seg[pos] & 0x0F;
+        pos++;
+
+        const size_t table_size = (precision == 0) ? QUANT_TABLE_SIZE : QUANT_TABLE_SIZE * 2;
+        if (unlikely(pos + table_size > size)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        if (precision == 0 && table_id < MAX_QUANT_TABLES && frame->quant_tables_count < MAX_QUANT_TABLES) {
+            frame->quant_tables[frame->quant_tables_count++] = seg + pos;
+        }
+
+        pos += table_size;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t find_eoi(const uint8_t* buf, size_t len, struct jpeg_frame* frame) {
+    const size_t start = frame->scan - buf;
+
+    // esp32-camera trims the buffer right after EOI, so this loop normally runs once
+    size_t end = len;
+    while (end >= start + 2) {
+        if (buf[end - 2] == 0xFF && buf[end - 1] == JPEG_MARKER_EOI) {
+            frame->scan_len = end - 2 - start;
+            return ESP_OK;
+        }
+        end--;
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t jpeg_frame_index(const uint8_t* buf, size_t len, struct jpeg_frame* frame) {
+    if (unlikely(buf == NULL || frame == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(frame, 0, sizeof(*frame));
+
+    if (unlikely(len < 4 || buf[0] != 0xFF || buf[1] != JPEG_MARKER_SOI)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    size_t pos = 2;
+    while (pos + 2 <= len) {
+        if (unlikely(buf[pos] != 0xFF)) {
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        const uint8_t marker = buf[pos + 1];
+        if (marker == 0xFF) {
+            pos++; // fill byte
+            continue;
+        }
+        pos += 2;
+
+        if (is_standalone_marker(marker)) {
+            continue;
+        }
+        if (unlikely(marker == JPEG_MARKER_EOI)) {
+            return ESP_ERR_NOT_FOUND; // no SOS in this frame
+        }
+
+        if (unlikely(pos + 2 > len)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        const uint16_t seg_len = read_be16(buf + pos);
+        if (unlikely(seg_len < 2 || pos + seg_len > len)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        const uint8_t* seg = buf + pos + 2;
+        const size_t seg_size = seg_len - 2;
+        esp_err_t err = ESP_OK;
+
+        switch (marker) {
+        case JPEG_MARKER_SOF0:
+        case JPEG_MARKER_SOF1:
+            err = parse_sof(seg, seg_size, frame);
+            break;
+        case JPEG_MARKER_DQT:
+            err = parse_dqt(seg, seg_size, frame);
+            break;
+        case JPEG_MARKER_DRI:
+            if (unlikely(seg_size < 2)) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            frame->restart_interval = read_be16(seg);
+            break;
+        case JPEG_MARKER_SOS:
+            if (unlikely(frame->components == 0)) {
+                return ESP_ERR_INVALID_STATE; // SOS before SOF
+            }
+            frame->scan = buf + pos + seg_len;
+            return find_eoi(buf, len, frame);
+        default:
+            if (unlikely(is_unsupported_sof(marker))) {
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+            break;
+        }
+
+        if (unlikely(err != ESP_OK)) {
+            return err;
+        }
+
+        pos += seg_len;
+    }
+
+    return ESP_ERR_NOT_FOUND;
+}
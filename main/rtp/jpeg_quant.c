@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "esp_compiler.h"
+
+#include "include/jpeg_quant.h"
+
+// RFC 2435 Appendix A tables, reordered to zigzag so they compare directly with DQT data
+static const uint8_t jpeg_luma_quantizer[QUANT_TABLE_SIZE] = {
+    16,  11,  12,  14,  12,  10,  16,  14,  //
+    13,  14,  18,  17,  16,  19,  24,  40,  //
+    26,  24,  22,  22,  24,  49,  35,  37,  //
+    29,  40,  58,  51,  61,  60,  57,  51,  //
+    56,  55,  64,  72,  92,  78,  64,  68,  //
+    87,  69,  55,  56,  80,  109, 81,  87,  //
+    95,  98,  103, 104, 103, 62,  77,  113, //
+    121, 112, 100, 120, 92,  101, 103, 99,  //
+};
+
+static const uint8_t jpeg_chroma_quantizer[QUANT_TABLE_SIZE] = {
+    17, 18, 18, 24, 21, 24, 47, 26, //
+    26, 47, 99, 66, 56, 66, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+    99, 99, 99, 99, 99, 99, 99, 99, //
+};
+
+static inline int q_factor(uint8_t q) {
+    return (q < 50) ? 5000 / q : 200 - q * 2;
+}
+
+static inline uint8_t scale(uint8_t base, int factor) {
+    int v = (base * factor + 50) / 100;
+    return (v < 1) ? 1 : (v > 255) ? 255 : (uint8_t)v;
+}
+
+void jpeg_quant_make_tables(uint8_t q, uint8_t luma[QUANT_TABLE_SIZE], uint8_t chroma[QUANT_TABLE_SIZE]) {
+    if (q < JPEG_Q_STANDARD_MIN) {
+        q = JPEG_Q_STANDARD_MIN;
+    } else if (q > JPEG_Q_STANDARD_MAX) {
+        q = JPEG_Q_STANDARD_MAX;
+    }
+
+    const int factor = q_factor(q);
+    for (size_t i = 0; i < QUANT_TABLE_SIZE; i++) {
+        luma[i] = scale(jpeg_luma_quantizer[i], factor);
+        chroma[i] = scale(jpeg_chroma_quantizer[i], factor);
+    }
+}
+
+static bool matches(const uint8_t* table, const uint8_t* base, int factor) {
+    for (size_t i = 0; i < QUANT_TABLE_SIZE; i++) {
+        if (table[i] != scale(base[i], factor)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static uint8_t search(const uint8_t* luma, const uint8_t* chroma) {
+    for (uint8_t q = JPEG_Q_STANDARD_MIN; q <= JPEG_Q_STANDARD_MAX; q++) {
+        const int factor = q_factor(q);
+        // most candidates already fail on the DC entry
+        if (luma[0] == scale(jpeg_luma_quantizer[0], factor) && matches(luma, jpeg_luma_quantizer, factor) &&
+            matches(chroma, jpeg_chroma_quantizer, factor)) {
+            return q;
+        }
+    }
+
+    return 0;
+}
+
+uint8_t jpeg_quant_detect(struct jpeg_quant_cache* cache, const uint8_t* const* tables, size_t count) {
+    if (unlikely(count != 2)) {
+        return 0;
+    }
+
+    // comparing 128 bytes costs what hashing them would, and a hash could collide
+    if (likely(cache->valid && memcmp(cache->tables[0], tables[0], QUANT_TABLE_SIZE) == 0 &&
+               memcmp(cache->tables[1], tables[1], QUANT_TABLE_SIZE) == 0)) {
+        return cache->q;
+    }
+
+    memcpy(cache->tables[0], tables[0], QUANT_TABLE_SIZE);
+    memcpy(cache->tables[1], tables[1], QUANT_TABLE_SIZE);
+    cache->q = search(tables[0], tables[1]);
+    cache->valid = true;
+
+    return cache->q;
+}
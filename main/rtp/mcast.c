@@ -0,0 +1,59 @@
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_netif.h"
+
+#include "include/mcast.h"
+
+static const char* const TAG = "rtp_mcast";
+
+esp_err_t rtp_multicast_group(struct in_addr* out) {
+    if (inet_aton(RTP_MULTICAST_ADDRESS, &out->s_addr) == 0 || !rtp_is_multicast(out)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    return ESP_OK;
+}
+
+struct in_addr rtp_multicast_interface(void) {
+    struct in_addr addr = {.s_addr = htonl(INADDR_ANY)};
+
+    if (CONFIG_ESPRTP_MULTICAST_IF[0] != '\0') {
+        inet_aton(CONFIG_ESPRTP_MULTICAST_IF, &addr.s_addr);
+        return addr;
+    }
+
+    esp_netif_ip_info_t info;
+    esp_netif_t* netif = esp_netif_get_default_netif();
+    if (netif && esp_netif_get_ip_info(netif, &info) == ESP_OK) {
+        addr.s_addr = info.ip.addr;
+    }
+
+    return addr;
+}
+
+esp_err_t rtp_multicast_socket_init(int sock) {
+    // lwIP reads these two as u8_t, Linux accepts either size
+    const uint8_t ttl = RTP_MULTICAST_TTL;
+#ifdef CONFIG_ESPRTP_MULTICAST_LOOP
+    const uint8_t loop = 1;
+#else
+    const uint8_t loop = 0;
+#endif
+
+    if (unlikely(setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0 ||
+                 setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0)) {
+        ESP_LOGE(TAG, "setsockopt: %d (%s)", errno, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    // INADDR_ANY leaves the choice to the routing table
+    const struct in_addr iface = rtp_multicast_interface();
+    if (iface.s_addr != htonl(INADDR_ANY) &&
+        unlikely(setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface)) < 0)) {
+        ESP_LOGE(TAG, "IP_MULTICAST_IF %s: %d (%s)", inet_ntoa(iface), errno, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,130 @@
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "include/pacer.h"
+
+#define US_PER_SEC 1000000LL
+
+static void wake_up(void* arg) {
+    xSemaphoreGive(((struct pacer*)arg)->wake);
+}
+
+esp_err_t pacer_init(struct pacer* p, uint32_t bitrate_kbps, size_t burst_bytes, uint32_t fps) {
+    memset(p, 0, sizeof(*p));
+
+    p->wake = xSemaphoreCreateBinary();
+    if (unlikely(p->wake == NULL)) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t args = {
+        .callback = wake_up,
+        .arg = p,
+        .name = "pacer",
+    };
+    const esp_err_t err = esp_timer_create(&args, &p->timer);
+    if (unlikely(err != ESP_OK)) {
+        vSemaphoreDelete(p->wake);
+        p->wake = NULL;
+        return err;
+    }
+
+    p->max_rate = bitrate_kbps * 1000U / 8U;
+    p->rate = p->max_rate;
+    p->fps = fps;
+    p->burst = (int64_t)burst_bytes * US_PER_SEC;
+    p->tokens = p->burst;
+    p->last_us = esp_timer_get_time();
+    p->start_us = p->last_us;
+
+    return ESP_OK;
+}
+
+void pacer_deinit(struct pacer* p) {
+    esp_timer_delete(p->timer);
+    vSemaphoreDelete(p->wake);
+    p->timer = NULL;
+    p->wake = NULL;
+}
+
+void pacer_set_fps(struct pacer* p, uint32_t fps) {
+    __atomic_store_n(&p->fps, fps, __ATOMIC_RELAXED);
+}
+
+void pacer_begin_frame(struct pacer* p, size_t frame_bytes) {
+    const uint32_t fps = __atomic_load_n(&p->fps, __ATOMIC_RELAXED);
+    if (fps == 0) {
+        p->rate = p->max_rate;
+        return;
+    }
+
+    uint64_t rate = (uint64_t)frame_bytes * fps;
+    if (rate > p->max_rate) {
+        rate = p->max_rate;
+    }
+
+    p->rate = rate ? (uint32_t)rate : 1U;
+}
+
+int64_t pacer_schedule(struct pacer* p, size_t bytes, int64_t now_us) {
+    if (now_us < p->last_us) {
+        now_us = p->last_us; // previous packet has not left yet
+    }
+
+    p->tokens += (now_us - p->last_us) * p->rate;
+    if (p->tokens > p->burst) {
+        p->tokens = p->burst;
+    }
+    p->last_us = now_us;
+
+    const int64_t need = (int64_t)bytes * US_PER_SEC;
+    if (likely(p->tokens >= need)) {
+        p->tokens -= need;
+        return now_us;
+    }
+
+    const int64_t wait_us = (need - p->tokens + p->rate - 1) / p->rate;
+    p->tokens += wait_us * p->rate - need;
+    p->last_us = now_us + wait_us;
+
+    return p->last_us;
+}
+
+static void sleep_until(struct pacer* p, int64_t deadline_us) {
+    const int64_t remaining = deadline_us - esp_timer_get_time();
+    if (remaining <= 0) {
+        return;
+    }
+
+    // most gaps between fragments are well under a tick, vTaskDelay cannot time them
+    if (unlikely(esp_timer_start_once(p->timer, (uint64_t)remaining) != ESP_OK)) {
+        vTaskDelay(1);
+        return;
+    }
+    xSemaphoreTake(p->wake, portMAX_DELAY);
+}
+
+void pacer_wait(struct pacer* p, size_t bytes) {
+    const int64_t now = esp_timer_get_time();
+    const int64_t departure = pacer_schedule(p, bytes, now);
+
+    if (departure > now) {
+        sleep_until(p, departure);
+        p->stats.wait_us += departure - now;
+    }
+
+    p->stats.packets++;
+    p->stats.bytes += bytes;
+}
+
+void pacer_get_stats(const struct pacer* p, struct pacer_stats* out) {
+    *out = p->stats;
+
+    const int64_t elapsed = esp_timer_get_time() - p->start_us;
+    out->rate_bps = elapsed > 0 ? (uint32_t)(p->stats.bytes * 8ULL * US_PER_SEC / elapsed) : 0U;
+    out->fps = __atomic_load_n(&p->fps, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,140 @@
+#include "esp_camera.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "include/common.h"
+#include "include/quality.h"
+#include "include/ratectl.h"
+#include "include/rtcp.h"
+#include "include/rtp.h"
+
+static const char* const TAG = "quality";
+
+#define QUALITY_PERIOD_MS 1000
+
+struct quality_step {
+    framesize_t frame_size;
+    uint8_t jpeg_quality; // esp32-camera scale, lower is better
+    uint8_t fps;
+};
+
+/** Best to worst */
+static const struct quality_step s_ladder[] = {
+    {FRAMESIZE_UXGA, 10, 10}, {FRAMESIZE_SXGA, 10, 10}, {FRAMESIZE_XGA, 10, 12},  {FRAMESIZE_SVGA, 10, 15},
+    {FRAMESIZE_SVGA, 14, 15}, {FRAMESIZE_VGA, 12, 15},  {FRAMESIZE_VGA, 16, 12},  {FRAMESIZE_QVGA, 12, 15},
+    {FRAMESIZE_QVGA, 20, 10}, {FRAMESIZE_QQVGA, 20, 10},
+};
+
+#define LADDER_SIZE (sizeof(s_ladder) / sizeof(s_ladder[0]))
+
+static struct ratectl s_ratectl;
+
+static void apply_step(sensor_t* sensor, size_t level) {
+    const struct quality_step* step = &s_ladder[level];
+
+    ESP_LOGI(TAG, "level %zu: framesize %d, quality %u, %u fps", level, step->frame_size, step->jpeg_quality,
+             step->fps);
+
+    if (sensor->status.framesize != step->frame_size && sensor->set_framesize(sensor, step->frame_size) != 0) {
+        ESP_LOGW(TAG, "set_framesize %d failed", step->frame_size);
+    }
+    if (sensor->set_quality(sensor, step->jpeg_quality) != 0) {
+        ESP_LOGW(TAG, "set_quality %u failed", step->jpeg_quality);
+    }
+
+    rtp_set_video_fps_cap(step->fps);
+}
+
+/** Whether a receiver report arrived since the last call, and the fraction lost it carries */
+static bool fresh_fraction_lost(uint32_t* last_reports, uint8_t* fraction_lost) {
+#ifdef CONFIG_ESPRTP_RTCP_SUPPORT
+    struct rtcp_stream_stats rtcp;
+    if (rtcp_get_stats(RTP_JPEG_SSRC, &rtcp) == ESP_OK && rtcp.reports != *last_reports) {
+        *last_reports = rtcp.reports;
+        *fraction_lost = rtcp.fraction_lost;
+        return true;
+    }
+
+    *fraction_lost = 0;
+    return false;
+#else
+    // no receiver reports without RTCP, only the local queue drops steer the ladder
+    *fraction_lost = 0;
+    return true;
+#endif
+}
+
+static void quality_task(void* pvParameters) {
+    sensor_t* sensor = pvParameters;
+
+    struct rtp_video_stats prev_video = {0};
+    struct pacer_stats prev_pacer = {0};
+    uint32_t last_reports = 0;
+
+    TickType_t xLastWakeTime = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(QUALITY_PERIOD_MS));
+
+        struct rtp_video_stats video;
+        struct pacer_stats pacer;
+        rtp_get_video_stats(&video);
+        rtp_get_video_pacer_stats(&pacer);
+
+        uint8_t fraction_lost;
+        const bool feedback = fresh_fraction_lost(&last_reports, &fraction_lost);
+
+        const struct ratectl_sample sample = {
+            .feedback = feedback,
+            .fraction_lost = fraction_lost,
+            .frames_queued = video.queued - prev_video.queued,
+            .frames_dropped = video.dropped - prev_video.dropped,
+            .achieved_bps = (uint32_t)((pacer.bytes - prev_pacer.bytes) * 8000U / QUALITY_PERIOD_MS),
+            .capacity_bps = RTP_VIDEO_BITRATE_KBPS * 1000U,
+        };
+        prev_video = video;
+        prev_pacer = pacer;
+
+        const size_t level = s_ratectl.level;
+        if (ratectl_update(&s_ratectl, &sample) != level) {
+            apply_step(sensor, s_ratectl.level);
+        }
+    }
+}
+
+esp_err_t quality_start(void) {
+    sensor_t* sensor = esp_camera_sensor_get();
+    if (unlikely(sensor == NULL)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // frame buffers are sized for the boot frame size, never go above it
+    size_t top = 0;
+    while (top < LADDER_SIZE - 1 && s_ladder[top].frame_size > sensor->status.framesize) {
+        top++;
+    }
+
+    const struct ratectl_config cfg = {
+        .loss_down = 13,    // ~5%
+        .loss_up = 3,       // ~1%
+        .drop_down_pct = 20,
+        .headroom_pct = 80,
+        .up_hold = 3,
+        .up_hold_max = 16,
+        .min_level = top,
+        .max_level = LADDER_SIZE - 1,
+    };
+    ratectl_init(&s_ratectl, &cfg, top);
+    // the task only applies changes, the capture must not run uncapped until the first one
+    apply_step(sensor, s_ratectl.level);
+
+    if (unlikely(xTaskCreate(quality_task, "quality_task", DEFAULT_THREAD_STACKSIZE, sensor, DEFAULT_THREAD_PRIO,
+                             NULL) != pdPASS)) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,78 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "esp_compiler.h"
+
+#include "include/ratectl.h"
+
+void ratectl_init(struct ratectl* rc, const struct ratectl_config* cfg, size_t start_level) {
+    memset(rc, 0, sizeof(*rc));
+
+    rc->cfg = *cfg;
+    rc->level = start_level < cfg->min_level ? cfg->min_level : start_level;
+    if (rc->level > cfg->max_level) {
+        rc->level = cfg->max_level;
+    }
+    rc->hold = cfg->up_hold;
+    rc->since_up = UINT32_MAX;
+}
+
+static bool is_congested(const struct ratectl* rc, const struct ratectl_sample* s) {
+    if (s->fraction_lost > rc->cfg.loss_down) {
+        return true;
+    }
+
+    const uint32_t frames = s->frames_queued;
+    return frames > 0 && s->frames_dropped * 100U >= frames * rc->cfg.drop_down_pct;
+}
+
+static bool is_clean(const struct ratectl* rc, const struct ratectl_sample* s) {
+    if (!s->feedback || s->fraction_lost > rc->cfg.loss_up || s->frames_dropped > 0) {
+        return false;
+    }
+
+    return s->capacity_bps == 0 || (uint64_t)s->achieved_bps * 100U < (uint64_t)s->capacity_bps * rc->cfg.headroom_pct;
+}
+
+size_t ratectl_update(struct ratectl* rc, const struct ratectl_sample* sample) {
+    if (rc->since_up != UINT32_MAX && ++rc->since_up > rc->hold) {
+        // the last step up held, relax the backoff
+        rc->hold = (rc->hold / 2 > rc->cfg.up_hold) ? rc->hold / 2 : rc->cfg.up_hold;
+        rc->since_up = UINT32_MAX;
+    }
+
+    if (is_congested(rc, sample)) {
+        rc->clean_periods = 0;
+
+        if (rc->since_up != UINT32_MAX) {
+            // the last step up did not hold, wait longer before the next one
+            rc->hold *= 2;
+            if (rc->hold > rc->cfg.up_hold_max) {
+                rc->hold = rc->cfg.up_hold_max;
+            }
+        }
+        rc->since_up = UINT32_MAX;
+
+        if (rc->level < rc->cfg.max_level) {
+            rc->level++;
+        }
+        return rc->level;
+    }
+
+    if (!sample->feedback) {
+        return rc->level; // a silent receiver neither resets nor extends the clean run
+    }
+
+    if (!is_clean(rc, sample)) {
+        rc->clean_periods = 0;
+        return rc->level;
+    }
+
+    if (++rc->clean_periods >= rc->hold && rc->level > rc->cfg.min_level) {
+        rc->level--;
+        rc->clean_periods = 0;
+        rc->since_up = 0;
+    }
+
+    return rc->level;
+}
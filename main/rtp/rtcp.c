@@ -0,0 +1,465 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "include/mcast.h"
+#include "include/rtcp.h"
+
+static const char* const TAG = "rtcp";
+
+#define RTCP_MIN_INTERVAL_US 5000000LL
+#define RTCP_BW_FRACTION 0.05f        // of the session bandwidth (RFC 3550 6.2)
+#define RTCP_SENDER_BW_FRACTION 0.25f // share reserved for senders
+#define RTCP_COMPENSATION (2.71828f - 1.5f)
+
+struct rtcp_stream {
+    const struct rtp_session* session;
+    struct rtp_history* history; // NULL when NACKs are not answered
+    struct rtp_dest_table* dests; // NULL to report to `to` only
+    int sock;
+    struct sockaddr_in to;
+    uint32_t session_bw; // bytes per second
+    uint32_t members;
+    float avg_size;
+    bool initial;
+    int64_t next_us;
+    struct rtcp_stream_stats stats;
+};
+
+static struct rtcp_stream s_streams[RTCP_MAX_STREAMS];
+static size_t s_stream_count;
+static SemaphoreHandle_t s_stats_lock;
+static char s_cname[32];
+static rtcp_report_cb s_report_cb;
+
+static inline void ntp_now(uint32_t* sec, uint32_t* frac) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    *sec = (uint32_t)tv.tv_sec + RTCP_NTP_UNIX_OFFSET;
+    *frac = (uint32_t)(((uint64_t)tv.tv_usec << 32) / 1000000ULL);
+}
+
+static inline uint32_t ntp_middle(uint32_t sec, uint32_t frac) {
+    return (sec << 16) | (frac >> 16);
+}
+
+/**
+ * RFC 3550 appendix A.7 for a stream with one sender (us).
+ */
+static int64_t rtcp_interval(const struct rtcp_stream* s) {
+    float rtcp_bw = s->session_bw * RTCP_BW_FRACTION;
+    float n = s->members;
+    const uint32_t senders = 1;
+
+    if (senders <= s->members * RTCP_SENDER_BW_FRACTION) {
+        rtcp_bw *= RTCP_SENDER_BW_FRACTION;
+        n = senders;
+    }
+
+    float t = s->avg_size * n / rtcp_bw * 1e6f;
+    const float min_time = s->initial ? RTCP_MIN_INTERVAL_US / 2 : RTCP_MIN_INTERVAL_US;
+    if (t < min_time) {
+        t = min_time;
+    }
+
+    // randomize to [0.5, 1.5] of the interval
+    t = t * (0.5f + (esp_random() & 0xFFFF) / 65536.0f) / RTCP_COMPENSATION;
+
+    return (int64_t)t;
+}
+
+static size_t append_sdes(uint8_t* buf, uint32_t ssrc) {
+    const size_t cname_len = strlen(s_cname);
+    // header, SSRC, CNAME item, END, padded to a 32-bit boundary
+    const size_t len = (sizeof(struct rtcp_header) + 4 + 2 + cname_len + 1 + 3) & ~3U;
+
+    memset(buf, 0, len);
+
+    struct rtcp_header* h = (struct rtcp_header*)buf;
+    h->version = RTCP_VERSION | 1; // one chunk
+    h->type = RTCP_SDES;
+    h->length = htons(len / 4 - 1);
+
+    uint8_t* p = buf + sizeof(*h);
+    const uint32_t ssrc_be = htonl(ssrc);
+    memcpy(p, &ssrc_be, sizeof(ssrc_be));
+    p += sizeof(ssrc_be);
+
+    *p++ = RTCP_SDES_CNAME;
+    *p++ = (uint8_t)cname_len;
+    memcpy(p, s_cname, cname_len);
+
+    return len;
+}
+
+static void send_report(struct rtcp_stream* s) {
+    static uint8_t buf[RTCP_PACKET_SIZE]; // only used by rtcp_task
+    const struct rtp_session* session = s->session;
+
+    uint32_t packets = __atomic_load_n(&session->packets, __ATOMIC_RELAXED);
+    if (packets == 0) {
+        return; // nothing sent yet, an SR would carry no timing
+    }
+
+    uint32_t ntp_sec, ntp_frac, rtp_ts;
+    const int64_t now = esp_timer_get_time();
+    ntp_now(&ntp_sec, &ntp_frac);
+    if (unlikely(!rtp_session_timestamp_at(session, now, &rtp_ts))) {
+        return;
+    }
+
+    struct rtcp_header* h = (struct rtcp_header*)buf;
+    h->version = RTCP_VERSION;
+    h->type = RTCP_SR;
+    h->length = htons((sizeof(*h) + sizeof(struct rtcp_sender_info)) / 4 - 1);
+
+    struct rtcp_sender_info* info = (struct rtcp_sender_info*)(h + 1);
+    info->ssrc = htonl(session->ssrc);
+    info->ntp_sec = htonl(ntp_sec);
+    info->ntp_frac = htonl(ntp_frac);
+    info->rtp_ts = htonl(rtp_ts);
+    info->packets = htonl(packets);
+    info->octets = htonl(__atomic_load_n(&session->octets, __ATOMIC_RELAXED));
+
+    const size_t sdes_offset = sizeof(*h) + sizeof(*info);
+    const size_t len = sdes_offset + append_sdes(buf + sdes_offset, session->ssrc);
+
+    if (s->dests) {
+        struct rtp_dest_addr dests[RTP_DEST_MAX];
+        const size_t count = rtp_dest_list(s->dests, dests, RTP_DEST_MAX);
+        bool sent = false;
+
+        for (size_t i = 0; i < count; i++) {
+            // same report under the SSRC this receiver sees, in the SR and the SDES chunk
+            const uint32_t ssrc_be = htonl(dests[i].ssrc);
+            info->ssrc = ssrc_be;
+            memcpy(buf + sdes_offset + sizeof(struct rtcp_header), &ssrc_be, sizeof(ssrc_be));
+
+            if (dests[i].link) {
+                sent |= rtp_tcp_link_put(dests[i].link, dests[i].channel + 1, buf, len, NULL, 0, false) == ESP_OK;
+                continue;
+            }
+
+            struct sockaddr_in to = dests[i].addr;
+            to.sin_port = htons(ntohs(to.sin_port) + 1);
+            if (unlikely(sendto(s->sock, buf, len, 0, (struct sockaddr*)&to, sizeof(to)) < 0)) {
+                ESP_LOGW(TAG, "sendto %s: %d (%s)", inet_ntoa(to.sin_addr), errno, strerror(errno));
+                continue;
+            }
+            sent = true;
+        }
+
+        if (!sent) {
+            return;
+        }
+    } else if (unlikely(sendto(s->sock, buf, len, 0, (struct sockaddr*)&s->to, sizeof(s->to)) < 0)) {
+        ESP_LOGW(TAG, "sendto error: %d (%s)", errno, strerror(errno));
+        return;
+    }
+
+    // RFC 3550 6.3.3: average compound size including UDP/IP headers
+    s->avg_size += ((len + RTP_IP_UDP_OVERHEAD) - s->avg_size) / 16.0f;
+    s->initial = false;
+
+    xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    s->stats.sender_reports++;
+    xSemaphoreGive(s_stats_lock);
+}
+
+static struct rtcp_stream* find_stream(uint32_t ssrc) {
+    for (size_t i = 0; i < s_stream_count; i++) {
+        if (s_streams[i].session->ssrc == ssrc) {
+            return &s_streams[i];
+        }
+    }
+
+    return NULL;
+}
+
+static void handle_report_block(uint32_t reporter, const struct rtcp_report_block* block) {
+    struct rtcp_stream* s = find_stream(ntohl(block->ssrc));
+    if (s == NULL) {
+        return; // report about somebody else
+    }
+
+    const uint32_t lost = ntohl(block->lost);
+    const uint32_t lsr = ntohl(block->lsr);
+    const uint32_t dlsr = ntohl(block->dlsr);
+
+    uint32_t rtt_us = 0;
+    if (lsr != 0) {
+        uint32_t ntp_sec, ntp_frac;
+        ntp_now(&ntp_sec, &ntp_frac);
+        // RTT = A - LSR - DLSR in 1/65536 s (RFC 3550 6.4.1)
+        const uint32_t rtt = ntp_middle(ntp_sec, ntp_frac) - lsr - dlsr;
+        if (rtt < (1U << 31)) {
+            rtt_us = (uint32_t)(((uint64_t)rtt * 1000000ULL) >> 16);
+        }
+    }
+
+    xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    s->stats.reporter_ssrc = reporter;
+    s->stats.fraction_lost = lost >> 24;
+    s->stats.cumulative_lost = ((int32_t)(lost << 8)) >> 8; // sign-extend 24 bits
+    s->stats.highest_seq = ntohl(block->highest_seq);
+    s->stats.jitter = ntohl(block->jitter);
+    if (rtt_us) {
+        s->stats.rtt_us = rtt_us;
+    }
+    s->stats.reports++;
+    s->stats.last_report_us = esp_timer_get_time();
+    xSemaphoreGive(s_stats_lock);
+}
+
+/**
+ * Generic NACK (RFC 4585 6.2.1): sender SSRC, media SSRC, then one or more
+ * PID/BLP entries. Only queues the packets, the sending task resends them.
+ */
+static void handle_nack(const uint8_t* body, size_t body_len) {
+    if (unlikely(body_len < 8)) {
+        return;
+    }
+
+    uint32_t media_ssrc;
+    memcpy(&media_ssrc, body + 4, sizeof(media_ssrc));
+    struct rtcp_stream* s = find_stream(ntohl(media_ssrc));
+    if (s == NULL || s->history == NULL) {
+        return;
+    }
+
+    for (size_t off = 8; off + sizeof(struct rtcp_nack) <= body_len; off += sizeof(struct rtcp_nack)) {
+        struct rtcp_nack nack;
+        memcpy(&nack, body + off, sizeof(nack));
+        rtp_history_request(s->history, ntohs(nack.pid), ntohs(nack.blp));
+    }
+}
+
+/**
+ * Walk a compound packet and pick the report blocks of SR and RR packets
+ * and the Generic NACKs.
+ *
+ * @return whether it held a sender or receiver report
+ */
+static bool handle_compound(const uint8_t* buf, size_t len) {
+    size_t pos = 0;
+    bool report = false;
+
+    while (pos + sizeof(struct rtcp_header) + 4 <= len) {
+        const struct rtcp_header* h = (const struct rtcp_header*)(buf + pos);
+        const size_t packet_len = (ntohs(h->length) + 1U) * 4U;
+
+        if (unlikely((h->version & 0xC0) != RTCP_VERSION || pos + packet_len > len)) {
+            return report;
+        }
+
+        const uint8_t count = h->version & 0x1F;
+        const uint8_t* body = buf + pos + sizeof(*h);
+        uint32_t reporter;
+        memcpy(&reporter, body, sizeof(reporter));
+        reporter = ntohl(reporter);
+
+        size_t blocks_offset = 0;
+        if (h->type == RTCP_SR) {
+            blocks_offset = sizeof(struct rtcp_sender_info);
+        } else if (h->type == RTCP_RR) {
+            blocks_offset = 4;
+        }
+        report |= blocks_offset != 0;
+
+        const size_t body_len = packet_len - sizeof(*h);
+        if (h->type == RTCP_RTPFB && count == RTCP_FB_NACK) {
+            handle_nack(body, body_len);
+        }
+
+        if (blocks_offset) {
+            for (uint8_t i = 0; i < count; i++) {
+                const size_t off = blocks_offset + i * sizeof(struct rtcp_report_block);
+                if (off + sizeof(struct rtcp_report_block) > body_len) {
+                    break;
+                }
+
+                struct rtcp_report_block block;
+                memcpy(&block, body + off, sizeof(block));
+                handle_report_block(reporter, &block);
+            }
+        }
+
+        pos += packet_len;
+    }
+
+    return report;
+}
+
+void rtcp_handle_packet(const uint8_t* buf, size_t len) {
+    handle_compound(buf, len);
+}
+
+void rtcp_set_report_callback(rtcp_report_cb cb) {
+    __atomic_store_n(&s_report_cb, cb, __ATOMIC_RELEASE);
+}
+
+static void rtcp_task(void* pvParameters) {
+    static uint8_t buf[RTCP_PACKET_SIZE * 2];
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        int64_t next = INT64_MAX;
+
+        for (size_t i = 0; i < s_stream_count; i++) {
+            struct rtcp_stream* s = &s_streams[i];
+            if (now >= s->next_us) {
+                send_report(s);
+                s->next_us = now + rtcp_interval(s);
+            }
+            if (s->next_us < next) {
+                next = s->next_us;
+            }
+        }
+
+        fd_set fds;
+        FD_ZERO(&fds);
+        int max_fd = -1;
+        for (size_t i = 0; i < s_stream_count; i++) {
+            FD_SET(s_streams[i].sock, &fds);
+            if (s_streams[i].sock > max_fd) {
+                max_fd = s_streams[i].sock;
+            }
+        }
+
+        const int64_t wait_us = next - esp_timer_get_time();
+        struct timeval tv = {
+            .tv_sec = wait_us > 0 ? wait_us / 1000000 : 0,
+            .tv_usec = wait_us > 0 ? wait_us % 1000000 : 0,
+        };
+
+        int ready = select(max_fd + 1, &fds, NULL, NULL, &tv);
+        if (ready <= 0) {
+            continue;
+        }
+
+        for (size_t i = 0; i < s_stream_count; i++) {
+            if (!FD_ISSET(s_streams[i].sock, &fds)) {
+                continue;
+            }
+
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            int len = recvfrom(s_streams[i].sock, buf, sizeof(buf), 0, (struct sockaddr*)&from, &from_len);
+            if (len > 0 && handle_compound(buf, (size_t)len)) {
+                const rtcp_report_cb cb = __atomic_load_n(&s_report_cb, __ATOMIC_ACQUIRE);
+                if (cb) {
+                    cb(&from);
+                }
+            }
+        }
+    }
+}
+
+esp_err_t rtcp_add_stream(const struct rtp_session* session, const struct sockaddr_in* rtp_to,
+                          uint32_t session_bw_bps) {
+    if (unlikely(s_stream_count >= RTCP_MAX_STREAMS)) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (unlikely(sock < 0)) {
+        ESP_LOGE(TAG, "socket: %d (%s)", errno, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    const in_port_t rtcp_port = htons(ntohs(rtp_to->sin_port) + 1);
+
+    struct sockaddr_in local = {
+        .sin_family = PF_INET,
+        .sin_port = rtcp_port,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (unlikely(bind(sock, (struct sockaddr*)&local, sizeof(local)) < 0)) {
+        // A receiver on the same host owns port + 1; it can still answer the SR source address
+        ESP_LOGW(TAG, "bind %d: %d (%s), using an ephemeral port", ntohs(rtcp_port), errno, strerror(errno));
+        local.sin_port = 0;
+        if (unlikely(bind(sock, (struct sockaddr*)&local, sizeof(local)) < 0)) {
+            ESP_LOGE(TAG, "bind: %d (%s)", errno, strerror(errno));
+            closesocket(sock);
+            return ESP_FAIL;
+        }
+    }
+
+    // sender reports follow the stream to a multicast group
+    ESP_ERROR_CHECK_WITHOUT_ABORT(rtp_multicast_socket_init(sock));
+
+    struct rtcp_stream* s = &s_streams[s_stream_count++];
+    memset(s, 0, sizeof(*s));
+    s->session = session;
+    s->sock = sock;
+    s->to = *rtp_to;
+    s->to.sin_port = rtcp_port;
+    s->session_bw = session_bw_bps / 8U;
+    s->members = 2;
+    s->initial = true;
+    s->avg_size = 128.0f; // first estimate, RFC 3550 6.3.2 suggests the size of the first packet
+    s->next_us = esp_timer_get_time() + rtcp_interval(s);
+
+    ESP_LOGI(TAG, "SSRC %08" PRIx32 " reports on port %d", session->ssrc, ntohs(rtcp_port));
+
+    return ESP_OK;
+}
+
+esp_err_t rtcp_set_history(uint32_t ssrc, struct rtp_history* history) {
+    struct rtcp_stream* s = find_stream(ssrc);
+    if (s == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    s->history = history;
+    return ESP_OK;
+}
+
+esp_err_t rtcp_set_destinations(uint32_t ssrc, struct rtp_dest_table* dests) {
+    struct rtcp_stream* s = find_stream(ssrc);
+    if (s == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    s->dests = dests;
+    return ESP_OK;
+}
+
+esp_err_t rtcp_start(void) {
+    s_stats_lock = xSemaphoreCreateMutex();
+    if (unlikely(s_stats_lock == NULL)) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    snprintf(s_cname, sizeof(s_cname), "esp32-rtp-%08" PRIx32, esp_random());
+
+    if (unlikely(xTaskCreate(rtcp_task, "rtcp_task", DEFAULT_THREAD_STACKSIZE, NULL, DEFAULT_THREAD_PRIO, NULL) !=
+                 pdPASS)) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t rtcp_get_stats(uint32_t ssrc, struct rtcp_stream_stats* out) {
+    struct rtcp_stream* s = find_stream(ssrc);
+    if (s == NULL || s_stats_lock == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    xSemaphoreTake(s_stats_lock, portMAX_DELAY);
+    *out = s->stats;
+    xSemaphoreGive(s_stats_lock);
+
+    return ESP_OK;
+}
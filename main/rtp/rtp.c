@@ -1,30 +1,107 @@
 
 
 #include "esp_camera.h"
+#include "esp_check.h"
 #include "esp_log.h"
 #include "esp_netif.h"
 
+#include "freertos/queue.h"
+
 #include "include/jpeg.h"
+#include "include/mcast.h"
+#include "include/quality.h"
+#include "include/rtcp.h"
+#include "include/rtp.h"
+#include "include/rtsp.h"
+#include "include/sdp.h"
 
 #include "../include/pdm_mic.h"
 
-#define RTP_AUDIO_FRAME_MS 20
+#define RTP_AUDIO_SESSION_BPS 80000 // 64 kbit/s PCMU plus RTP/UDP/IP headers at 50 packets/s
+#define RTP_RESEND_POLL_MS 5        // how often queued retransmissions are checked between frames
+#define RTP_SDP_SIZE 512
+#define RTP_IDLE_POLL_MS 100        // how often an idle stream checks for a new destination
 
 static const char* const TAG = "rtp_sender";
 
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
 DRAM_ATTR static uint8_t rtp_jpeg_packet[RTP_PACKET_SIZE];
+#endif
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
 DRAM_ATTR static uint8_t rtp_audio_packet[RTP_PACKET_SIZE];
+#endif
+
+static struct rtp_session s_video_session;
+static struct rtp_session s_audio_session;
+static struct pacer s_video_pacer;
+static struct rtp_dest_table s_video_dests;
+static struct rtp_dest_table s_audio_dests;
+
+#ifdef CONFIG_ESPRTP_MULTICAST
+static enum rtp_transport s_transport = RTP_TRANSPORT_MULTICAST;
+#else
+static enum rtp_transport s_transport = RTP_TRANSPORT_UNICAST;
+#endif
+static uint32_t s_sdp_session_id;
+static uint32_t s_sdp_version;
+
+#ifdef CONFIG_ESPRTP_FEC
+static struct rtp_session s_fec_session;
+static struct fec_encoder s_fec_encoder;
+#endif
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT // FEC depends on video
+static struct fec_encoder* s_fec; // NULL when FEC is off or failed to start
+#endif
+
+#ifdef CONFIG_ESPRTP_NACK
+static struct rtp_history s_video_history;
+#endif
+static struct rtp_history* s_history; // NULL when NACKs are not answered
+
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
+static QueueHandle_t s_frame_queue;
+#endif
+static struct rtp_video_stats s_video_stats;
+static uint32_t s_fps_cap; // 0 = as fast as the sensor delivers
 
 typedef void handle_func_t(int sock, struct sockaddr_in* to);
 
-static void jpeg_handle(int sock, struct sockaddr_in* to) {
-    memset(rtp_jpeg_packet, 0, sizeof(rtp_jpeg_packet));
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
+/**
+ * Queue a frame for transmission. When the queue is full the oldest frame is
+ * handed back to the driver, so the sender always gets the latest capture.
+ */
+static void enqueue_latest(camera_fb_t* fb) {
+    while (xQueueSend(s_frame_queue, &fb, 0) != pdPASS) {
+        camera_fb_t* stale;
+        if (xQueueReceive(s_frame_queue, &stale, 0) == pdPASS) {
+            esp_camera_fb_return(stale);
+            __atomic_add_fetch(&s_video_stats.dropped, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_add_fetch(&s_video_stats.queued, 1, __ATOMIC_RELAXED);
+}
+
+static void rtp_capture_task(void* pvParameters) {
+    TickType_t xLastWakeTime = xTaskGetTickCount();
 
     while (1) {
+        // nobody is watching, leave the frames to the driver
+        if (rtp_dest_count(&s_video_dests) == 0) {
+            vTaskDelay(pdMS_TO_TICKS(RTP_IDLE_POLL_MS));
+            xLastWakeTime = xTaskGetTickCount();
+            continue;
+        }
+
+        const uint32_t fps_cap = __atomic_load_n(&s_fps_cap, __ATOMIC_RELAXED);
+        if (fps_cap) {
+            vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(1000 / fps_cap));
+        }
+
         camera_fb_t* fb = esp_camera_fb_get();
-        if (fb) {
-            rtp_send_jpeg_packets(sock, to, rtp_jpeg_packet, fb);
-            esp_camera_fb_return(fb);
+        if (likely(fb)) {
+            enqueue_latest(fb);
         } else {
             ESP_LOGE(TAG, "esp_camera_fb_get failed");
             vTaskDelay(pdMS_TO_TICKS(10));
@@ -32,36 +109,85 @@ static void jpeg_handle(int sock, struct sockaddr_in* to) {
     }
 }
 
+static void jpeg_handle(int sock, struct sockaddr_in* to) {
+    // the table was set up by rtp_init so destinations can be added before this task runs
+    s_video_dests.sock = sock;
+
+    memset(rtp_jpeg_packet, 0, sizeof(rtp_jpeg_packet));
+
+    s_frame_queue = xQueueCreate(RTP_VIDEO_QUEUE_LEN, sizeof(camera_fb_t*));
+    if (unlikely(s_frame_queue == NULL)) {
+        ESP_LOGE(TAG, "xQueueCreate failed");
+        return;
+    }
+
+    xTaskCreate(rtp_capture_task, "rtp_capture_task", DEFAULT_THREAD_STACKSIZE, NULL, DEFAULT_THREAD_PRIO, NULL);
+
+    // without a history there is nothing to do between frames
+    const TickType_t frame_wait = s_history ? pdMS_TO_TICKS(RTP_RESEND_POLL_MS) : portMAX_DELAY;
+
+    while (1) {
+        camera_fb_t* fb;
+        if (xQueueReceive(s_frame_queue, &fb, frame_wait) != pdPASS) {
+            if (s_history) {
+                rtp_jpeg_resend(&s_video_dests, s_history, &s_video_pacer);
+            }
+            continue;
+        }
+
+        rtp_send_jpeg_packets(&s_video_dests, rtp_jpeg_packet, fb, &s_video_session, &s_video_pacer, s_fec,
+                              s_history);
+        esp_camera_fb_return(fb);
+        __atomic_add_fetch(&s_video_stats.sent, 1, __ATOMIC_RELAXED);
+    }
+}
+#endif
+
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
 static void audio_handle(int sock, struct sockaddr_in* to) {
+    s_audio_dests.sock = sock;
+
     memset(rtp_audio_packet, 0, sizeof(rtp_audio_packet));
 
     struct rtp_header* header = (struct rtp_header*)rtp_audio_packet;
-    header->version = RTP_VERSION;
-    header->payloadtype = RTP_PCMU_PAYLOADTYPE;
-    header->ssrc = htonl(RTP_PCMU_SSRC);
-
-    uint16_t seq = esp_random() & 0xFFFF;
-    uint32_t timestamp = 0;
-    size_t bytes_read = 0;
-
-    const TickType_t xFrequency = pdMS_TO_TICKS(RTP_AUDIO_FRAME_MS);
-    TickType_t xLastWakeTime = xTaskGetTickCount();
+    struct pdm_mic_frame frame;
 
+    // paced by the microphone: every read waits for the next 20 ms DMA buffer
     while (1) {
-        if (pdm_mic_read(rtp_audio_packet + sizeof(struct rtp_header), &bytes_read) != ERR_OK) {
-            ESP_LOGW(TAG, "pdm_mic_read failed, skipping this frame");
-            goto next_frame;
+        // nobody is listening: drain the frame, the timestamps follow the samples anyway
+        if (rtp_dest_count(&s_audio_dests) == 0) {
+            pdm_mic_read(NULL, &frame);
+            continue;
         }
 
-        header->seqNum = htons(seq++); // RFC 3550
-        header->timestamp = htonl(timestamp);
-        timestamp += FRAME_8K;
+        const esp_err_t err = pdm_mic_read(rtp_audio_packet + sizeof(struct rtp_header), &frame);
+        if (unlikely(err != ESP_OK)) {
+            ESP_LOGW(TAG, "pdm_mic_read: %s, skipping this frame", esp_err_to_name(err));
+            continue;
+        }
 
-        sendto(sock, rtp_audio_packet, sizeof(struct rtp_header) + bytes_read, 0, (struct sockaddr*)to,
-               sizeof(struct sockaddr));
+        // the last sample of this frame arrived at captured_us
+        rtp_session_set_clock(&s_audio_session, frame.timestamp,
+                              frame.captured_us - frame.samples * 1000000LL / RTP_PCMU_CLOCK_RATE);
+        rtp_session_write_header(&s_audio_session, header, frame.timestamp, false);
 
-    next_frame:
-        vTaskDelayUntil(&xLastWakeTime, xFrequency);
+        if (likely(rtp_dest_send(&s_audio_dests, rtp_audio_packet, sizeof(struct rtp_header) + frame.samples,
+                                 NULL, 0) > 0)) {
+            rtp_session_on_sent(&s_audio_session, frame.samples);
+        }
+    }
+}
+#endif
+
+static void rtp_address(in_port_t port, enum rtp_transport transport, struct sockaddr_in* to) {
+    memset(to, 0, sizeof(*to));
+    to->sin_family = PF_INET;
+    to->sin_port = htons(port);
+
+    if (transport == RTP_TRANSPORT_MULTICAST) {
+        rtp_multicast_group(&to->sin_addr);
+    } else {
+        inet_aton(RTP_IPV4_ADDRESS, &to->sin_addr.s_addr);
     }
 }
 
@@ -72,14 +198,24 @@ static void udp_connect(in_port_t port, handle_func_t handle) {
     /* create new socket */
     sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_IP);
     if (sock >= 0) {
-        /* prepare RTP stream address */
-        memset(&to, 0, sizeof(to));
-        to.sin_family = PF_INET;
-        to.sin_port = htons(port);
+#ifdef CONFIG_ESPRTP_RTSP
+        /* send from the RTP port so it matches the server_port given to RTSP clients */
+        struct sockaddr_in local = {
+            .sin_family = PF_INET,
+            .sin_port = htons(port),
+            .sin_addr.s_addr = htonl(INADDR_ANY),
+        };
+        if (unlikely(bind(sock, (struct sockaddr*)&local, sizeof(local)) < 0)) {
+            // a receiver on the same host owns the port
+            ESP_LOGW(TAG, "bind %d: %d (%s), using an ephemeral port", port, errno, strerror(errno));
+        }
+#endif
 
-        inet_aton(RTP_IPV4_ADDRESS, &to.sin_addr.s_addr);
+        /* prepare RTP stream address */
+        rtp_address(port, rtp_get_transport(), &to);
+        ESP_ERROR_CHECK_WITHOUT_ABORT(rtp_multicast_socket_init(sock));
 
-        ESP_LOGI(TAG, "handle UDP %s:%d", RTP_IPV4_ADDRESS, port);
+        ESP_LOGI(TAG, "handle UDP %s:%d", inet_ntoa(to.sin_addr), port);
 
         handle(sock, &to);
 
@@ -88,20 +224,271 @@ static void udp_connect(in_port_t port, handle_func_t handle) {
     }
 }
 
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
 static void rtp_send_jpeg_task(void* pvParameters) {
     udp_connect(RTP_VIDEO_PORT, jpeg_handle);
 }
+#endif
 
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
 static void rtp_send_audio_task(void* pvParameters) {
     udp_connect(RTP_AUDIO_PORT, audio_handle);
 }
+#endif
+
+void rtp_get_video_pacer_stats(struct pacer_stats* out) {
+    pacer_get_stats(&s_video_pacer, out);
+}
+
+void rtp_set_video_fps_cap(uint32_t fps) {
+    __atomic_store_n(&s_fps_cap, fps, __ATOMIC_RELAXED);
+    pacer_set_fps(&s_video_pacer, fps ? fps : RTP_VIDEO_FPS);
+}
+
+esp_err_t rtp_video_add_destination(const struct sockaddr_in* addr, bool own_ssrc) {
+    uint32_t ssrc = 0;
+    while (own_ssrc && (ssrc == 0 || ssrc == s_video_session.ssrc)) {
+        ssrc = esp_random();
+    }
+
+    return rtp_dest_add(&s_video_dests, addr, ssrc);
+}
+
+esp_err_t rtp_video_remove_destination(const struct sockaddr_in* addr) {
+    return rtp_dest_remove(&s_video_dests, addr);
+}
+
+esp_err_t rtp_audio_add_destination(const struct sockaddr_in* addr) {
+    return rtp_dest_add(&s_audio_dests, addr, 0);
+}
+
+esp_err_t rtp_audio_remove_destination(const struct sockaddr_in* addr) {
+    return rtp_dest_remove(&s_audio_dests, addr);
+}
+
+esp_err_t rtp_video_add_interleaved(const struct sockaddr_in* addr, struct rtp_tcp_link* link, uint8_t channel) {
+    return rtp_dest_add_interleaved(&s_video_dests, addr, link, channel);
+}
+
+esp_err_t rtp_audio_add_interleaved(const struct sockaddr_in* addr, struct rtp_tcp_link* link, uint8_t channel) {
+    return rtp_dest_add_interleaved(&s_audio_dests, addr, link, channel);
+}
+
+esp_err_t rtp_get_video_destination_stats(const struct sockaddr_in* addr, struct rtp_dest_stats* out) {
+    return rtp_dest_get_stats(&s_video_dests, addr, out);
+}
+
+/** Point the configured destination of a stream at the other transport's address */
+static esp_err_t switch_destination(struct rtp_dest_table* dests, in_port_t port, enum rtp_transport from,
+                                    enum rtp_transport to) {
+    struct sockaddr_in old_addr, new_addr;
+    rtp_address(port, from, &old_addr);
+    rtp_address(port, to, &new_addr);
+
+    esp_err_t err = rtp_dest_replace(dests, &old_addr, &new_addr);
+#ifdef CONFIG_ESPRTP_RTSP
+    // RTSP clients are the only destinations, there is no configured one to move
+    if (err == ESP_ERR_NOT_FOUND) {
+        err = ESP_OK;
+    }
+#else
+    if (err == ESP_ERR_NOT_FOUND) {
+        // it was removed by hand, the new address is added all the same
+        err = rtp_dest_add(dests, &new_addr, 0);
+    }
+#endif
+
+    return err;
+}
+
+static void log_sdp(void) {
+    char sdp[RTP_SDP_SIZE];
+    rtp_get_sdp(sdp, sizeof(sdp));
+    ESP_LOGI(TAG, "SDP:\n%s", sdp);
+}
+
+esp_err_t rtp_set_transport(enum rtp_transport transport) {
+    if (transport == RTP_TRANSPORT_MULTICAST) {
+        struct in_addr group;
+        ESP_RETURN_ON_ERROR(rtp_multicast_group(&group), TAG, "%s is not a multicast group", RTP_MULTICAST_ADDRESS);
+    }
+
+    const enum rtp_transport old = __atomic_exchange_n(&s_transport, transport, __ATOMIC_RELAXED);
+    if (old == transport) {
+        return ESP_OK;
+    }
+
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
+    ESP_ERROR_CHECK_WITHOUT_ABORT(switch_destination(&s_video_dests, RTP_VIDEO_PORT, old, transport));
+#endif
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+    ESP_ERROR_CHECK_WITHOUT_ABORT(switch_destination(&s_audio_dests, RTP_AUDIO_PORT, old, transport));
+#endif
+
+    __atomic_add_fetch(&s_sdp_version, 1, __ATOMIC_RELAXED);
+    log_sdp();
+    return ESP_OK;
+}
+
+enum rtp_transport rtp_get_transport(void) {
+    return __atomic_load_n(&s_transport, __ATOMIC_RELAXED);
+}
+
+void rtp_get_sdp_desc(struct sdp_desc* out) {
+    struct sockaddr_in to;
+    rtp_address(0, rtp_get_transport(), &to);
+
+    *out = (struct sdp_desc){
+        .session_id = s_sdp_session_id,
+        .version = __atomic_load_n(&s_sdp_version, __ATOMIC_RELAXED),
+        .origin = rtp_multicast_interface(),
+        .connection = to.sin_addr,
+        .ttl = RTP_MULTICAST_TTL,
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
+        .video_port = RTP_VIDEO_PORT,
+#endif
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+        .audio_port = RTP_AUDIO_PORT,
+#endif
+#ifdef CONFIG_ESPRTP_FEC
+        .fec_pt = s_fec ? CONFIG_ESPRTP_FEC_PAYLOADTYPE : 0,
+#endif
+        .nack = s_history != NULL,
+    };
+}
+
+int rtp_get_sdp(char* buf, size_t size) {
+    struct sdp_desc desc;
+    rtp_get_sdp_desc(&desc);
+    return sdp_write(buf, size, &desc);
+}
+
+esp_err_t rtp_get_video_history_stats(struct rtp_history_stats* out) {
+    if (s_history == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    rtp_history_get_stats(s_history, out);
+    return ESP_OK;
+}
+
+void rtp_get_video_stats(struct rtp_video_stats* out) {
+    out->queued = __atomic_load_n(&s_video_stats.queued, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&s_video_stats.dropped, __ATOMIC_RELAXED);
+    out->sent = __atomic_load_n(&s_video_stats.sent, __ATOMIC_RELAXED);
+}
+
+#ifdef CONFIG_ESPRTP_RTCP_SUPPORT
+__attribute__((cold)) static void rtcp_init(void) {
+    struct sockaddr_in to;
+
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+    rtp_address(RTP_AUDIO_PORT, rtp_get_transport(), &to);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(rtcp_add_stream(&s_audio_session, &to, RTP_AUDIO_SESSION_BPS));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(rtcp_set_destinations(s_audio_session.ssrc, &s_audio_dests));
+#endif
+
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
+    rtp_address(RTP_VIDEO_PORT, rtp_get_transport(), &to);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(rtcp_add_stream(&s_video_session, &to, RTP_VIDEO_BITRATE_KBPS * 1000U));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(rtcp_set_destinations(s_video_session.ssrc, &s_video_dests));
+    if (s_history) {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(rtcp_set_history(s_video_session.ssrc, s_history));
+    }
+#endif
+
+    ESP_ERROR_CHECK_WITHOUT_ABORT(rtcp_start());
+}
+#endif
+
+#ifdef CONFIG_ESPRTP_FEC
+/**
+ * The FEC stream shares the media timestamp base so a parity packet carries
+ * the timestamp of the frame it protects.
+ */
+__attribute__((cold)) static void fec_init(uint32_t ts_base) {
+    rtp_session_init(&s_fec_session, RTP_JPEG_FEC_SSRC, CONFIG_ESPRTP_FEC_PAYLOADTYPE, RTP_JPEG_CLOCK_RATE,
+                     esp_random(), ts_base);
+
+    esp_err_t err = fec_encoder_init(&s_fec_encoder, &s_fec_session, CONFIG_ESPRTP_FEC_ROW_LENGTH,
+                                     CONFIG_ESPRTP_FEC_COLUMN_DEPTH);
+    if (unlikely(err != ESP_OK)) {
+        ESP_LOGE(TAG, "fec_encoder_init %dx%d: %s", CONFIG_ESPRTP_FEC_ROW_LENGTH, CONFIG_ESPRTP_FEC_COLUMN_DEPTH,
+                 esp_err_to_name(err));
+        return;
+    }
+
+    s_fec = &s_fec_encoder;
+    ESP_LOGI(TAG, "ULPFEC PT %d, L=%d D=%d", CONFIG_ESPRTP_FEC_PAYLOADTYPE, CONFIG_ESPRTP_FEC_ROW_LENGTH,
+             CONFIG_ESPRTP_FEC_COLUMN_DEPTH);
+}
+#endif
 
 __attribute__((cold)) void rtp_init(void) {
-#ifdef AUDIO_SUPPORT
+    const uint32_t video_ts_base = esp_random();
+    rtp_session_init(&s_video_session, RTP_JPEG_SSRC, RTP_JPEG_PAYLOADTYPE, RTP_JPEG_CLOCK_RATE, esp_random(),
+                     video_ts_base);
+    rtp_session_init(&s_audio_session, RTP_PCMU_SSRC, RTP_PCMU_PAYLOADTYPE, RTP_PCMU_CLOCK_RATE, esp_random(),
+                     esp_random());
+
+    if (rtp_get_transport() == RTP_TRANSPORT_MULTICAST) {
+        struct in_addr group;
+        if (unlikely(rtp_multicast_group(&group) != ESP_OK)) {
+            ESP_LOGE(TAG, "%s is not a multicast group, sending unicast", RTP_MULTICAST_ADDRESS);
+            s_transport = RTP_TRANSPORT_UNICAST;
+        }
+    }
+    s_sdp_session_id = esp_random();
+
+    // the tables are set up here so destinations can be added before the tasks run
+    ESP_ERROR_CHECK(rtp_dest_table_init(&s_video_dests, -1, &s_video_session));
+    ESP_ERROR_CHECK(rtp_dest_table_init(&s_audio_dests, -1, &s_audio_session));
+    // and the pacer, quality_start sets its fps to the starting step
+    ESP_ERROR_CHECK(pacer_init(&s_video_pacer, RTP_VIDEO_BITRATE_KBPS, RTP_VIDEO_BURST_BYTES, RTP_VIDEO_FPS));
+
+#ifndef CONFIG_ESPRTP_RTSP // RTSP clients add themselves on PLAY
+    struct sockaddr_in to;
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
+    rtp_address(RTP_VIDEO_PORT, rtp_get_transport(), &to);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(rtp_dest_add(&s_video_dests, &to, 0));
+#endif
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+    rtp_address(RTP_AUDIO_PORT, rtp_get_transport(), &to);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(rtp_dest_add(&s_audio_dests, &to, 0));
+#endif
+#endif
+
+#ifdef CONFIG_ESPRTP_FEC
+    fec_init(video_ts_base);
+#endif
+
+#ifdef CONFIG_ESPRTP_NACK
+    if (ESP_ERROR_CHECK_WITHOUT_ABORT(rtp_history_init(&s_video_history, CONFIG_ESPRTP_NACK_HISTORY)) == ESP_OK) {
+        s_history = &s_video_history;
+    }
+#endif
+
+#ifdef CONFIG_ESPRTP_RTCP_SUPPORT
+    rtcp_init();
+#endif
+
+#ifdef CONFIG_ESPRTP_RATE_CONTROL
+    ESP_ERROR_CHECK_WITHOUT_ABORT(quality_start());
+#endif
+
+#ifndef CONFIG_ESPRTP_RTSP
+    log_sdp();
+#endif
+
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
     xTaskCreate(rtp_send_audio_task, "rtp_send_audio_task", DEFAULT_THREAD_STACKSIZE, NULL, DEFAULT_THREAD_PRIO, NULL);
 #endif
 
-#ifdef VIDEO_SUPPORT
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
     xTaskCreate(rtp_send_jpeg_task, "rtp_send_jpeg_task", DEFAULT_THREAD_STACKSIZE, NULL, DEFAULT_THREAD_PRIO, NULL);
 #endif
+
+#ifdef CONFIG_ESPRTP_RTSP
+    ESP_ERROR_CHECK_WITHOUT_ABORT(rtsp_start());
+#endif
 }
\ No newline at end of file
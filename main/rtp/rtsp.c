@@ -0,0 +1,633 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "include/rtcp.h"
+#include "include/rtp.h"
+#include "include/rtsp.h"
+#include "include/sdp.h"
+#include "include/tcp.h"
+
+static const char* const TAG = "rtsp";
+
+#define RTSP_REQUEST_SIZE 1024
+#define RTSP_RESPONSE_SIZE 1536
+#define RTSP_SDP_SIZE 512
+#define RTSP_URL_SIZE 256
+#define RTSP_TRACKS 2
+#define RTSP_POLL_MS 1000
+#define RTSP_FLUSH_POLL_MS 5 // while interleaved clients play, for the queue tails the sender left behind
+#define RTSP_PUBLIC "OPTIONS, DESCRIBE, SETUP, TEARDOWN, PLAY, GET_PARAMETER"
+
+enum rtsp_state {
+    RTSP_INIT,
+    RTSP_READY, // at least one track set up
+    RTSP_PLAYING,
+};
+
+struct rtsp_track {
+    bool setup;
+    int channel;           // interleaved RTP channel, -1 for UDP
+    struct sockaddr_in to; // client RTP port, its RTCP port is the next one; the peer when interleaved
+};
+
+/** One client connection and the session it carries */
+struct rtsp_conn {
+    int sock; // -1 for a free slot
+    struct sockaddr_in peer;
+    struct in_addr local;
+    char buf[RTSP_REQUEST_SIZE + 1];
+    size_t len;
+    uint32_t session; // 0 until the first SETUP
+    enum rtsp_state state;
+    struct rtsp_track tracks[RTSP_TRACKS];
+    struct rtp_tcp_link* link; // set once a track is interleaved, then carries the responses too
+    int64_t last_us;           // last request, for the session timeout
+    int64_t report_us;         // last RTCP report from a UDP track's client, written by the RTCP task
+};
+
+struct rtsp_request {
+    char method[16];
+    char url[RTSP_URL_SIZE];
+    char cseq[16];
+    char session[32];
+    char transport[128];
+};
+
+static struct rtsp_conn s_conns[RTSP_MAX_SESSIONS];
+#ifdef CONFIG_ESPRTP_RTSP_TCP
+static struct rtp_tcp_link s_links[RTSP_MAX_SESSIONS]; // queues are allocated on first use and kept
+#endif
+
+// only used by rtsp_task
+static char s_response[RTSP_RESPONSE_SIZE];
+static char s_sdp[RTSP_SDP_SIZE];
+
+/**
+ * Copy out the value of a header. head is the NUL terminated request head,
+ * starting with the request line; names compare case-insensitively.
+ */
+static bool header(const char* head, const char* name, char* out, size_t size) {
+    const size_t name_len = strlen(name);
+
+    for (const char* line = strstr(head, "\r\n"); line; line = strstr(line, "\r\n")) {
+        line += 2;
+        if (strncasecmp(line, name, name_len) != 0 || line[name_len] != ':') {
+            continue;
+        }
+
+        const char* v = line + name_len + 1;
+        while (*v == ' ' || *v == '\t') {
+            v++;
+        }
+        size_t n = strstr(v, "\r\n") - v; // the head ends with an empty line
+        n = n < size ? n : size - 1;
+        memcpy(out, v, n);
+        out[n] = '\0';
+        return true;
+    }
+
+    return false;
+}
+
+/** Video or audio from the SETUP URL, -1 for a track this build does not stream */
+static int track_of(const char* url, in_port_t* server_port, uint32_t* ssrc) {
+    const char* id = strstr(url, "trackID=");
+    const int track = id ? atoi(id + 8) : -1;
+
+#ifdef CONFIG_ESPRTP_VIDEO_SUPPORT
+    if (track == SDP_VIDEO_TRACK) {
+        *server_port = RTP_VIDEO_PORT;
+        *ssrc = RTP_JPEG_SSRC;
+        return track;
+    }
+#endif
+#ifdef CONFIG_ESPRTP_AUDIO_SUPPORT
+    if (track == SDP_AUDIO_TRACK) {
+        *server_port = RTP_AUDIO_PORT;
+        *ssrc = RTP_PCMU_SSRC;
+        return track;
+    }
+#endif
+
+    return -1;
+}
+
+static void respond(struct rtsp_conn* c, int code, const char* reason, const struct rtsp_request* req,
+                    const char* headers, const char* body) {
+    int len = snprintf(s_response, sizeof(s_response), "RTSP/1.0 %d %s\r\nCSeq: %s\r\nServer: esp32-rtp\r\n", code,
+                       reason, req->cseq);
+    if (c->session) {
+        len += snprintf(s_response + len, sizeof(s_response) - len, "Session: %08" PRIX32 ";timeout=%d\r\n",
+                        c->session, RTSP_TIMEOUT_S);
+    }
+    if (body) {
+        len += snprintf(s_response + len, sizeof(s_response) - len, "Content-Length: %u\r\n",
+                        (unsigned)strlen(body));
+    }
+    len += snprintf(s_response + len, sizeof(s_response) - len, "%s\r\n%s", headers ? headers : "",
+                    body ? body : "");
+
+    if (unlikely(len >= (int)sizeof(s_response))) {
+        ESP_LOGE(TAG, "response to %s does not fit", req->method);
+        return;
+    }
+
+    if (c->link) {
+        if (unlikely(rtp_tcp_link_write(c->link, s_response, len) != ESP_OK)) {
+            ESP_LOGW(TAG, "response to %s dropped", req->method);
+        }
+    } else if (unlikely(send(c->sock, s_response, len, MSG_NOSIGNAL) != len)) {
+        ESP_LOGW(TAG, "send: %d (%s)", errno, strerror(errno));
+    }
+}
+
+static esp_err_t add_track(const struct rtsp_conn* c, int track) {
+    const struct rtsp_track* t = &c->tracks[track];
+    if (t->channel >= 0) {
+        return track == SDP_VIDEO_TRACK ? rtp_video_add_interleaved(&t->to, c->link, t->channel)
+                                        : rtp_audio_add_interleaved(&t->to, c->link, t->channel);
+    }
+
+    // clients share the stream SSRC, so NACK and FEC keep working for them
+    return track == SDP_VIDEO_TRACK ? rtp_video_add_destination(&t->to, false) : rtp_audio_add_destination(&t->to);
+}
+
+static void remove_track(int track, const struct sockaddr_in* to) {
+    if (track == SDP_VIDEO_TRACK) {
+        rtp_video_remove_destination(to);
+    } else {
+        rtp_audio_remove_destination(to);
+    }
+}
+
+static void stop_session(struct rtsp_conn* c) {
+    if (c->state == RTSP_PLAYING) {
+        for (int i = 0; i < RTSP_TRACKS; i++) {
+            if (c->tracks[i].setup) {
+                remove_track(i, &c->tracks[i].to);
+            }
+        }
+        ESP_LOGI(TAG, "%s: session %08" PRIX32 " stopped", inet_ntoa(c->peer.sin_addr), c->session);
+    }
+
+    c->session = 0;
+    __atomic_store_n(&c->state, RTSP_INIT, __ATOMIC_RELEASE); // on_rtcp_report may still be reading, see there
+    memset(c->tracks, 0, sizeof(c->tracks));
+}
+
+static bool session_matches(const struct rtsp_conn* c, const struct rtsp_request* req) {
+    return c->session && strtoul(req->session, NULL, 16) == c->session;
+}
+
+static void handle_describe(struct rtsp_conn* c, const struct rtsp_request* req) {
+    struct sdp_desc desc;
+    rtp_get_sdp_desc(&desc);
+    // every client gets its own unicast copy, whatever the transport mode
+    desc.origin = c->local;
+    desc.connection.s_addr = htonl(INADDR_ANY);
+    desc.control = true;
+    sdp_write(s_sdp, sizeof(s_sdp), &desc);
+
+    char headers[RTSP_URL_SIZE + 64];
+    const size_t url_len = strlen(req->url);
+    snprintf(headers, sizeof(headers), "Content-Base: %s%s\r\nContent-Type: application/sdp\r\n", req->url,
+             url_len && req->url[url_len - 1] == '/' ? "" : "/");
+    respond(c, 200, "OK", req, headers, s_sdp);
+}
+
+static void handle_setup(struct rtsp_conn* c, const struct rtsp_request* req) {
+    in_port_t server_port;
+    uint32_t ssrc;
+    const int track = track_of(req->url, &server_port, &ssrc);
+    if (track < 0) {
+        respond(c, 404, "Not Found", req, NULL, NULL);
+        return;
+    }
+
+    if (c->session && !session_matches(c, req)) {
+        respond(c, 454, "Session Not Found", req, NULL, NULL);
+        return;
+    }
+
+    if (c->state == RTSP_PLAYING) {
+        respond(c, 455, "Method Not Valid in This State", req, NULL, NULL);
+        return;
+    }
+
+    // RTP/AVP[F][/UDP];unicast;client_port=a-b or RTP/AVP[F]/TCP;unicast;interleaved=a-b
+    const size_t profile_len = strcspn(req->transport, ";");
+    const bool tcp = profile_len > 4 && strncmp(req->transport + profile_len - 4, "/TCP", 4) == 0;
+    if (strncmp(req->transport, "RTP/AVP", 7) != 0 || strstr(req->transport, "multicast")) {
+        respond(c, 461, "Unsupported Transport", req, NULL, NULL);
+        return;
+    }
+
+    struct rtsp_track* t = &c->tracks[track];
+    char headers[192];
+
+    if (tcp) {
+#ifdef CONFIG_ESPRTP_RTSP_TCP
+        unsigned channel = track * 2; // when the client leaves it to us
+        const char* interleaved = strstr(req->transport, "interleaved=");
+        if (interleaved && (sscanf(interleaved, "interleaved=%u", &channel) != 1 || channel > 254)) {
+            respond(c, 461, "Unsupported Transport", req, NULL, NULL);
+            return;
+        }
+
+        if (c->link == NULL) {
+            struct rtp_tcp_link* link = &s_links[c - s_conns];
+            if (unlikely(link->buf == NULL && rtp_tcp_link_init(link, RTP_TCP_QUEUE_SIZE) != ESP_OK)) {
+                ESP_LOGE(TAG, "no memory for a %d byte TCP queue", RTP_TCP_QUEUE_SIZE);
+                respond(c, 453, "Not Enough Bandwidth", req, NULL, NULL);
+                return;
+            }
+            rtp_tcp_link_open(link, c->sock);
+            c->link = link;
+        }
+
+        t->channel = channel;
+        t->to = c->peer;
+        snprintf(headers, sizeof(headers), "Transport: %.*s;unicast;interleaved=%u-%u;ssrc=%08" PRIX32 "\r\n",
+                 (int)profile_len, req->transport, channel, channel + 1, ssrc);
+#else
+        respond(c, 461, "Unsupported Transport", req, NULL, NULL);
+        return;
+#endif
+    } else {
+        const char* ports = strstr(req->transport, "client_port=");
+        unsigned rtp_port = 0;
+        if (ports == NULL || sscanf(ports, "client_port=%u", &rtp_port) != 1 || rtp_port == 0 || rtp_port > 65534) {
+            respond(c, 461, "Unsupported Transport", req, NULL, NULL);
+            return;
+        }
+
+        t->channel = -1;
+        // sender reports go to the next port, see rtcp_set_destinations
+        t->to = (struct sockaddr_in){
+            .sin_family = PF_INET,
+            .sin_port = htons(rtp_port),
+            .sin_addr = c->peer.sin_addr,
+        };
+        snprintf(headers, sizeof(headers),
+                 "Transport: %.*s;unicast;client_port=%u-%u;server_port=%u-%u;ssrc=%08" PRIX32 "\r\n",
+                 (int)profile_len, req->transport, rtp_port, rtp_port + 1, server_port, server_port + 1, ssrc);
+    }
+    t->setup = true;
+
+    if (c->session == 0) {
+        c->session = esp_random() | 1;
+    }
+    c->state = RTSP_READY;
+
+    respond(c, 200, "OK", req, headers, NULL);
+}
+
+static void handle_play(struct rtsp_conn* c, const struct rtsp_request* req) {
+    if (!session_matches(c, req)) {
+        respond(c, 454, "Session Not Found", req, NULL, NULL);
+        return;
+    }
+
+    if (c->state == RTSP_READY) {
+        for (int i = 0; i < RTSP_TRACKS; i++) {
+            if (!c->tracks[i].setup) {
+                continue;
+            }
+
+            if (unlikely(add_track(c, i) != ESP_OK)) {
+                for (int j = 0; j < i; j++) {
+                    if (c->tracks[j].setup) {
+                        remove_track(j, &c->tracks[j].to);
+                    }
+                }
+                respond(c, 453, "Not Enough Bandwidth", req, NULL, NULL);
+                return;
+            }
+        }
+
+        __atomic_store_n(&c->state, RTSP_PLAYING, __ATOMIC_RELEASE);
+        ESP_LOGI(TAG, "%s: session %08" PRIX32 " playing", inet_ntoa(c->peer.sin_addr), c->session);
+    }
+
+    respond(c, 200, "OK", req, "Range: npt=0.000-\r\n", NULL);
+}
+
+static void handle_request(struct rtsp_conn* c, const struct rtsp_request* req) {
+    ESP_LOGD(TAG, "%s %s", req->method, req->url);
+
+    if (strcmp(req->method, "OPTIONS") == 0) {
+        respond(c, 200, "OK", req, "Public: " RTSP_PUBLIC "\r\n", NULL);
+    } else if (strcmp(req->method, "DESCRIBE") == 0) {
+        handle_describe(c, req);
+    } else if (strcmp(req->method, "SETUP") == 0) {
+        handle_setup(c, req);
+    } else if (strcmp(req->method, "PLAY") == 0) {
+        handle_play(c, req);
+    } else if (strcmp(req->method, "TEARDOWN") == 0) {
+        const bool found = session_matches(c, req);
+        if (found) {
+            stop_session(c);
+        }
+        respond(c, found ? 200 : 454, found ? "OK" : "Session Not Found", req, NULL, NULL);
+    } else if (strcmp(req->method, "GET_PARAMETER") == 0) {
+        // keepalive, the timeout was already refreshed
+        const bool found = req->session[0] == '\0' || session_matches(c, req);
+        respond(c, found ? 200 : 454, found ? "OK" : "Session Not Found", req, NULL, NULL);
+    } else {
+        respond(c, 501, "Not Implemented", req, "Public: " RTSP_PUBLIC "\r\n", NULL);
+    }
+}
+
+static void close_conn(struct rtsp_conn* c) {
+    stop_session(c);
+    if (c->link) {
+        rtp_tcp_link_close(c->link);
+        c->link = NULL;
+    }
+    closesocket(c->sock);
+    c->sock = -1;
+}
+
+/**
+ * Handle every complete request in the connection buffer.
+ *
+ * @return false if the connection has to be closed
+ */
+static bool handle_input(struct rtsp_conn* c) {
+    while (c->len) {
+        if (c->buf[0] == '$') {
+            // interleaved from the client: RTCP receiver reports and NACKs on the odd channels
+            if (c->len < RTP_TCP_FRAMING) {
+                return true;
+            }
+            const size_t total = RTP_TCP_FRAMING + (((uint8_t)c->buf[2] << 8) | (uint8_t)c->buf[3]);
+            if (total > RTSP_REQUEST_SIZE) {
+                ESP_LOGW(TAG, "%s: interleaved packet too large", inet_ntoa(c->peer.sin_addr));
+                return false;
+            }
+            if (total > c->len) {
+                return true;
+            }
+
+#ifdef CONFIG_ESPRTP_RTCP_SUPPORT
+            if (c->buf[1] & 1) {
+                rtcp_handle_packet((const uint8_t*)c->buf + RTP_TCP_FRAMING, total - RTP_TCP_FRAMING);
+            }
+#endif
+            c->last_us = esp_timer_get_time(); // RTCP keeps the session alive (RFC 2326 A.2)
+
+            c->len -= total;
+            memmove(c->buf, c->buf + total, c->len);
+            continue;
+        }
+
+        c->buf[c->len] = '\0';
+        char* end = strstr(c->buf, "\r\n\r\n");
+        if (end == NULL) {
+            return c->len < RTSP_REQUEST_SIZE; // a head that never ends
+        }
+
+        // terminate the head for parsing, the byte is put back below
+        char* const body = end + 4;
+        const char saved = *body;
+        *body = '\0';
+
+        struct rtsp_request req = {0};
+        char version[16] = "";
+        char length[16] = "0";
+        if (sscanf(c->buf, "%15s %255s %15s", req.method, req.url, version) != 3 ||
+            strncmp(version, "RTSP/1.", 7) != 0) {
+            ESP_LOGW(TAG, "%s: not an RTSP request", inet_ntoa(c->peer.sin_addr));
+            return false;
+        }
+        header(c->buf, "CSeq", req.cseq, sizeof(req.cseq));
+        header(c->buf, "Session", req.session, sizeof(req.session));
+        header(c->buf, "Transport", req.transport, sizeof(req.transport));
+        header(c->buf, "Content-Length", length, sizeof(length));
+        *body = saved;
+
+        // bodies are not used by any supported method, only skipped
+        const size_t total = (body - c->buf) + strtoul(length, NULL, 10);
+        if (total > RTSP_REQUEST_SIZE) {
+            ESP_LOGW(TAG, "%s: %s request too large", inet_ntoa(c->peer.sin_addr), req.method);
+            return false;
+        }
+        if (total > c->len) {
+            return true;
+        }
+
+        c->last_us = esp_timer_get_time();
+        handle_request(c, &req);
+
+        c->len -= total;
+        memmove(c->buf, c->buf + total, c->len);
+    }
+
+    return true;
+}
+
+static void accept_conn(int listen_sock) {
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    const int sock = accept(listen_sock, (struct sockaddr*)&peer, &peer_len);
+    if (unlikely(sock < 0)) {
+        ESP_LOGW(TAG, "accept: %d (%s)", errno, strerror(errno));
+        return;
+    }
+
+    struct rtsp_conn* c = NULL;
+    for (size_t i = 0; i < RTSP_MAX_SESSIONS && c == NULL; i++) {
+        c = s_conns[i].sock < 0 ? &s_conns[i] : NULL;
+    }
+    if (c == NULL) {
+        ESP_LOGW(TAG, "%s: all %d sessions in use", inet_ntoa(peer.sin_addr), RTSP_MAX_SESSIONS);
+        closesocket(sock);
+        return;
+    }
+
+    memset(c, 0, sizeof(*c));
+    c->sock = sock;
+    c->peer = peer;
+    c->last_us = esp_timer_get_time();
+
+    // the address the client reached us on goes into the SDP origin
+    struct sockaddr_in local;
+    socklen_t local_len = sizeof(local);
+    if (getsockname(sock, (struct sockaddr*)&local, &local_len) == 0) {
+        c->local = local.sin_addr;
+    }
+
+    ESP_LOGI(TAG, "%s:%d connected", inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+}
+
+#ifdef CONFIG_ESPRTP_RTCP_SUPPORT
+/**
+ * A report from the RTCP port of a playing UDP track keeps the session alive
+ * like a request does (RFC 2326 A.2). Runs on the RTCP task without a lock, so
+ * a scan that saw PLAYING can read the tracks while stop_session or a new
+ * connection clears them, and match wrongly or not at all. That is benign:
+ * the only write is report_us, with a time taken before the clearing began.
+ * It lands on a connection that is being closed, or is older than the request
+ * or accept that cleared the tracks and set last_us, and last_activity takes
+ * the later of the two.
+ */
+static void on_rtcp_report(const struct sockaddr_in* from) {
+    const int64_t now = esp_timer_get_time();
+
+    for (size_t i = 0; i < RTSP_MAX_SESSIONS; i++) {
+        struct rtsp_conn* c = &s_conns[i];
+        if (__atomic_load_n(&c->state, __ATOMIC_ACQUIRE) != RTSP_PLAYING) {
+            continue;
+        }
+
+        for (size_t t = 0; t < RTSP_TRACKS; t++) {
+            const struct rtsp_track* track = &c->tracks[t];
+            if (track->setup && track->channel < 0 && track->to.sin_addr.s_addr == from->sin_addr.s_addr &&
+                ntohs(track->to.sin_port) + 1 == ntohs(from->sin_port)) {
+                __atomic_store_n(&c->report_us, now, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+#endif
+
+/** Last sign of life: a request, or an RTCP report on a UDP track */
+static int64_t last_activity(const struct rtsp_conn* c) {
+    const int64_t report_us = __atomic_load_n(&c->report_us, __ATOMIC_RELAXED);
+    return report_us > c->last_us ? report_us : c->last_us;
+}
+
+static void rtsp_task(void* pvParameters) {
+    const int listen_sock = (int)(intptr_t)pvParameters;
+
+    while (1) {
+        fd_set fds, write_fds;
+        FD_ZERO(&fds);
+        FD_ZERO(&write_fds);
+        FD_SET(listen_sock, &fds);
+        int max_fd = listen_sock;
+        bool interleaved = false;
+        for (size_t i = 0; i < RTSP_MAX_SESSIONS; i++) {
+            if (s_conns[i].sock >= 0) {
+                FD_SET(s_conns[i].sock, &fds);
+                max_fd = s_conns[i].sock > max_fd ? s_conns[i].sock : max_fd;
+            }
+            if (s_conns[i].link) {
+                interleaved = true;
+                if (rtp_tcp_link_pending(s_conns[i].link)) {
+                    FD_SET(s_conns[i].sock, &write_fds);
+                }
+            }
+        }
+
+        const int poll_ms = interleaved ? RTSP_FLUSH_POLL_MS : RTSP_POLL_MS;
+        struct timeval tv = {.tv_sec = poll_ms / 1000, .tv_usec = (poll_ms % 1000) * 1000};
+        const int ready = select(max_fd + 1, &fds, &write_fds, NULL, &tv);
+        if (unlikely(ready < 0)) {
+            ESP_LOGE(TAG, "select: %d (%s)", errno, strerror(errno));
+            vTaskDelay(pdMS_TO_TICKS(RTSP_POLL_MS));
+            continue;
+        }
+
+        const int64_t now = esp_timer_get_time();
+        for (size_t i = 0; i < RTSP_MAX_SESSIONS; i++) {
+            struct rtsp_conn* c = &s_conns[i];
+            if (c->sock < 0) {
+                continue;
+            }
+
+            if (ready > 0 && FD_ISSET(c->sock, &fds)) {
+                const int n = recv(c->sock, c->buf + c->len, RTSP_REQUEST_SIZE - c->len, 0);
+                c->len += n > 0 ? n : 0;
+                if (n <= 0 || !handle_input(c)) {
+                    ESP_LOGI(TAG, "%s:%d disconnected", inet_ntoa(c->peer.sin_addr), ntohs(c->peer.sin_port));
+                    close_conn(c);
+                }
+            } else if (now - last_activity(c) > RTSP_TIMEOUT_S * 1000000LL) {
+                ESP_LOGI(TAG, "%s:%d timed out", inet_ntoa(c->peer.sin_addr), ntohs(c->peer.sin_port));
+                close_conn(c);
+            }
+
+            if (c->link && unlikely(rtp_tcp_link_flush(c->link) != ESP_OK)) {
+                ESP_LOGI(TAG, "%s:%d send failed", inet_ntoa(c->peer.sin_addr), ntohs(c->peer.sin_port));
+                close_conn(c);
+            }
+        }
+
+        if (ready > 0 && FD_ISSET(listen_sock, &fds)) {
+            accept_conn(listen_sock);
+        }
+    }
+}
+
+void rtsp_get_tcp_stats(struct rtp_tcp_stats* out) {
+    memset(out, 0, sizeof(*out));
+
+#ifdef CONFIG_ESPRTP_RTSP_TCP
+    for (size_t i = 0; i < RTSP_MAX_SESSIONS; i++) {
+        if (s_links[i].buf == NULL) {
+            continue;
+        }
+
+        struct rtp_tcp_stats link;
+        rtp_tcp_link_get_stats(&s_links[i], &link);
+        out->packets += link.packets;
+        out->bytes += link.bytes;
+        out->frames += link.frames;
+        out->frames_dropped += link.frames_dropped;
+        out->frames_cut += link.frames_cut;
+        out->packets_dropped += link.packets_dropped;
+        out->depth += link.depth;
+        out->max_depth = link.max_depth > out->max_depth ? link.max_depth : out->max_depth;
+    }
+#endif
+}
+
+__attribute__((cold)) esp_err_t rtsp_start(void) {
+    for (size_t i = 0; i < RTSP_MAX_SESSIONS; i++) {
+        s_conns[i].sock = -1;
+    }
+
+    const int sock = socket(PF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (unlikely(sock < 0)) {
+        ESP_LOGE(TAG, "socket: %d (%s)", errno, strerror(errno));
+        return ESP_FAIL;
+    }
+
+    const int on = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in local = {
+        .sin_family = PF_INET,
+        .sin_port = htons(RTSP_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (unlikely(bind(sock, (struct sockaddr*)&local, sizeof(local)) < 0 || listen(sock, RTSP_MAX_SESSIONS) < 0)) {
+        ESP_LOGE(TAG, "listen on %d: %d (%s)", RTSP_PORT, errno, strerror(errno));
+        closesocket(sock);
+        return ESP_FAIL;
+    }
+
+    if (unlikely(xTaskCreate(rtsp_task, "rtsp_task", DEFAULT_THREAD_STACKSIZE, (void*)(intptr_t)sock,
+                             DEFAULT_THREAD_PRIO, NULL) != pdPASS)) {
+        closesocket(sock);
+        return ESP_ERR_NO_MEM;
+    }
+
+#ifdef CONFIG_ESPRTP_RTCP_SUPPORT
+    rtcp_set_report_callback(on_rtcp_report);
+#endif
+
+    ESP_LOGI(TAG, "listening on port %d", RTSP_PORT);
+    return ESP_OK;
+}
@@ -0,0 +1,70 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "include/mcast.h"
+#include "include/sdp.h"
+
+struct sdp_buf {
+    char* p;
+    size_t size;
+    int len;
+};
+
+__attribute__((format(printf, 2, 3))) static void append(struct sdp_buf* b, const char* fmt, ...) {
+    const size_t used = (size_t)b->len < b->size ? (size_t)b->len : b->size;
+
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(b->p + used, b->size - used, fmt, ap);
+    va_end(ap);
+
+    if (likely(n > 0)) {
+        b->len += n;
+    }
+}
+
+int sdp_write(char* buf, size_t size, const struct sdp_desc* d) {
+    struct sdp_buf b = {.p = buf, .size = size};
+    if (size) {
+        buf[0] = '\0';
+    }
+
+    // inet_ntoa returns a static buffer, one address per call
+    append(&b, "v=0\r\no=- %u %u IN IP4 %s\r\n", (unsigned)d->session_id, (unsigned)d->version,
+           inet_ntoa(d->origin));
+    append(&b, "s=ESP32 RTP\r\nc=IN IP4 %s", inet_ntoa(d->connection));
+    if (rtp_is_multicast(&d->connection)) {
+        append(&b, "/%u", d->ttl);
+    }
+    append(&b, "\r\nt=0 0\r\n");
+    if (d->control) {
+        append(&b, "a=control:*\r\na=range:npt=0-\r\n");
+    }
+
+    if (d->video_port) {
+        append(&b, "m=video %u RTP/%s %d", d->video_port, d->nack ? "AVPF" : "AVP", RTP_JPEG_PAYLOADTYPE);
+        if (d->fec_pt) {
+            append(&b, " %u", d->fec_pt);
+        }
+        append(&b, "\r\na=rtpmap:%d JPEG/%d\r\n", RTP_JPEG_PAYLOADTYPE, RTP_JPEG_CLOCK_RATE);
+        if (d->fec_pt) {
+            append(&b, "a=rtpmap:%u ulpfec/%d\r\n", d->fec_pt, RTP_JPEG_CLOCK_RATE);
+        }
+        if (d->nack) {
+            append(&b, "a=rtcp-fb:%d nack\r\n", RTP_JPEG_PAYLOADTYPE);
+        }
+        if (d->control) {
+            append(&b, "a=control:trackID=%d\r\n", SDP_VIDEO_TRACK);
+        }
+    }
+
+    if (d->audio_port) {
+        append(&b, "m=audio %u RTP/AVP %d\r\na=rtpmap:%d PCMU/%d\r\n", d->audio_port, RTP_PCMU_PAYLOADTYPE,
+               RTP_PCMU_PAYLOADTYPE, RTP_PCMU_CLOCK_RATE);
+        if (d->control) {
+            append(&b, "a=control:trackID=%d\r\n", SDP_AUDIO_TRACK);
+        }
+    }
+
+    return b.len;
+}
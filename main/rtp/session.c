@@ -0,0 +1,68 @@
+#include <string.h>
+
+#include "include/session.h"
+
+void rtp_session_init(struct rtp_session* s, uint32_t ssrc, uint8_t payload_type, uint32_t clock_rate,
+                      uint16_t initial_seq, uint32_t ts_base) {
+    memset(s, 0, sizeof(*s));
+
+    s->ssrc = ssrc;
+    s->payload_type = payload_type;
+    s->clock_rate = clock_rate;
+    s->seq = initial_seq;
+    s->ts_base = ts_base;
+}
+
+void rtp_session_write_header(struct rtp_session* s, struct rtp_header* h, uint32_t media_ts, bool marker) {
+    s->last_ts = s->ts_base + media_ts;
+
+    h->version = RTP_VERSION;
+    h->payloadtype = s->payload_type | (marker ? RTP_MARKER_MASK : 0U);
+    h->seqNum = htons(s->seq); // RFC 3550
+    h->timestamp = htonl(s->last_ts);
+    h->ssrc = htonl(s->ssrc);
+
+    if (unlikely(++s->seq == 0)) {
+        s->cycles += 1U << 16;
+    }
+}
+
+void rtp_session_on_sent(struct rtp_session* s, size_t payload_bytes) {
+    s->packets++;
+    s->octets += payload_bytes;
+}
+
+uint32_t rtp_session_extended_seq(const struct rtp_session* s) {
+    // seq already points past the last packet written
+    return (s->cycles | s->seq) - 1U;
+}
+
+void rtp_session_set_clock(struct rtp_session* s, uint32_t media_ts, int64_t time_us) {
+    // seqlock: odd while the pair is being written
+    __atomic_add_fetch(&s->clock_seq, 1, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&s->ref_ts, media_ts, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->ref_time_us, time_us, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->clock_seq, 1, __ATOMIC_RELEASE);
+}
+
+bool rtp_session_timestamp_at(const struct rtp_session* s, int64_t time_us, uint32_t* rtp_ts) {
+    uint32_t seq;
+    uint32_t ref_ts;
+    int64_t ref_time_us;
+
+    do {
+        seq = __atomic_load_n(&s->clock_seq, __ATOMIC_ACQUIRE);
+        ref_ts = __atomic_load_n(&s->ref_ts, __ATOMIC_RELAXED);
+        ref_time_us = __atomic_load_n(&s->ref_time_us, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1U) || seq != __atomic_load_n(&s->clock_seq, __ATOMIC_RELAXED));
+
+    if (unlikely(seq == 0)) {
+        return false;
+    }
+
+    const int64_t elapsed_ticks = (time_us - ref_time_us) * (int64_t)s->clock_rate / 1000000LL;
+    *rtp_ts = s->ts_base + ref_ts + (uint32_t)elapsed_ticks;
+
+    return true;
+}
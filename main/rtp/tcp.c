@@ -0,0 +1,283 @@
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "include/tcp.h"
+
+static const char* const TAG = "rtp_tcp";
+
+static inline size_t min(size_t a, size_t b) {
+    return (a < b) ? a : b;
+}
+
+esp_err_t rtp_tcp_link_init(struct rtp_tcp_link* l, size_t size) {
+    memset(l, 0, sizeof(*l));
+    l->sock = -1;
+    l->size = size;
+
+    // only the socket reads it back, PSRAM bandwidth is plenty
+    l->buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (l->buf == NULL) {
+        l->buf = heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+    }
+    l->lock = xSemaphoreCreateMutex();
+
+    if (unlikely(l->buf == NULL || l->lock == NULL)) {
+        heap_caps_free(l->buf);
+        l->buf = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+static void reset(struct rtp_tcp_link* l) {
+    l->head = 0;
+    l->len = 0;
+    l->in_frame = false;
+    l->dropping = false;
+    l->reserved = 0;
+    l->frame_start = 0;
+    l->interleaved = 0;
+    l->queued_total = 0;
+    l->sent_total = 0;
+}
+
+void rtp_tcp_link_open(struct rtp_tcp_link* l, int sock) {
+    // audio and RTCP packets are small, they must not wait for the previous ACK
+    const int on = 1;
+    if (unlikely(setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0)) {
+        ESP_LOGW(TAG, "TCP_NODELAY: %d (%s)", errno, strerror(errno));
+    }
+
+    xSemaphoreTake(l->lock, portMAX_DELAY);
+    reset(l);
+    memset(&l->stats, 0, sizeof(l->stats));
+    l->sock = sock;
+    xSemaphoreGive(l->lock);
+}
+
+void rtp_tcp_link_close(struct rtp_tcp_link* l) {
+    xSemaphoreTake(l->lock, portMAX_DELAY);
+    l->sock = -1;
+    reset(l);
+    xSemaphoreGive(l->lock);
+}
+
+bool rtp_tcp_link_is_open(struct rtp_tcp_link* l) {
+    return __atomic_load_n(&l->sock, __ATOMIC_RELAXED) >= 0;
+}
+
+void rtp_tcp_link_begin_frame(struct rtp_tcp_link* l, size_t bytes, size_t packets) {
+    const size_t need = bytes + packets * RTP_TCP_FRAMING;
+
+    xSemaphoreTake(l->lock, portMAX_DELAY);
+    if (l->sock >= 0) {
+        l->in_frame = true;
+        l->dropping = need > l->size - l->len;
+        l->reserved = l->dropping ? 0 : need;
+        l->frame_start = l->queued_total;
+        l->interleaved = 0;
+        if (l->dropping) {
+            l->stats.frames_dropped++;
+        } else {
+            l->stats.frames++;
+        }
+    }
+    xSemaphoreGive(l->lock);
+}
+
+void rtp_tcp_link_end_frame(struct rtp_tcp_link* l) {
+    xSemaphoreTake(l->lock, portMAX_DELAY);
+    l->in_frame = false;
+    l->dropping = false;
+    l->reserved = 0;
+    xSemaphoreGive(l->lock);
+}
+
+static inline size_t ring_pos(const struct rtp_tcp_link* l, uint64_t at) {
+    return (l->head + (size_t)(at - l->sent_total)) % l->size;
+}
+
+/**
+ * Remove the current frame's packets from the queue. Nothing after
+ * frame_start is on the wire yet; the writes interleaved with the frame move
+ * down to close the gaps, in order.
+ */
+static void take_back_frame(struct rtp_tcp_link* l) {
+    uint64_t to = l->frame_start;
+
+    for (size_t i = 0; i < l->interleaved; i++) {
+        const uint64_t from = l->interleaved_at[i].at;
+        for (size_t n = 0; n < l->interleaved_at[i].len; n++) {
+            // to never passes from, a forward copy is safe in the ring
+            l->buf[ring_pos(l, to + n)] = l->buf[ring_pos(l, from + n)];
+        }
+        to += l->interleaved_at[i].len;
+    }
+
+    l->len = (size_t)(to - l->sent_total);
+    l->queued_total = to;
+}
+
+/** Make room for n queued bytes, false if the packet has to be dropped */
+static bool take_room(struct rtp_tcp_link* l, size_t n, bool frame) {
+    const size_t room = l->size - l->len;
+
+    if (!frame || !l->in_frame) {
+        if (n + l->reserved <= room) {
+            return true;
+        }
+        l->stats.packets_dropped++;
+        return false;
+    }
+
+    if (l->dropping) {
+        return false;
+    }
+
+    if (likely(n <= room)) {
+        l->reserved -= min(n, l->reserved);
+        return true;
+    }
+
+    // the frame came out larger than admitted, which an upper bound in rtp_tcp_link_begin_frame rules out
+    if (l->sent_total <= l->frame_start && l->interleaved <= RTP_TCP_MAX_INTERLEAVED) {
+        take_back_frame(l);
+        l->stats.frames--;
+        l->stats.frames_dropped++;
+    } else {
+        l->stats.frames_cut++;
+    }
+    l->dropping = true;
+    l->reserved = 0;
+    return false;
+}
+
+/** Remember where a write that is not part of the current frame went, for take_back_frame */
+static void note_interleaved(struct rtp_tcp_link* l, size_t n) {
+    if (!l->in_frame || l->dropping || l->interleaved > RTP_TCP_MAX_INTERLEAVED) {
+        return;
+    }
+
+    if (l->interleaved < RTP_TCP_MAX_INTERLEAVED) {
+        l->interleaved_at[l->interleaved].at = l->queued_total;
+        l->interleaved_at[l->interleaved].len = n;
+    }
+    l->interleaved++;
+}
+
+static void append(struct rtp_tcp_link* l, const void* p, size_t n) {
+    const size_t tail = (l->head + l->len) % l->size;
+    const size_t first = min(n, l->size - tail);
+
+    memcpy(l->buf + tail, p, first);
+    memcpy(l->buf, (const uint8_t*)p + first, n - first);
+    l->len += n;
+    l->queued_total += n;
+
+    if (l->len > l->stats.max_depth) {
+        l->stats.max_depth = l->len;
+    }
+}
+
+static esp_err_t flush_locked(struct rtp_tcp_link* l) {
+    while (l->len) {
+        const size_t chunk = min(l->len, l->size - l->head);
+        const int n = send(l->sock, l->buf + l->head, chunk, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return ESP_OK; // backed up, the rest waits in the queue
+            }
+
+            ESP_LOGW(TAG, "send: %d (%s)", errno, strerror(errno));
+            l->sock = -1; // the connection owner sees it fail too and cleans up
+            reset(l);
+            return ESP_FAIL;
+        }
+
+        l->head = (l->head + n) % l->size;
+        l->len -= n;
+        l->sent_total += n;
+        l->stats.bytes += n;
+        if ((size_t)n < chunk) {
+            return ESP_OK;
+        }
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t rtp_tcp_link_put(struct rtp_tcp_link* l, uint8_t channel, const uint8_t* head, size_t head_len,
+                           const uint8_t* data, size_t data_len, bool frame) {
+    const size_t len = head_len + data_len;
+    const uint8_t framing[RTP_TCP_FRAMING] = {'$', channel, len >> 8, len & 0xFF};
+    esp_err_t err;
+
+    xSemaphoreTake(l->lock, portMAX_DELAY);
+
+    if (unlikely(l->sock < 0)) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (!take_room(l, sizeof(framing) + len, frame)) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        if (!frame) {
+            note_interleaved(l, sizeof(framing) + len);
+        }
+        append(l, framing, sizeof(framing));
+        append(l, head, head_len);
+        if (data) {
+            append(l, data, data_len);
+        }
+        l->stats.packets++;
+        err = flush_locked(l);
+    }
+
+    xSemaphoreGive(l->lock);
+
+    return err;
+}
+
+esp_err_t rtp_tcp_link_write(struct rtp_tcp_link* l, const void* data, size_t len) {
+    esp_err_t err;
+
+    xSemaphoreTake(l->lock, portMAX_DELAY);
+
+    if (unlikely(l->sock < 0)) {
+        err = ESP_ERR_INVALID_STATE;
+    } else if (!take_room(l, len, false)) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        note_interleaved(l, len);
+        append(l, data, len);
+        err = flush_locked(l);
+    }
+
+    xSemaphoreGive(l->lock);
+
+    return err;
+}
+
+esp_err_t rtp_tcp_link_flush(struct rtp_tcp_link* l) {
+    xSemaphoreTake(l->lock, portMAX_DELAY);
+    const esp_err_t err = l->sock >= 0 ? flush_locked(l) : ESP_OK;
+    xSemaphoreGive(l->lock);
+
+    return err;
+}
+
+size_t rtp_tcp_link_pending(struct rtp_tcp_link* l) {
+    xSemaphoreTake(l->lock, portMAX_DELAY);
+    const size_t len = l->sock >= 0 ? l->len : 0;
+    xSemaphoreGive(l->lock);
+
+    return len;
+}
+
+void rtp_tcp_link_get_stats(struct rtp_tcp_link* l, struct rtp_tcp_stats* out) {
+    xSemaphoreTake(l->lock, portMAX_DELAY);
+    *out = l->stats;
+    out->depth = l->len;
+    xSemaphoreGive(l->lock);
+}